@@ -0,0 +1,307 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "core/common/graupel.hpp"
+#include "core/common/utils.hpp"
+#include "io/io.hpp"
+
+using namespace graupel_ct;
+using namespace idx;
+
+namespace {
+
+constexpr real_t dt = 30.0;  // default time step of the graupel driver
+constexpr real_t qnc = 100.0; // default cloud number concentration
+
+/* inputs and derived quantities of one grid point, as the kernel sees them */
+struct point_t {
+  real_t t, p, rho, dz, qv, qc, qi, qr, qs, qg;
+  real_t qsat, qvsi, dvsw, dvsi, dvsw0, n_snow, l_snow, n_ice, m_ice, x_ice,
+      eta, ice_dep, xrho, qliq, qice, e_int;
+};
+
+using sample_t = std::vector<point_t>;
+
+/* warm: t >= tmelt, cold: below tmelt without liquid, mixed: with liquid */
+enum regime_t { warm, cold, mixed, nregimes };
+constexpr const char *regime_names[nregimes] = {"warm", "cold", "mixed"};
+
+point_t make_point(const State &state, size_t i) {
+  point_t x;
+  x.t = state.field(fld::t)[i];
+  x.p = state.field(fld::p)[i];
+  x.rho = state.field(fld::rho)[i];
+  x.dz = state.field(fld::dz)[i];
+  x.qv = state.field(lqv)[i];
+  x.qc = state.field(lqc)[i];
+  x.qi = state.field(lqi)[i];
+  x.qr = state.field(lqr)[i];
+  x.qs = state.field(lqs)[i];
+  x.qg = state.field(lqg)[i];
+
+  // same sequence as the transition step of the sequential kernel
+  x.qsat = thermo::qsat_rho(x.t, x.rho);
+  x.qvsi = thermo::qsat_ice_rho(x.t, x.rho);
+  x.dvsw = x.qv - x.qsat;
+  x.dvsi = x.qv - x.qvsi;
+  x.dvsw0 = x.qv - thermo::qsat_rho(thermodyn::tmelt, x.rho);
+  x.n_snow = property::snow_number(x.t, x.rho, x.qs);
+  x.l_snow = property::snow_lambda(x.rho, x.qs, x.n_snow);
+  x.n_ice = property::ice_number(x.t, x.rho);
+  x.m_ice = property::ice_mass(x.qi, x.n_ice);
+  x.x_ice = property::ice_sticking(x.t);
+  x.eta = ZERO;
+  x.ice_dep = ZERO;
+  if (x.t < thermodyn::tmelt) {
+    x.eta = property::deposition_factor(x.t, x.qvsi);
+    const real_t v2i = std::fmax(
+        transition::vapor_x_ice(x.qi, x.m_ice, x.eta, x.dvsi, x.rho, dt), ZERO);
+    x.ice_dep = std::fmin(v2i, x.dvsi / dt);
+  }
+  x.xrho = std::sqrt(rho_00 / x.rho);
+  x.qliq = x.qc + x.qr;
+  x.qice = x.qs + x.qi + x.qg;
+  x.e_int = thermo::internal_energy(x.t, x.qv, x.qliq, x.qice, x.rho, x.dz);
+  return x;
+}
+
+/* up to max_points active points of every regime, evenly spaced over the
+ * points of the input in the order the kernel visits them */
+std::vector<sample_t> read_samples(const std::string &file, size_t max_points,
+                                   size_t &ncells, size_t &nlev) {
+  State state;
+  size_t itime = 0;
+  io_muphys::read_fields(file, itime, ncells, nlev, state);
+  utils_muphys::calc_dz(state.field(fld::dz), state.field(fld::dz), ncells,
+                        nlev);
+
+  const real_t *t = state.field(fld::t);
+  const real_t *rho = state.field(fld::rho);
+  const real_t *qv = state.field(lqv);
+  std::vector<std::vector<size_t>> points(nregimes);
+  for (size_t k = nlev - 1; k < nlev; --k) {
+    for (size_t iv = 0; iv < ncells; ++iv) {
+      const size_t i = k * ncells + iv;
+      const real_t qliq = state.field(lqc)[i] + state.field(lqr)[i];
+      const bool active =
+          std::max({state.field(lqc)[i], state.field(lqr)[i],
+                    state.field(lqs)[i], state.field(lqi)[i],
+                    state.field(lqg)[i]}) > qmin ||
+          (t[i] < tfrz_het2 && qv[i] > thermo::qsat_ice_rho(t[i], rho[i]));
+      if (!active)
+        continue;
+      const regime_t regime = t[i] >= thermodyn::tmelt ? warm
+                              : qliq > qmin           ? mixed
+                                                      : cold;
+      points[regime].push_back(i);
+    }
+  }
+
+  std::vector<sample_t> samples(nregimes);
+  for (size_t r = 0; r < nregimes; ++r) {
+    const size_t n = std::min(max_points, points[r].size());
+    for (size_t j = 0; j < n; ++j)
+      samples[r].push_back(make_point(state, points[r][j * points[r].size() / n]));
+  }
+  return samples;
+}
+
+/* calls f on every point of the sample, reports time/call and calls/s */
+template <typename F>
+void run(benchmark::State &st, const sample_t &sample, F f) {
+  for (auto _ : st) {
+    for (const point_t &x : sample) {
+      real_t r = f(x);
+      benchmark::DoNotOptimize(r);
+    }
+  }
+  const double calls = static_cast<double>(st.iterations()) * sample.size();
+  st.SetItemsProcessed(static_cast<int64_t>(calls));
+  st.counters["time/call"] = benchmark::Counter(
+      calls, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+std::vector<sample_t> samples;
+
+/* one benchmark <group>/<function>/<regime> for every non-empty regime */
+template <typename F> void add(const std::string &name, F f) {
+  for (size_t r = 0; r < nregimes; ++r) {
+    if (samples[r].empty())
+      continue;
+    benchmark::RegisterBenchmark(
+        (name + "/" + regime_names[r]).c_str(),
+        [r, f](benchmark::State &st) { run(st, samples[r], f); });
+  }
+}
+
+void add_transitions() {
+  using namespace transition;
+  add("transition/cloud_to_graupel", [](const point_t &x) {
+    return cloud_to_graupel(x.t, x.rho, x.qc, x.qg);
+  });
+  add("transition/cloud_to_rain", [](const point_t &x) {
+    return cloud_to_rain(x.t, x.qc, x.qr, qnc);
+  });
+  add("transition/cloud_to_snow", [](const point_t &x) {
+    return cloud_to_snow(x.t, x.qc, x.qs, x.n_snow, x.l_snow);
+  });
+  add("transition/cloud_x_ice", [](const point_t &x) {
+    return cloud_x_ice(x.t, x.qc, x.qi, dt);
+  });
+  add("transition/graupel_to_rain", [](const point_t &x) {
+    return graupel_to_rain(x.t, x.p, x.rho, x.dvsw0, x.qg);
+  });
+  add("transition/ice_to_graupel", [](const point_t &x) {
+    return ice_to_graupel(x.rho, x.qr, x.qg, x.qi, x.x_ice);
+  });
+  add("transition/ice_to_snow", [](const point_t &x) {
+    return ice_to_snow(x.qi, x.n_snow, x.l_snow, x.x_ice);
+  });
+  add("transition/rain_to_graupel", [](const point_t &x) {
+    return rain_to_graupel(x.t, x.rho, x.qc, x.qr, x.qi, x.qs, x.m_ice, x.dvsw,
+                           dt);
+  });
+  add("transition/rain_to_vapor", [](const point_t &x) {
+    return rain_to_vapor(x.t, x.rho, x.qc, x.qr, x.dvsw, dt);
+  });
+  add("transition/snow_to_graupel", [](const point_t &x) {
+    return snow_to_graupel(x.t, x.rho, x.qc, x.qs);
+  });
+  add("transition/snow_to_rain", [](const point_t &x) {
+    return snow_to_rain(x.t, x.p, x.rho, x.dvsw0, x.qs);
+  });
+  add("transition/vapor_x_graupel", [](const point_t &x) {
+    return vapor_x_graupel(x.t, x.p, x.rho, x.qg, x.dvsw, x.dvsi, x.dvsw0, dt);
+  });
+  add("transition/vapor_x_ice", [](const point_t &x) {
+    return vapor_x_ice(x.qi, x.m_ice, x.eta, x.dvsi, x.rho, dt);
+  });
+  add("transition/vapor_x_snow", [](const point_t &x) {
+    return vapor_x_snow(x.t, x.p, x.rho, x.qs, x.n_snow, x.l_snow, x.eta,
+                        x.ice_dep, x.dvsw, x.dvsi, x.dvsw0, dt);
+  });
+}
+
+void add_properties() {
+  using namespace property;
+  add("property/deposition_auto_conversion", [](const point_t &x) {
+    return deposition_auto_conversion(x.qi, x.m_ice, x.ice_dep);
+  });
+  add("property/deposition_factor",
+      [](const point_t &x) { return deposition_factor(x.t, x.qvsi); });
+  add("property/fall_speed/rain",
+      [](const point_t &x) { return fall_speed(x.rho * x.qr, params[lqr]); });
+  add("property/fall_speed/ice",
+      [](const point_t &x) { return fall_speed(x.rho * x.qi, params[lqi]); });
+  add("property/fall_speed/snow",
+      [](const point_t &x) { return fall_speed(x.rho * x.qs, params[lqs]); });
+  add("property/fall_speed/graupel",
+      [](const point_t &x) { return fall_speed(x.rho * x.qg, params[lqg]); });
+  add("property/ice_deposition_nucleation", [](const point_t &x) {
+    return ice_deposition_nucleation(x.t, x.qc, x.qi, x.n_ice, x.dvsi, dt);
+  });
+  add("property/ice_mass",
+      [](const point_t &x) { return ice_mass(x.qi, x.n_ice); });
+  add("property/ice_number",
+      [](const point_t &x) { return ice_number(x.t, x.rho); });
+  add("property/ice_sticking", [](const point_t &x) { return ice_sticking(x.t); });
+  add("property/snow_lambda",
+      [](const point_t &x) { return snow_lambda(x.rho, x.qs, x.n_snow); });
+  add("property/snow_number",
+      [](const point_t &x) { return snow_number(x.t, x.rho, x.qs); });
+  add("property/vel_scale_factor/rain", [](const point_t &x) {
+    return vel_scale_factor(lqr, x.xrho, x.rho, x.t, x.qr);
+  });
+  add("property/vel_scale_factor/ice", [](const point_t &x) {
+    return vel_scale_factor(lqi, x.xrho, x.rho, x.t, x.qi);
+  });
+  add("property/vel_scale_factor/snow", [](const point_t &x) {
+    return vel_scale_factor(lqs, x.xrho, x.rho, x.t, x.qs);
+  });
+  add("property/vel_scale_factor/graupel", [](const point_t &x) {
+    return vel_scale_factor(lqg, x.xrho, x.rho, x.t, x.qg);
+  });
+}
+
+void add_thermo() {
+  using namespace thermo;
+  add("thermo/internal_energy", [](const point_t &x) {
+    return internal_energy(x.t, x.qv, x.qliq, x.qice, x.rho, x.dz);
+  });
+  add("thermo/T_from_internal_energy", [](const point_t &x) {
+    return T_from_internal_energy(x.e_int, x.qv, x.qliq, x.qice, x.rho, x.dz);
+  });
+  add("thermo/specific_humidity", [](const point_t &x) {
+    return specific_humidity(sat_pres_water(x.t), x.p);
+  });
+  add("thermo/sat_pres_water", [](const point_t &x) { return sat_pres_water(x.t); });
+  add("thermo/sat_pres_ice", [](const point_t &x) { return sat_pres_ice(x.t); });
+  add("thermo/qsat_rho", [](const point_t &x) { return qsat_rho(x.t, x.rho); });
+  add("thermo/qsat_ice_rho",
+      [](const point_t &x) { return qsat_ice_rho(x.t, x.rho); });
+  add("thermo/dqsatdT_rho", [](const point_t &x) { return dqsatdT_rho(x.qsat, x.t); });
+  add("thermo/dqsatdT", [](const point_t &x) { return dqsatdT(x.qsat, x.t); });
+  add("thermo/dqsatdT_ice", [](const point_t &x) { return dqsatdT_ice(x.qvsi, x.t); });
+  add("thermo/vaporization_energy",
+      [](const point_t &x) { return vaporization_energy(x.t); });
+  add("thermo/sublimation_energy",
+      [](const point_t &x) { return sublimation_energy(x.t); });
+}
+
+} // namespace
+
+/* muphys_bench [benchmark options] [input.nc], MU_BENCH_POINTS=<n> points
+ * per regime (default 4096) */
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  const std::string file = argc > 1 ? argv[1] : MU_BENCH_INPUT;
+  size_t max_points = 4096;
+  if (std::getenv("MU_BENCH_POINTS"))
+    max_points = std::stoul(std::getenv("MU_BENCH_POINTS"));
+
+  size_t ncells, nlev;
+  try {
+    samples = read_samples(file, max_points, ncells, nlev);
+  } catch (const std::exception &e) {
+    std::cerr << "muphys_bench: cannot sample " << file << ": " << e.what()
+              << std::endl;
+    return 1;
+  }
+
+  benchmark::AddCustomContext("input", file);
+  benchmark::AddCustomContext("grid", std::to_string(nlev) + "x" +
+                                          std::to_string(ncells));
+  for (size_t r = 0; r < nregimes; ++r)
+    benchmark::AddCustomContext(std::string("points ") + regime_names[r],
+                                std::to_string(samples[r].size()));
+  benchmark::AddCustomContext("precision",
+                              sizeof(real_t) == 4 ? "single" : "double");
+#ifdef MU_BENCH_FAST_MATH
+  benchmark::AddCustomContext("math", "fast");
+#else
+  benchmark::AddCustomContext("math", "ieee");
+#endif
+
+  add_transitions();
+  add_properties();
+  add_thermo();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
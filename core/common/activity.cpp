@@ -0,0 +1,69 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "activity.hpp"
+#include "../properties/thermo.hpp"
+#include <algorithm>
+
+void utils_muphys::activity_t::reset(size_t levels) {
+  *this = {};
+  nlev = levels;
+  active.assign(nlev, 0);
+  kmin.assign(nlev + 1, 0);
+}
+
+utils_muphys::activity_t &utils_muphys::activity_stats() {
+  static activity_t stats;
+  return stats;
+}
+
+void utils_muphys::count_activity(const State &state, size_t ke,
+                                  size_t ivstart, size_t ivend,
+                                  activity_t &activity) {
+  using namespace idx;
+  if (activity.nlev != ke || activity.active.size() != ke)
+    activity.reset(ke);
+  ++activity.calls;
+  activity.columns += ivend - ivstart;
+
+  const real_t *q[nx];
+  for (size_t ix = 0; ix < nx; ix++)
+    q[ix] = state.field(ix);
+  const real_t *t = state.field(fld::t);
+  const real_t *rho = state.field(fld::rho);
+
+  for (size_t j = ivstart; j < ivend; j++) {
+    // bottom-up like the scan of the kernels, so the last hit is the top
+    size_t kmin[np];
+    std::fill(kmin, kmin + np, ke);
+    for (size_t k = ke - 1; k < ke; --k) {
+      const size_t i = k * ivend + j;
+      const bool liquid = std::max(q[lqc][i], q[lqr][i]) > graupel_ct::qmin;
+      const bool ice =
+          std::max({q[lqs][i], q[lqi][i], q[lqg][i]}) > graupel_ct::qmin;
+      const bool ice_supersaturated =
+          t[i] < graupel_ct::tfrz_het2 &&
+          q[lqv][i] > thermo::qsat_ice_rho(t[i], rho[i]);
+      if (liquid || ice || ice_supersaturated) {
+        ++activity.active[k];
+        ++activity.regimes[liquid && ice ? activity::mixed
+                           : liquid      ? activity::warm
+                                         : activity::cold];
+      }
+      for (size_t ix = 0; ix < np; ix++)
+        if (q[qp_ind[ix]][i] > graupel_ct::qmin)
+          kmin[ix] = k;
+    }
+    for (size_t ix = 0; ix < np; ix++)
+      activity.precip_columns[qp_ind[ix]] += kmin[ix] < ke;
+    ++activity.kmin[*std::min_element(kmin, kmin + np)];
+  }
+}
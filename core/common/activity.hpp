@@ -0,0 +1,90 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+
+#include "constants.hpp"
+#include "state.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace activity {
+// Regimes of the active points by the condensate they hold: liquid only
+// (qc, qr), ice only (qi, qs, qg) or both; active points without
+// condensate nucleate ice and count as cold
+constexpr size_t warm = 0;
+constexpr size_t cold = 1;
+constexpr size_t mixed = 2;
+constexpr size_t n = 3;
+
+constexpr const char *names[n] = {"warm", "cold", "mixed"};
+
+// the water species in the order of idx
+constexpr const char *species[idx::nx] = {"qr", "qi", "qs", "qg", "qc", "qv"};
+} // namespace activity
+
+namespace utils_muphys {
+
+/**
+ * @brief Where the graupel kernel has work, accumulated over its calls
+ *
+ * Active points are those the transitions visit, the kmin of a column is
+ * its first level with precipitating condensate, the threshold of its
+ * sedimentation, and nlev if it has none. The limiter counts the points
+ * where the sinks of a species exceed its mass (sink > stot) and are
+ * scaled down.
+ */
+struct activity_t {
+  size_t nlev = 0;
+  std::uint64_t calls = 0;   // graupel() calls
+  std::uint64_t columns = 0; // columns scanned
+  std::vector<std::uint64_t> active; // active points of every level
+  std::vector<std::uint64_t> kmin;   // columns by kmin, nlev + 1 bins
+  std::uint64_t precip_columns[idx::np] = {}; // with the species, by idx
+  std::uint64_t regimes[activity::n] = {};
+  std::uint64_t limited[idx::nx] = {}; // limiter activations, by idx
+
+  /* zero counts for nlev levels */
+  void reset(size_t nlev);
+};
+
+/* statistics of this process, filled by the kernels with MU_ACTIVITY_STATS */
+activity_t &activity_stats();
+
+/**
+ * @brief Adds the active points, kmin and regimes of a state to activity
+ *
+ * The state is taken as the kernel sees it on entry, with the same activity
+ * condition as its scan, so that both kernels share one definition.
+ *
+ * @param [in] state Fields of ivend columns
+ * @param [in] ke Number of levels
+ * @param [in] ivstart First column
+ * @param [in] ivend End of the columns
+ * @param [in,out] activity Counts, reset when the levels differ
+ */
+void count_activity(const State &state, size_t ke, size_t ivstart,
+                    size_t ivend, activity_t &activity);
+
+} // namespace utils_muphys
+
+// With MU_ACTIVITY_STATS the kernels count where they have work, otherwise
+// the instrumentation compiles to nothing
+#ifdef MU_ACTIVITY_STATS
+#define MU_ACTIVITY_SCAN(state, ke, ivstart, ivend)                            \
+  utils_muphys::count_activity(state, ke, ivstart, ivend,                      \
+                               utils_muphys::activity_stats())
+#define MU_ACTIVITY_LIMITED(ix) ++utils_muphys::activity_stats().limited[ix]
+#else
+#define MU_ACTIVITY_SCAN(state, ke, ivstart, ivend)
+#define MU_ACTIVITY_LIMITED(ix)
+#endif
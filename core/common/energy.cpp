@@ -0,0 +1,183 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "energy.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+static std::string read_line(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+/* energy_uj of a zone, false if it cannot be read */
+static bool read_energy(const std::string &file, std::uint64_t &uj) {
+  std::ifstream in(file);
+  return static_cast<bool>(in >> uj);
+}
+
+static double seconds_now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string utils_muphys::rapl_root() {
+  const char *root = std::getenv("MU_RAPL_ROOT");
+  return root && *root ? root : "/sys/class/powercap";
+}
+
+utils_muphys::energy_meter::energy_meter(const std::string &root,
+                                         double interval) {
+  std::error_code error;
+  std::vector<std::string> names;
+  for (const auto &entry : std::filesystem::directory_iterator(root, error)) {
+    const std::string name = entry.path().filename().string();
+    // intel-rapl:<socket>[:<sub>]; the intel-rapl control type and the
+    // intel-rapl-mmio duplicates of the packages are skipped
+    if (name.rfind("intel-rapl:", 0) == 0)
+      names.push_back(name);
+  }
+  if (error || names.empty()) {
+    reason = "no RAPL zones in " + root;
+    return;
+  }
+  std::sort(names.begin(), names.end());
+
+  for (const std::string &name : names) {
+    const std::filesystem::path dir = std::filesystem::path(root) / name;
+    const std::string zone_name = read_line(dir / "name");
+    zone_t zone;
+    if (zone_name.rfind("package", 0) == 0)
+      zone.domain = energy::package;
+    else if (zone_name == "dram")
+      zone.domain = energy::dram;
+    else
+      continue; // core, uncore and psys overlap the package
+    zone.file = (dir / "energy_uj").string();
+    if (!read_energy(zone.file, zone.last)) {
+      reason += std::string(reason.empty() ? "" : "; ") + name +
+                "/energy_uj is not readable";
+      continue;
+    }
+    const std::string range = read_line(dir / "max_energy_range_uj");
+    if (!range.empty())
+      zone.range = std::strtod(range.c_str(), nullptr);
+    domains |= 1u << zone.domain;
+    zones.push_back(zone);
+  }
+  if (zones.empty() && reason.empty())
+    reason = "no package or dram zones in " + root;
+  if (!zones.empty() && interval > 0.0)
+    poller = std::thread(&energy_meter::poll, this, interval);
+}
+
+utils_muphys::energy_meter::~energy_meter() {
+  if (!poller.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cv.notify_all();
+  poller.join();
+}
+
+void utils_muphys::energy_meter::poll(double interval) {
+  const auto period = std::chrono::duration<double>(interval);
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!cv.wait_for(lock, period, [this] { return stop; }))
+    update();
+}
+
+void utils_muphys::energy_meter::sample() {
+  std::lock_guard<std::mutex> lock(mutex);
+  update();
+}
+
+void utils_muphys::energy_meter::update() {
+  for (zone_t &zone : zones) {
+    std::uint64_t uj;
+    if (!read_energy(zone.file, uj))
+      continue;
+    // the counter wraps at max_energy_range_uj
+    double delta = static_cast<double>(uj) - static_cast<double>(zone.last);
+    if (uj < zone.last)
+      delta += zone.range;
+    zone.joules += 1e-6 * std::max(delta, 0.0);
+    zone.last = uj;
+  }
+}
+
+void utils_muphys::energy_meter::read(double (&joules)[energy::n]) {
+  std::lock_guard<std::mutex> lock(mutex);
+  update();
+  std::fill(joules, joules + energy::n, 0.0);
+  for (const zone_t &zone : zones)
+    joules[zone.domain] += zone.joules;
+}
+
+utils_muphys::energy_account::energy_account(energy_meter *meter)
+    : meter(meter) {
+  t0 = seconds_now();
+  begin();
+  std::copy(start, start + energy::n, origin);
+}
+
+void utils_muphys::energy_account::sample(double (&joules)[energy::n]) {
+  if (meter)
+    meter->read(joules);
+  else
+    std::fill(joules, joules + energy::n, 0.0);
+  elapsed = seconds_now() - t0;
+  std::copy(joules, joules + energy::n, last);
+}
+
+void utils_muphys::energy_account::begin() { sample(start); }
+
+void utils_muphys::energy_account::end(const std::string &name) {
+  double now[energy::n];
+  sample(now);
+  auto it = std::find_if(phases.begin(), phases.end(),
+                         [&](const phase_t &p) { return p.name == name; });
+  if (it == phases.end()) {
+    phases.push_back({name});
+    it = phases.end() - 1;
+  }
+  for (size_t d = 0; d < energy::n; ++d)
+    it->joules[d] += now[d] - start[d];
+  std::copy(now, now + energy::n, start);
+}
+
+utils_muphys::energy_summary_t utils_muphys::energy_account::summary(
+    const std::vector<std::string> &names) const {
+  energy_summary_t summary;
+  summary.phases = names;
+  for (const std::string &name : names) {
+    std::array<double, energy::n> joules{};
+    for (const phase_t &p : phases)
+      if (p.name == name)
+        std::copy(p.joules, p.joules + energy::n, joules.begin());
+    summary.joules.push_back(joules);
+  }
+  for (size_t d = 0; d < energy::n; ++d)
+    summary.total[d] = last[d] - origin[d];
+  summary.seconds = elapsed;
+  summary.nodes = meter ? 1 : 0;
+  summary.mask = meter ? meter->mask() : 0;
+  return summary;
+}
@@ -0,0 +1,137 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace energy {
+// RAPL domains, summed over the sockets of the node
+constexpr size_t package = 0;
+constexpr size_t dram = 1;
+constexpr size_t n = 2;
+
+constexpr const char *names[n] = {"package", "dram"};
+} // namespace energy
+
+namespace utils_muphys {
+
+/* powercap directory of the RAPL zones: MU_RAPL_ROOT or /sys/class/powercap */
+std::string rapl_root();
+
+/**
+ * @brief Energy counters of the RAPL package and DRAM zones of the node
+ *
+ * Every intel-rapl:<socket> zone and its intel-rapl:<socket>:<sub> subzones
+ * named "package-<socket>" or "dram" under root is read from its energy_uj
+ * file; wraparounds at max_energy_range_uj are added back. A directory of the
+ * same layout with plain files stands in for machines without RAPL, e.g.
+ * MU_RAPL_ROOT=<dir> with <dir>/intel-rapl:0/{name,energy_uj,...}. Zones
+ * that cannot be read, energy_uj is only readable by root on recent
+ * kernels, are left out and status() says why.
+ *
+ * A wrap is only detected if at most one falls between two reads, so a
+ * background thread also reads the counters every interval seconds; the
+ * package range of about 262 kJ lasts minutes even at full power.
+ */
+class energy_meter {
+public:
+  explicit energy_meter(const std::string &root = rapl_root(),
+                        double interval = 1.0);
+  ~energy_meter();
+
+  energy_meter(const energy_meter &) = delete;
+  energy_meter &operator=(const energy_meter &) = delete;
+
+  /* joules of every domain since construction, 0 for unavailable ones */
+  void read(double (&joules)[energy::n]);
+  /* reads the counters once, as the background thread does every interval */
+  void sample();
+
+  /* bit d is set if domain d is counted */
+  unsigned mask() const { return domains; }
+  const std::string &status() const { return reason; }
+
+private:
+  struct zone_t {
+    std::string file;      // energy_uj
+    size_t domain;
+    double range = 0.0;    // max_energy_range_uj, 0 if unknown
+    std::uint64_t last = 0;
+    double joules = 0.0;   // since construction
+  };
+
+  /* adds the energy since the last read of every zone, under mutex */
+  void update();
+  void poll(double interval);
+
+  std::vector<zone_t> zones;
+  unsigned domains = 0;
+  std::string reason;
+
+  bool stop = false;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::thread poller;
+};
+
+/* energy of the phases and of the whole run, of a node or summed over nodes */
+struct energy_summary_t {
+  std::vector<std::string> phases;
+  std::vector<std::array<double, energy::n>> joules; // of every phase
+  double total[energy::n] = {};
+  double seconds = 0.0; // wall time of the total, the longest of the nodes
+  int nodes = 1;        // nodes that measured
+  unsigned mask = 0;    // bit d is set if domain d is counted on all nodes
+};
+
+/**
+ * @brief Energy of the phases of a run
+ *
+ * Each end(phase) adds the energy since the last begin() or end() to the
+ * phase, repeated phases accumulate. Without a meter every phase has zero
+ * energy, so that MPI ranks that do not measure take part in reductions.
+ */
+class energy_account {
+public:
+  explicit energy_account(energy_meter *meter = nullptr);
+
+  void begin();
+  void end(const std::string &phase);
+
+  /* the given phases, zero if one never ended, and the total from the
+   * construction to the last begin() or end() */
+  energy_summary_t summary(const std::vector<std::string> &names) const;
+
+private:
+  struct phase_t {
+    std::string name;
+    double joules[energy::n] = {};
+  };
+
+  void sample(double (&joules)[energy::n]);
+
+  energy_meter *meter;
+  std::vector<phase_t> phases;
+  double origin[energy::n] = {}; // at construction
+  double start[energy::n] = {};  // at the last begin() or end()
+  double last[energy::n] = {};
+  double t0 = 0.0, elapsed = 0.0;
+};
+
+} // namespace utils_muphys
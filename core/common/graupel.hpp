@@ -11,7 +11,11 @@
 //
 #pragma once
 
+#include "activity.hpp"
 #include "constants.hpp"
+#include "index.hpp"
+#include "state.hpp"
+#include "timer.hpp"
 #include "types.hpp"
 
 #include "../transitions/cloud_to_graupel.hpp"
@@ -50,31 +54,20 @@
  * @param [in] ivend End index for horizontal direction
  * @param [in] kstart Start index for vertical direction
  * @param [in] dt Time step for integration of microphysics (s)
- * @param [in] dz Layer thickness of full levels (m)
- * @param [inout] t Temperature in Kelvin
- * @param [in] rho Density of moist air (kg/m3)
- * @param [in] p Pressure (Pa)
- * @param [inout] qv Specific water vapor content (kg/kg)
- * @param [inout] qc Specific cloud water content (kg/kg)
- * @param [inout] qi Specific cloud ice content (kg/kg)
- * @param [inout] qr Specific rain content (kg/kg)
- * @param [inout] qs Specific snow content  kg/kg)
- * @param [inout] qg Specific graupel content (kg/kg)
+ * @param [inout] state State tensor (see fld) holding
+ *   - [in] dz Layer thickness of full levels (m), or the full level heights (m)
+ *     when built with MU_DZ_ON_THE_FLY
+ *   - [inout] t Temperature in Kelvin
+ *   - [in] rho Density of moist air (kg/m3)
+ *   - [in] p Pressure (Pa)
+ *   - [inout] qv, qc, qi, qr, qs, qg Specific water vapor, cloud water, cloud
+ *     ice, rain, snow and graupel content (kg/kg)
+ *   - [out] prr, pri, prs, prg Precipitation rate of rain, ice, snow and
+ *     graupel, grid-scale (kg/(m2*s))
+ *   - [out] pre Energy flux due to precipitation (W/m2)
+ *   - [out] pflx Total precipitation flux
  * @param [in] qnc Cloud number concentration
- * @param [out] prr_gsp Precipitation rate of rain, grid-scale (kg/(m2*s))
- * @param [out] pri_gsp Precipitation rate of ice, grid-scale (kg/(m2*s))
- * @param [out] prs_gsp Precipitation rate of snow, grid-scale (kg/(m2*s))
- * @param [out] prg_gsp Precipitation rate of graupel, grid-scale (kg/(m2*s))
- * @param [out] pflx Total precipitation flux
  *
  */
 void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
-             size_t &kstart, real_t &dt, array_1d_t<real_t> &dz,
-             array_1d_t<real_t> &t, array_1d_t<real_t> &rho,
-             array_1d_t<real_t> &p, array_1d_t<real_t> &qv,
-             array_1d_t<real_t> &qc, array_1d_t<real_t> &qi,
-             array_1d_t<real_t> &qr, array_1d_t<real_t> &qs,
-             array_1d_t<real_t> &qg, real_t &qnc, array_1d_t<real_t> &prr_gsp,
-             array_1d_t<real_t> &pri_gsp, array_1d_t<real_t> &prs_gsp,
-             array_1d_t<real_t> &prg_gsp, array_1d_t<real_t> &pre_gsp,
-             array_1d_t<real_t> &pflx);
+             size_t &kstart, real_t &dt, State &state, real_t &qnc);
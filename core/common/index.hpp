@@ -0,0 +1,98 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Compact index types of the kernel work arrays. Field offsets are still
+// formed in size_t, since nx * nlev * ncells exceeds 32 bits on large grids.
+// MU_PACKED_INDEX_BITS only sizes the packed word below, these two stay
+// fixed, so a 64-bit word does not admit more than 4G points.
+using level_index_t = std::uint16_t; // vertical level, e.g. kmin
+using point_index_t = std::uint32_t; // grid point of [nlev][ncells], prefixsum
+
+#if MU_PACKED_INDEX_BITS == 32
+using packed_index_t = std::uint32_t;
+#else
+using packed_index_t = std::uint64_t;
+#endif
+
+/**
+ * @brief (k, iv) pair of an active point packed into a single word
+ *
+ * The level occupies the upper bits and the cell the lower bits, so packed
+ * words order like the (k, iv) pairs they encode.
+ *
+ * @tparam word_t Unsigned word type, 32 or 64 bits
+ */
+template <typename word_t> struct packed_kiv {
+  static_assert(std::is_unsigned_v<word_t> &&
+                    (sizeof(word_t) == 4 || sizeof(word_t) == 8),
+                "packed_kiv requires a 32- or 64-bit unsigned word");
+
+  static constexpr unsigned level_bits = (sizeof(word_t) == 4) ? 8 : 16;
+  static constexpr unsigned cell_bits = 8 * sizeof(word_t) - level_bits;
+  static constexpr word_t cell_mask = (word_t{1} << cell_bits) - 1;
+
+  static constexpr word_t pack(size_t k, size_t iv) {
+    return (static_cast<word_t>(k) << cell_bits) | static_cast<word_t>(iv);
+  }
+  static constexpr size_t level(word_t w) { return w >> cell_bits; }
+  static constexpr size_t cell(word_t w) { return w & cell_mask; }
+
+  static constexpr bool fits(size_t nlev, size_t ncells) {
+    return nlev <= (size_t{1} << level_bits) &&
+           ncells <= (size_t{1} << cell_bits);
+  }
+};
+
+using kiv_t = packed_kiv<packed_index_t>;
+
+// every grid a 32-bit packed word admits fits the level and point types
+static_assert(std::numeric_limits<level_index_t>::digits >
+                  packed_kiv<std::uint32_t>::level_bits,
+              "level_index_t cannot hold nlev + 1 of a 32-bit packed grid");
+static_assert(std::numeric_limits<point_index_t>::digits >=
+                  packed_kiv<std::uint32_t>::level_bits +
+                      packed_kiv<std::uint32_t>::cell_bits,
+              "point_index_t cannot hold the points of a 32-bit packed grid");
+
+/**
+ * @brief Rejects grids whose indices do not fit into the compact index types
+ *
+ * @param [in] nlev Number of vertical levels
+ * @param [in] ncells Number of horizontal points
+ */
+inline void check_index_range(size_t nlev, size_t ncells) {
+  // kmin uses nlev + 1 as "no condensate in this column"
+  if (nlev + 1 > std::numeric_limits<level_index_t>::max() ||
+      ncells > std::numeric_limits<point_index_t>::max() ||
+      nlev * ncells > std::numeric_limits<point_index_t>::max()) {
+    throw std::runtime_error(
+        "Grid of " + std::to_string(nlev) + " levels x " +
+        std::to_string(ncells) + " cells exceeds the " +
+        std::to_string(8 * sizeof(level_index_t)) + "-bit level or " +
+        std::to_string(8 * sizeof(point_index_t)) +
+        "-bit point index type, which MU_PACKED_INDEX_BITS does not widen");
+  }
+  if (!kiv_t::fits(nlev, ncells)) {
+    throw std::runtime_error(
+        "Grid of " + std::to_string(nlev) + " levels x " +
+        std::to_string(ncells) + " cells exceeds the " +
+        std::to_string(8 * sizeof(packed_index_t)) +
+        "-bit packed (k, iv) index (see MU_PACKED_INDEX_BITS)");
+  }
+}
@@ -0,0 +1,106 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+
+#include "constants.hpp"
+#include <cstddef>
+
+/**
+ * @brief Floating-point operations of the kernel functions, counted by hand
+ *
+ * arith counts +, -, *, /, fmin and fmax, special the calls of exp, pow and
+ * sqrt; expressions of constants only are assumed to be folded. A function
+ * is counted on the branch that computes its result, so for points where
+ * it returns early the counts are an upper bound.
+ */
+namespace ops {
+
+struct op_count_t {
+  unsigned arith = 0;
+  unsigned special = 0;
+  /* special functions count as one operation each */
+  constexpr double flops() const { return arith + special; }
+};
+
+constexpr op_count_t operator+(op_count_t a, op_count_t b) {
+  return {a.arith + b.arith, a.special + b.special};
+}
+
+// core/properties
+constexpr op_count_t qsat_rho{8, 1};
+constexpr op_count_t qsat_ice_rho{8, 1};
+constexpr op_count_t internal_energy{17, 0};
+constexpr op_count_t T_from_internal_energy{19, 0};
+constexpr op_count_t snow_number{27, 3};
+constexpr op_count_t snow_lambda{4, 1};
+constexpr op_count_t ice_number{5, 1};
+constexpr op_count_t ice_mass{3, 0};
+constexpr op_count_t ice_sticking{7, 1};
+constexpr op_count_t deposition_factor{7, 1};
+constexpr op_count_t deposition_auto_conversion{5, 1};
+constexpr op_count_t ice_deposition_nucleation{4, 0};
+constexpr op_count_t fall_speed{2, 1};
+
+// core/transitions
+constexpr op_count_t cloud_to_graupel{4, 1};
+constexpr op_count_t cloud_to_rain{21, 5};
+constexpr op_count_t cloud_to_snow{4, 1};
+constexpr op_count_t cloud_x_ice{2, 0};
+constexpr op_count_t graupel_to_rain{11, 1};
+constexpr op_count_t ice_to_graupel{8, 2};
+constexpr op_count_t ice_to_snow{8, 1};
+constexpr op_count_t rain_to_graupel{14, 3};
+constexpr op_count_t rain_to_vapor{18, 2};
+constexpr op_count_t snow_to_graupel{4, 1};
+constexpr op_count_t snow_to_rain{11, 1};
+constexpr op_count_t vapor_x_graupel{12, 1};
+constexpr op_count_t vapor_x_ice{10, 1};
+constexpr op_count_t vapor_x_snow{17, 1};
+
+// Per point of the kernel phases, as graupel() combines the functions.
+// Activity scan: the maximum of the five condensates
+constexpr op_count_t scan_point{4, 0};
+
+// Transitions of every active point; the rest are the saturation deficits,
+// the sums of the limiter for v, c and r, the tendencies and the update of t
+constexpr op_count_t transition_point =
+    qsat_rho + qsat_ice_rho + snow_number + snow_lambda + cloud_to_rain +
+    rain_to_vapor + cloud_x_ice + cloud_to_snow + cloud_to_graupel +
+    op_count_t{110, 0};
+// ... below tmelt, and above it
+constexpr op_count_t transition_cold = ice_number + ice_mass + ice_sticking +
+                                       ice_deposition_nucleation +
+                                       op_count_t{1, 0};
+constexpr op_count_t transition_warm{2, 0};
+// ... with ice, snow or graupel, and the limiter sums of i, s and g
+constexpr op_count_t transition_ice = qsat_rho + vapor_x_snow +
+                                      vapor_x_graupel + snow_to_rain +
+                                      graupel_to_rain + op_count_t{28, 0};
+// ... with ice, snow or graupel below tmelt
+constexpr op_count_t transition_cold_ice =
+    deposition_factor + vapor_x_ice + deposition_auto_conversion +
+    ice_to_snow + ice_to_graupel + snow_to_graupel + rain_to_graupel +
+    op_count_t{6, 0};
+
+// Sedimentation of every level a precipitating column passes: the energy
+// budget, the fluxes and the temperature
+constexpr op_count_t sedimentation_point =
+    internal_energy + T_from_internal_energy + op_count_t{26, 1};
+// ... and of every species that sediments through the level
+constexpr op_count_t precip = fall_speed + fall_speed + op_count_t{21, 0};
+constexpr op_count_t velocity_scale[idx::np] = {
+    {0, 0},                           // rain
+    {0, 1},                           // ice
+    snow_number + op_count_t{1, 1},   // snow
+    {0, 0}};                          // graupel
+
+} // namespace ops
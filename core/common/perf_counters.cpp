@@ -0,0 +1,180 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+static bool event_attr(size_t event, perf_event_attr &attr) {
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  switch (event) {
+  case perf::cycles:
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case perf::instructions:
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case perf::llc_misses:
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    break;
+  case perf::fp_vector: {
+    const char *raw = std::getenv("MU_PERF_FP_EVENT");
+    if (!raw)
+      return false;
+    attr.type = PERF_TYPE_RAW;
+    attr.config = std::strtoull(raw, nullptr, 16);
+    break;
+  }
+  case perf::branch_misses:
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    break;
+  }
+  // user space only, which perf_event_paranoid 2 still allows
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return true;
+}
+
+static int open_event(perf_event_attr &attr, pid_t tid, int leader) {
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, tid, -1, leader, 0));
+}
+#endif
+
+utils_muphys::perf_counters::perf_counters() {
+#ifdef __linux__
+  // the events of the first thread decide the layout of all groups
+  group_t group;
+  if (!open_group(static_cast<pid_t>(syscall(SYS_gettid)), group, true))
+    return;
+  groups.push_back(std::move(group));
+  open_threads();
+#else
+  reason = "perf_event_open needs Linux";
+#endif
+}
+
+utils_muphys::perf_counters::~perf_counters() {
+  for (group_t &group : groups)
+    for (int fd : group.fds)
+      close(fd);
+}
+
+bool utils_muphys::perf_counters::open_group(pid_t tid, group_t &group,
+                                             bool probe) {
+#ifdef __linux__
+  group.tid = tid;
+  if (probe) {
+    for (size_t e = 0; e < perf::n; ++e) {
+      perf_event_attr attr;
+      if (!event_attr(e, attr)) {
+        reason += std::string(reason.empty() ? "" : "; ") + perf::names[e] +
+                  ": MU_PERF_FP_EVENT not set";
+        continue;
+      }
+      const int fd =
+          open_event(attr, tid, group.fds.empty() ? -1 : group.fds.front());
+      if (fd < 0) {
+        reason += std::string(reason.empty() ? "" : "; ") + perf::names[e] +
+                  ": " + std::strerror(errno);
+        continue;
+      }
+      group.fds.push_back(fd);
+      order.push_back(e);
+      events |= 1u << e;
+    }
+    return !group.fds.empty();
+  }
+  for (size_t e : order) {
+    perf_event_attr attr;
+    event_attr(e, attr);
+    const int fd =
+        open_event(attr, tid, group.fds.empty() ? -1 : group.fds.front());
+    if (fd < 0) {
+      // the thread has exited or cannot be counted, skip it
+      for (int open_fd : group.fds)
+        close(open_fd);
+      return false;
+    }
+    group.fds.push_back(fd);
+  }
+  return true;
+#else
+  (void)tid;
+  (void)group;
+  (void)probe;
+  return false;
+#endif
+}
+
+void utils_muphys::perf_counters::open_threads() {
+  DIR *dir = opendir("/proc/self/task");
+  if (!dir)
+    return;
+  while (const dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] == '.')
+      continue;
+    const pid_t tid = static_cast<pid_t>(std::atoi(entry->d_name));
+    if (std::any_of(groups.begin(), groups.end(),
+                    [tid](const group_t &g) { return g.tid == tid; }))
+      continue;
+    group_t group;
+    if (open_group(tid, group, false))
+      groups.push_back(std::move(group));
+  }
+  closedir(dir);
+}
+
+void utils_muphys::perf_counters::read(double (&counts)[perf::n]) {
+  std::fill(counts, counts + perf::n, 0.0);
+  if (groups.empty())
+    return;
+  open_threads();
+
+  // nr, time enabled, time running, one value per member
+  std::vector<std::uint64_t> values(3 + order.size());
+  for (group_t &group : groups) {
+    const ssize_t size = ::read(group.fds.front(), values.data(),
+                                values.size() * sizeof(std::uint64_t));
+    if (size < static_cast<ssize_t>(3 * sizeof(std::uint64_t)))
+      continue;
+    const double enabled = static_cast<double>(values[1]);
+    const double running = static_cast<double>(values[2]);
+    const double scale = running > 0.0 ? enabled / running : 0.0;
+    for (size_t i = 0; i < order.size() && i < values[0]; ++i)
+      group.last[order[i]] = scale * static_cast<double>(values[3 + i]);
+  }
+  // threads that have exited keep their last counts
+  for (const group_t &group : groups)
+    for (size_t e = 0; e < perf::n; ++e)
+      counts[e] += group.last[e];
+}
+
+utils_muphys::perf_counters &utils_muphys::process_counters() {
+  static perf_counters counters;
+  return counters;
+}
@@ -0,0 +1,79 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace perf {
+// Hardware events counted around the kernel phases; fp_vector is a raw,
+// model specific event given as MU_PERF_FP_EVENT=<hex config>
+constexpr size_t cycles = 0;
+constexpr size_t instructions = 1;
+constexpr size_t llc_misses = 2;
+constexpr size_t fp_vector = 3;
+constexpr size_t branch_misses = 4;
+constexpr size_t n = 5;
+
+constexpr const char *names[n] = {"cycles", "instructions", "llc_misses",
+                                  "fp_vector_ops", "branch_misses"};
+} // namespace perf
+
+namespace utils_muphys {
+
+/**
+ * @brief Hardware counters of all threads of the process
+ *
+ * Every thread gets one perf_event_open counter group of the events the
+ * first thread could open. Threads are looked up in /proc/self/task on
+ * every read, so pool threads started later are counted from their first
+ * read on. Counts are summed over the threads and scaled by the enabled
+ * over the running time when the groups are multiplexed. Events that cannot
+ * be opened, e.g. in containers without a PMU or with perf_event_paranoid
+ * above 2, are left out and status() says why.
+ */
+class perf_counters {
+public:
+  perf_counters();
+  ~perf_counters();
+  perf_counters(const perf_counters &) = delete;
+  perf_counters &operator=(const perf_counters &) = delete;
+
+  /* counts of all threads so far, 0 for unavailable events */
+  void read(double (&counts)[perf::n]);
+
+  /* bit e is set if event e is counted */
+  unsigned mask() const { return events; }
+  const std::string &status() const { return reason; }
+
+private:
+  struct group_t {
+    pid_t tid;
+    std::vector<int> fds; // leader first, one per counted event
+    double last[perf::n] = {};
+  };
+
+  bool open_group(pid_t tid, group_t &group, bool probe);
+  void open_threads();
+
+  std::vector<size_t> order; // events in the order of the group members
+  std::vector<group_t> groups;
+  unsigned events = 0;
+  std::string reason;
+};
+
+/* counters of this process, opened on first use */
+perf_counters &process_counters();
+
+} // namespace utils_muphys
@@ -0,0 +1,175 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "roofline.hpp"
+#include "op_counts.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+/* runs work(thread) on threads threads, started together; returns seconds
+ * from the start until the last thread is done */
+template <typename Work> double run_threads(size_t threads, Work work) {
+  std::atomic<size_t> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> pool;
+  for (size_t t = 1; t < threads; ++t)
+    pool.emplace_back([&, t] {
+      ++ready;
+      while (!go.load(std::memory_order_acquire))
+        ;
+      work(t);
+    });
+  while (ready.load() + 1 < threads)
+    ;
+  const clock_type::time_point start = clock_type::now();
+  go.store(true, std::memory_order_release);
+  work(0);
+  for (auto &thread : pool)
+    thread.join();
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+} // namespace
+
+double utils_muphys::stream_triad(size_t threads, size_t array_bytes,
+                                  int repeats) {
+  threads = std::max<size_t>(threads, 1);
+  const size_t n = array_bytes / sizeof(real_t);
+  // not value-initialised, every thread touches its own slice first
+  std::unique_ptr<real_t[]> a(new real_t[n]), b(new real_t[n]),
+      c(new real_t[n]);
+  auto slice = [&](size_t t, size_t &begin, size_t &end) {
+    begin = n * t / threads;
+    end = n * (t + 1) / threads;
+  };
+  run_threads(threads, [&](size_t t) {
+    size_t begin, end;
+    slice(t, begin, end);
+    for (size_t i = begin; i < end; ++i) {
+      a[i] = 0;
+      b[i] = 1;
+      c[i] = 2;
+    }
+  });
+
+  const real_t s = 3;
+  double best = 0.0;
+  for (int r = 0; r < repeats; ++r) {
+    const double seconds = run_threads(threads, [&](size_t t) {
+      size_t begin, end;
+      slice(t, begin, end);
+      real_t *__restrict__ pa = a.get();
+      const real_t *__restrict__ pb = b.get();
+      const real_t *__restrict__ pc = c.get();
+      for (size_t i = begin; i < end; ++i)
+        pa[i] = pb[i] + s * pc[i];
+    });
+    best = std::max(best, 3.0 * sizeof(real_t) * n / seconds);
+  }
+  return best;
+}
+
+double utils_muphys::peak_flops(size_t threads, int repeats) {
+  threads = std::max<size_t>(threads, 1);
+  // enough independent chains to cover the latency of the FP units, few
+  // enough to stay in registers once unrolled
+  constexpr size_t chains = 32;
+  constexpr size_t iterations = 1 << 23;
+  std::vector<real_t> sink(threads);
+  double best = 0.0;
+  for (int r = 0; r < repeats; ++r) {
+    const double seconds = run_threads(threads, [&](size_t t) {
+      real_t acc[chains];
+      for (size_t j = 0; j < chains; ++j)
+        acc[j] = static_cast<real_t>(j);
+      // converges to a / (1 - m), no overflow or denormals
+      const real_t m = static_cast<real_t>(0.999), a = static_cast<real_t>(1e-3);
+      for (size_t i = 0; i < iterations; ++i)
+#pragma GCC unroll 32
+        for (size_t j = 0; j < chains; ++j)
+          acc[j] = acc[j] * m + a;
+      real_t sum = 0;
+      for (size_t j = 0; j < chains; ++j)
+        sum += acc[j];
+      sink[t] = sum;
+    });
+    best = std::max(best, 2.0 * chains * iterations * threads / seconds);
+  }
+  // keep the chains alive
+  volatile real_t keep = sink[0];
+  (void)keep;
+  return best;
+}
+
+utils_muphys::roof_t utils_muphys::measure_roof(size_t threads) {
+  roof_t roof;
+  roof.threads = std::max<size_t>(threads, 1);
+  // three arrays of 64 MiB, well beyond the last-level cache
+  roof.bytes_per_second = stream_triad(roof.threads, size_t(64) << 20, 5);
+  roof.flops_per_second = peak_flops(roof.threads, 3);
+  roof.probed = true;
+  return roof;
+}
+
+void utils_muphys::phase_flops(const phase_stats_t &stats,
+                               double flops[phase::n]) {
+  std::fill(flops, flops + phase::n, 0.0);
+  flops[phase::scan] = stats.points[phase::scan] * ops::scan_point.flops();
+
+  const double active = static_cast<double>(stats.active_points);
+  const double cold = static_cast<double>(stats.cold_points);
+  flops[phase::transitions] =
+      active * ops::transition_point.flops() +
+      cold * ops::transition_cold.flops() +
+      (active - cold) * ops::transition_warm.flops() +
+      stats.ice_points * ops::transition_ice.flops() +
+      stats.cold_ice_points * ops::transition_cold_ice.flops();
+
+  flops[phase::sedimentation] =
+      stats.points[phase::sedimentation] * ops::sedimentation_point.flops();
+  for (size_t ix = 0; ix < idx::np; ++ix)
+    flops[phase::sedimentation] +=
+        stats.species_points[ix] *
+        (ops::precip.flops() + ops::velocity_scale[ix].flops());
+}
+
+utils_muphys::roofline_point_t
+utils_muphys::roofline_point(const phase_stats_t &stats, size_t id,
+                             const roof_t &roof) {
+  double flops[phase::n];
+  phase_flops(stats, flops);
+  roofline_point_t point;
+  point.flops = flops[id];
+  point.bytes = stats.bytes[id];
+  point.seconds = stats.seconds[id];
+  if (point.bytes > 0.0)
+    point.intensity = point.flops / point.bytes;
+  if (point.seconds > 0.0) {
+    point.flop_rate = point.flops / point.seconds;
+    point.byte_rate = point.bytes / point.seconds;
+  }
+  point.roof = std::min(roof.flops_per_second,
+                        point.intensity * roof.bytes_per_second);
+  point.memory_bound = point.intensity < roof.ridge();
+  if (point.roof > 0.0)
+    point.fraction = point.flop_rate / point.roof;
+  return point;
+}
@@ -0,0 +1,72 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+
+#include "timer.hpp"
+#include <cstddef>
+
+namespace utils_muphys {
+
+/* attainable memory bandwidth and floating-point rate of the machine */
+struct roof_t {
+  double bytes_per_second = 0.0;
+  double flops_per_second = 0.0;
+  size_t threads = 1;   // threads the probes ran on
+  bool probed = false;  // measured, not given
+  /* arithmetic intensity (FLOP/byte) above which a phase is compute bound */
+  double ridge() const {
+    return bytes_per_second > 0.0 ? flops_per_second / bytes_per_second : 0.0;
+  }
+};
+
+/**
+ * @brief STREAM triad a = b + s * c on threads threads
+ *
+ * Each thread initialises and updates its own slice of three arrays of
+ * array_bytes each, so pages are placed where they are used.
+ *
+ * @return Best bandwidth of the repeats in bytes/s, three arrays per element
+ */
+double stream_triad(size_t threads, size_t array_bytes, int repeats);
+
+/**
+ * @brief Multiply-add throughput of real_t on threads threads
+ *
+ * Independent accumulator chains that the compiler can vectorise with the
+ * instruction set of the build, so the result is the peak attainable by
+ * compiled code rather than the nominal peak of the CPU.
+ *
+ * @return Best rate of the repeats in FLOP/s, two per multiply-add
+ */
+double peak_flops(size_t threads, int repeats);
+
+/* both probes */
+roof_t measure_roof(size_t threads);
+
+/* FLOPs of every phase from the point counts of stats and ops */
+void phase_flops(const phase_stats_t &stats, double flops[phase::n]);
+
+/* one phase on the roofline */
+struct roofline_point_t {
+  double flops = 0.0, bytes = 0.0, seconds = 0.0;
+  double intensity = 0.0;   // FLOP/byte
+  double flop_rate = 0.0;   // achieved FLOP/s
+  double byte_rate = 0.0;   // achieved bytes/s
+  double roof = 0.0;        // attainable FLOP/s at this intensity
+  double fraction = 0.0;    // flop_rate / roof
+  bool memory_bound = true; // intensity below the ridge
+};
+
+roofline_point_t roofline_point(const phase_stats_t &stats, size_t id,
+                                const roof_t &roof);
+
+} // namespace utils_muphys
@@ -0,0 +1,111 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+
+#include "constants.hpp"
+#include "types.hpp"
+#include <utility>
+
+namespace fld {
+// Three-dimensional fields [nlev][ncells]; the water species keep their
+// slots from idx (lqr, lqi, lqs, lqg, lqc, lqv)
+constexpr size_t t = idx::nx;        // temperature
+constexpr size_t p = idx::nx + 1;    // pressure
+constexpr size_t rho = idx::nx + 2;  // density of moist air
+constexpr size_t dz = idx::nx + 3;   // full level height z, dz after calc_dz
+constexpr size_t pflx = idx::nx + 4; // total precipitation flux
+constexpr size_t n3d = idx::nx + 5;
+
+// Surface fields [ncells]; the precipitation rates keep the slots of their
+// species from idx (lqr, lqi, lqs, lqg)
+constexpr size_t pre = idx::np; // energy flux due to precipitation
+constexpr size_t n2d = idx::np + 1;
+} // namespace fld
+
+/**
+ * @brief Single contiguous state tensor of the microphysics
+ *
+ * All three-dimensional fields are stored as [field][nlev][ncells], followed
+ * by the surface fields as [field][ncells]. Field offsets are compile-time
+ * constants from fld and idx, so the kernels address every field through one
+ * base pointer. The tensor is either owned or bound to memory owned
+ * elsewhere, such as a slice of a node-wide MPI shared-memory window;
+ * copies always own their tensor.
+ */
+struct State {
+  size_t ncells = 0;
+  size_t nlev = 0;
+
+  State() = default;
+  State(const State &other) { *this = other; }
+  State(State &&other) noexcept { *this = std::move(other); }
+
+  State &operator=(const State &other) {
+    if (this != &other) {
+      ncells = other.ncells;
+      nlev = other.nlev;
+      storage.assign(other.data(), other.data() + other.size());
+      base = storage.data();
+    }
+    return *this;
+  }
+  State &operator=(State &&other) noexcept {
+    if (this != &other) {
+      ncells = other.ncells;
+      nlev = other.nlev;
+      const bool owned = other.base == other.storage.data();
+      storage = std::move(other.storage);
+      base = owned ? storage.data() : other.base;
+      other.ncells = other.nlev = 0;
+      other.base = nullptr;
+    }
+    return *this;
+  }
+
+  void allocate(size_t ncells_, size_t nlev_) {
+    ncells = ncells_;
+    nlev = nlev_;
+    storage.assign(size(), ZERO);
+    base = storage.data();
+  }
+
+  /// use size() values at data_ without owning them; they must outlive the
+  /// state
+  void bind(real_t *data_, size_t ncells_, size_t nlev_) {
+    ncells = ncells_;
+    nlev = nlev_;
+    storage = array_1d_t<real_t>();
+    base = data_;
+  }
+
+  /// number of values in the whole tensor
+  size_t size() const { return (fld::n3d * nlev + fld::n2d) * ncells; }
+  /// distance between two three-dimensional fields
+  size_t field_size() const { return nlev * ncells; }
+
+  real_t *data() { return base; }
+  const real_t *data() const { return base; }
+
+  real_t *field(size_t f) { return data() + f * field_size(); }
+  const real_t *field(size_t f) const { return data() + f * field_size(); }
+
+  real_t *surface(size_t f) {
+    return data() + fld::n3d * field_size() + f * ncells;
+  }
+  const real_t *surface(size_t f) const {
+    return data() + fld::n3d * field_size() + f * ncells;
+  }
+
+private:
+  array_1d_t<real_t> storage;
+  real_t *base = nullptr;
+};
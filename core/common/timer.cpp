@@ -0,0 +1,17 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "timer.hpp"
+
+utils_muphys::phase_stats_t &utils_muphys::phase_stats() {
+  static phase_stats_t stats;
+  return stats;
+}
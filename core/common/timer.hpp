@@ -0,0 +1,177 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+
+#include "constants.hpp"
+#include "perf_counters.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace phase {
+// Phases of graupel(); the sequential kernel compacts the active points
+// during the scan, so it has no compaction and scatter phases
+constexpr size_t scan = 0;          // activity flags and kmin of all points
+constexpr size_t compaction = 1;    // prefix sum of the activity flags
+constexpr size_t scatter = 2;       // packed (k, iv) index of active points
+constexpr size_t transitions = 3;   // phase transitions of the active points
+constexpr size_t sedimentation = 4; // precipitation down the columns
+constexpr size_t n = 5;
+
+constexpr const char *names[n] = {"scan", "compaction", "scatter",
+                                  "transitions", "sedimentation"};
+
+// Fields read or written per point: the scan reads t, rho and the six
+// species, the transitions read p, rho and update t and the species, the
+// sedimentation reads rho, dz, qv, qc and updates t, pflx and the four
+// precipitating species
+constexpr size_t scan_fields = 8;
+constexpr size_t transition_fields = 16;
+constexpr size_t sedimentation_fields = 15;
+} // namespace phase
+
+namespace utils_muphys {
+
+/**
+ * @brief Phase times and counts, accumulated over the graupel() calls
+ *
+ * Points are the grid points a phase visits, bytes the compulsory traffic
+ * of its fields, each array counted once per point. With MU_PERF_COUNTERS
+ * the hardware events of all threads are counted per phase as well.
+ */
+struct phase_stats_t {
+  double seconds[phase::n] = {};
+  std::uint64_t points[phase::n] = {};
+  double bytes[phase::n] = {};
+  std::uint64_t calls = 0;          // graupel() calls
+  std::uint64_t active_points = 0;  // points with phase transitions
+  std::uint64_t precip_columns = 0; // columns with precipitation
+  // active points by the branches of the transitions, for the FLOP count
+  std::uint64_t cold_points = 0;     // below tmelt
+  std::uint64_t ice_points = 0;      // with ice, snow or graupel
+  std::uint64_t cold_ice_points = 0; // both
+  /* levels each precipitating species sediments through */
+  std::uint64_t species_points[idx::np] = {};
+  double events[phase::n][perf::n] = {};
+  unsigned perf_events = 0; // bit e is set if event e was counted
+};
+
+/* statistics of this process */
+phase_stats_t &phase_stats();
+
+/* levels a column sediments through from its first level kmin (ke + 1
+ * without precipitation), kstart at the earliest, down to k_end; the kernels
+ * count phase_stats_t::sedimentation and species_points with it */
+inline size_t sedimentation_levels(size_t kstart, size_t k_end, size_t kmin) {
+  return k_end - std::min(k_end, std::max(kstart, kmin));
+}
+
+/* wall time of consecutive phases, each stop() starts the next phase; with
+ * MU_TRACE the phases are also trace events */
+class phase_timer {
+public:
+  phase_timer() {
+#ifdef MU_PHASE_TIMERS
+    ++phase_stats().calls;
+#endif
+    restart();
+  }
+
+  void restart() {
+#ifdef MU_PERF_COUNTERS
+    process_counters().read(counts);
+#endif
+    start = clock::now();
+  }
+
+  void stop([[maybe_unused]] size_t id, [[maybe_unused]] std::uint64_t points,
+            [[maybe_unused]] double bytes) {
+    [[maybe_unused]] const clock::time_point now = clock::now();
+#ifdef MU_TRACE
+    if (trace_active.load(std::memory_order_relaxed))
+      trace_record(phase::names[id], nanoseconds(start), nanoseconds(now));
+#endif
+#ifdef MU_PHASE_TIMERS
+    phase_stats_t &stats = phase_stats();
+    stats.seconds[id] += std::chrono::duration<double>(now - start).count();
+    stats.points[id] += points;
+    stats.bytes[id] += bytes;
+#ifdef MU_PERF_COUNTERS
+    double next[perf::n];
+    process_counters().read(next);
+    for (size_t e = 0; e < perf::n; ++e) {
+      stats.events[id][e] += next[e] - counts[e];
+      counts[e] = next[e];
+    }
+    stats.perf_events = process_counters().mask();
+#endif
+#endif
+    start = clock::now();
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+  static std::int64_t nanoseconds(clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               t.time_since_epoch())
+        .count();
+  }
+  clock::time_point start;
+#ifdef MU_PERF_COUNTERS
+  double counts[perf::n];
+#endif
+};
+
+} // namespace utils_muphys
+
+// With MU_PHASE_TIMERS the kernels time their phases, with MU_TRACE alone
+// they only trace them, otherwise the instrumentation compiles to nothing
+#if defined(MU_PHASE_TIMERS) || defined(MU_TRACE)
+#define MU_PHASE_TIMER(timer) utils_muphys::phase_timer timer
+#define MU_PHASE_RESTART(timer) timer.restart()
+#else
+#define MU_PHASE_TIMER(timer)
+#define MU_PHASE_RESTART(timer)
+#endif
+
+#ifdef MU_PHASE_TIMERS
+#define MU_PHASE_STOP(timer, id, points, bytes)                                \
+  timer.stop(phase::id, points, bytes)
+#define MU_PHASE_COUNTS(active, columns)                                       \
+  do {                                                                         \
+    utils_muphys::phase_stats().active_points += active;                       \
+    utils_muphys::phase_stats().precip_columns += columns;                     \
+  } while (0)
+#define MU_PHASE_BRANCH_COUNTS(cold, ice, cold_ice)                            \
+  do {                                                                         \
+    utils_muphys::phase_stats().cold_points += cold;                           \
+    utils_muphys::phase_stats().ice_points += ice;                             \
+    utils_muphys::phase_stats().cold_ice_points += cold_ice;                   \
+  } while (0)
+#define MU_PHASE_SPECIES_COUNTS(species)                                       \
+  do {                                                                         \
+    for (size_t ix_ = 0; ix_ < idx::np; ++ix_)                                 \
+      utils_muphys::phase_stats().species_points[ix_] += species[ix_];         \
+  } while (0)
+#else
+// the counts of the points are only computed for the timers
+#ifdef MU_TRACE
+#define MU_PHASE_STOP(timer, id, points, bytes) timer.stop(phase::id, 0, 0.0)
+#else
+#define MU_PHASE_STOP(timer, id, points, bytes)
+#endif
+#define MU_PHASE_COUNTS(active, columns)
+#define MU_PHASE_BRANCH_COUNTS(cold, ice, cold_ice)
+#define MU_PHASE_SPECIES_COUNTS(species)
+#endif
@@ -0,0 +1,197 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> utils_muphys::trace_active{false};
+
+namespace {
+
+/* events of one thread; head counts all events ever recorded */
+struct ring_t {
+  std::unique_ptr<utils_muphys::trace_event_t[]> events;
+  size_t capacity = 0;
+  std::atomic<std::uint64_t> head{0};
+  int tid = 0;
+  std::string name;
+  bool named = false; // by trace_thread_name()
+};
+
+/* rings of all threads, they outlive the threads for the dump; the rings
+ * of ended threads are taken over by new ones, so the short-lived I/O
+ * worker threads share a few tracks */
+struct registry_t {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ring_t>> rings;
+  std::vector<ring_t *> free;
+  size_t capacity = size_t(1) << 16;
+  std::int64_t origin = 0;
+};
+
+registry_t &registry() {
+  static registry_t instance;
+  return instance;
+}
+
+/* the ring of a thread, handed back when the thread ends */
+struct thread_ring_t {
+  ring_t *ring = nullptr;
+  ~thread_ring_t() {
+    if (ring) {
+      std::lock_guard<std::mutex> lock(registry().mutex);
+      registry().free.push_back(ring);
+    }
+  }
+};
+
+thread_local thread_ring_t this_thread;
+
+/* the ring of the calling thread, registered on first use */
+ring_t &thread_ring() {
+  if (!this_thread.ring) {
+    registry_t &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (!reg.free.empty()) {
+      this_thread.ring = reg.free.back();
+      reg.free.pop_back();
+    } else {
+      reg.rings.push_back(std::make_unique<ring_t>());
+      ring_t *ring = reg.rings.back().get();
+      ring->tid = static_cast<int>(reg.rings.size()) - 1;
+      ring->name = "thread " + std::to_string(ring->tid);
+      this_thread.ring = ring;
+    }
+  }
+  return *this_thread.ring;
+}
+
+std::string escape(const std::string &s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+} // namespace
+
+void utils_muphys::trace_start(size_t capacity) {
+  registry_t &reg = registry();
+  {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.capacity = std::max<size_t>(capacity, 1);
+    reg.origin = trace_now();
+  }
+  // the starting thread is the first track
+  ring_t &ring = thread_ring();
+  {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (!ring.named)
+      ring.name = "main";
+  }
+  trace_active.store(true, std::memory_order_release);
+}
+
+void utils_muphys::trace_stop() {
+  trace_active.store(false, std::memory_order_release);
+}
+
+std::int64_t utils_muphys::trace_origin() { return registry().origin; }
+
+void utils_muphys::trace_record(const char *name, std::int64_t begin,
+                                std::int64_t end) {
+  ring_t &ring = thread_ring();
+  if (!ring.events) {
+    {
+      std::lock_guard<std::mutex> lock(registry().mutex);
+      ring.capacity = registry().capacity;
+    }
+    ring.events.reset(new trace_event_t[ring.capacity]);
+  }
+  const std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+  ring.events[head % ring.capacity] = {name, begin, end};
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void utils_muphys::trace_thread_name(const std::string &name) {
+  ring_t &ring = thread_ring();
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  ring.name = name;
+  ring.named = true;
+}
+
+std::uint64_t utils_muphys::trace_dropped() {
+  registry_t &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  std::uint64_t dropped = 0;
+  for (const auto &ring : reg.rings) {
+    const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+    if (head > ring->capacity)
+      dropped += head - ring->capacity;
+  }
+  return dropped;
+}
+
+std::string utils_muphys::trace_events_json(const std::string &process,
+                                           int pid, std::int64_t offset) {
+  registry_t &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  std::string json;
+  char buffer[96];
+  auto append = [&](const std::string &object) {
+    if (!json.empty())
+      json += ",\n";
+    json += object;
+  };
+
+  append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" +
+         std::to_string(pid) + ",\"args\":{\"name\":\"" + escape(process) +
+         "\"}}");
+  for (const auto &ring : reg.rings) {
+    const std::string ids = "\"pid\":" + std::to_string(pid) +
+                            ",\"tid\":" + std::to_string(ring->tid);
+    append("{\"name\":\"thread_name\",\"ph\":\"M\"," + ids +
+           ",\"args\":{\"name\":\"" + escape(ring->name) + "\"}}");
+    append("{\"name\":\"thread_sort_index\",\"ph\":\"M\"," + ids +
+           ",\"args\":{\"sort_index\":" + std::to_string(ring->tid) + "}}");
+
+    const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+    const std::uint64_t n = std::min<std::uint64_t>(head, ring->capacity);
+    for (std::uint64_t i = head - n; i < head; ++i) {
+      const trace_event_t &event = ring->events[i % ring->capacity];
+      std::snprintf(buffer, sizeof(buffer), ",\"ts\":%.3f,\"dur\":%.3f}",
+                    1e-3 * static_cast<double>(event.begin + offset),
+                    1e-3 * static_cast<double>(event.end - event.begin));
+      append("{\"name\":\"" + escape(event.name) + "\",\"ph\":\"X\"," + ids +
+             buffer);
+    }
+  }
+  return json;
+}
+
+void utils_muphys::write_trace(const std::string &file) {
+  std::ofstream out(file);
+  if (!out)
+    throw std::runtime_error("cannot open the trace file " + file);
+  out << "{\"traceEvents\":[\n"
+      << trace_events_json("graupel", 0, -trace_origin())
+      << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
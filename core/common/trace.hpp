@@ -0,0 +1,109 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace utils_muphys {
+
+/* a finished scope of one thread, steady_clock nanoseconds */
+struct trace_event_t {
+  const char *name; // string literal, not copied
+  std::int64_t begin;
+  std::int64_t end;
+};
+
+/* set between trace_start() and trace_stop() */
+extern std::atomic<bool> trace_active;
+
+inline std::int64_t trace_now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief Starts recording the scopes of all threads
+ *
+ * Every thread records into its own ring of capacity events, allocated at
+ * its first event and kept after the thread ends. Only the recording thread
+ * writes its ring, so recording takes no lock; when a ring is full the
+ * oldest events are overwritten and counted as dropped.
+ */
+void trace_start(size_t capacity = size_t(1) << 16);
+
+/* stops recording, the rings keep their events for the dump */
+void trace_stop();
+
+/* steady_clock time of trace_start() */
+std::int64_t trace_origin();
+
+/* appends a scope to the ring of the calling thread */
+void trace_record(const char *name, std::int64_t begin, std::int64_t end);
+
+/* names the track of the calling thread, e.g. "writer" */
+void trace_thread_name(const std::string &name);
+
+/* events overwritten in full rings */
+std::uint64_t trace_dropped();
+
+/**
+ * @brief Recorded events as Chrome Trace Event JSON objects
+ *
+ * Complete ("X") events of all threads, one track per thread of process pid,
+ * and the name metadata of the process and its threads, separated by commas
+ * and without the enclosing array so that the ranks of a run can be
+ * concatenated. Times are shifted by offset (ns) and given in microseconds.
+ * The rings must not be written meanwhile.
+ */
+std::string trace_events_json(const std::string &process, int pid,
+                              std::int64_t offset);
+
+/* {"traceEvents": [...]} of this process, for chrome://tracing or Perfetto */
+void write_trace(const std::string &file);
+
+/* records the lifetime of the object while tracing is active */
+class trace_scope {
+public:
+  explicit trace_scope(const char *name)
+      : name(trace_active.load(std::memory_order_relaxed) ? name : nullptr),
+        begin(this->name ? trace_now() : 0) {}
+  ~trace_scope() {
+    if (name)
+      trace_record(name, begin, trace_now());
+  }
+  trace_scope(const trace_scope &) = delete;
+  trace_scope &operator=(const trace_scope &) = delete;
+
+private:
+  const char *name;
+  std::int64_t begin;
+};
+
+} // namespace utils_muphys
+
+// With MU_TRACE scopes are recorded once trace_start() was called, otherwise
+// the instrumentation compiles to nothing
+#define MU_TRACE_CONCAT_(a, b) a##b
+#define MU_TRACE_CONCAT(a, b) MU_TRACE_CONCAT_(a, b)
+#ifdef MU_TRACE
+#define MU_TRACE_SCOPE(name)                                                   \
+  utils_muphys::trace_scope MU_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define MU_TRACE_THREAD(name) utils_muphys::trace_thread_name(name)
+#else
+#define MU_TRACE_SCOPE(name)
+#define MU_TRACE_THREAD(name)
+#endif
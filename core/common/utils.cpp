@@ -10,26 +10,65 @@
 // ---------------------------------------------------------------
 //
 #include "utils.hpp"
+#include "../properties/thermo.hpp"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <sys/resource.h>
 
 void utils_muphys::calc_dz(array_1d_t<real_t> &z, array_1d_t<real_t> &dz,
                            size_t &ncells, size_t &nlev) {
   dz.resize(ncells * nlev);
-  array_2d_t<real_t> zh(nlev + 1, array_1d_t<real_t>(ncells));
+  calc_dz(z.data(), dz.data(), ncells, nlev);
+}
 
-  for (size_t i = 0; i < ncells; i++) {
-    zh[nlev][i] = (static_cast<real_t>(3.0) * z[i + (nlev - 1) * (ncells)] -
-                   z[i + (nlev - 2) * (ncells)]) *
-                  static_cast<real_t>(0.5);
+void utils_muphys::calc_dz(const real_t *z, real_t *dz, size_t ncells,
+                           size_t nlev) {
+  // Column by column, so that the half level heights never leave registers
+  // instead of being stored as a second (nlev + 1) x ncells field.
+  for (size_t j = 0; j < ncells; j++) {
+    calc_dz_column(z + j, dz + j, nlev, ncells, 0);
   }
+}
 
-  // The loop is intentionally i<nlev; since we are using an unsigned integer
-  // data type, when i reaches 0, and you try to decrement further, (to -1), it
-  // wraps to the maximum value representable by size_t.
-  for (size_t i = nlev - 1; i < nlev; --i) {
+void utils_muphys::active_levels(const State &state, size_t ncells,
+                                 size_t nlev, std::uint32_t *active) {
+  using namespace idx;
+  const real_t *t = state.field(fld::t);
+  const real_t *rho = state.field(fld::rho);
+  std::fill(active, active + ncells, 0);
+  // same condition as the gather of the kernels
+  for (size_t k = 0; k < nlev; k++) {
     for (size_t j = 0; j < ncells; j++) {
-      zh[i][j] = static_cast<real_t>(2.0) * z[j + (i * ncells)] - zh[i + 1][j];
-      dz[i * ncells + j] = -zh[i + 1][j] + zh[i][j];
+      const size_t i = k * ncells + j;
+      const bool condensate =
+          std::max({state.field(lqc)[i], state.field(lqr)[i],
+                    state.field(lqs)[i], state.field(lqi)[i],
+                    state.field(lqg)[i]}) > graupel_ct::qmin;
+      const bool ice_supersaturated =
+          t[i] < graupel_ct::tfrz_het2 &&
+          state.field(lqv)[i] > thermo::qsat_ice_rho(t[i], rho[i]);
+      active[j] += condensate || ice_supersaturated;
     }
   }
 }
+
+void utils_muphys::restore_state(const State &snapshot, State &state) {
+  if (snapshot.ncells != state.ncells || snapshot.nlev != state.nlev)
+    throw std::invalid_argument("snapshot and state differ in shape");
+  // the species and t are the leading fields of the tensor
+  static_assert(fld::t == idx::nx, "t must follow the species");
+  std::copy(snapshot.field(0), snapshot.field(fld::t + 1), state.field(0));
+  std::copy(snapshot.field(fld::pflx), snapshot.field(fld::pflx + 1),
+            state.field(fld::pflx));
+  std::copy(snapshot.surface(0), snapshot.surface(fld::n2d), state.surface(0));
+}
+
+size_t utils_muphys::peak_memory() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage)) {
+    return 0;
+  }
+  // ru_maxrss is reported in kilobytes on Linux
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
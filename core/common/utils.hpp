@@ -10,9 +10,104 @@
 // ---------------------------------------------------------------
 //
 #pragma once
+#include "state.hpp"
 #include "types.hpp"
+#include <cstdint>
 
 namespace utils_muphys {
 void calc_dz(array_1d_t<real_t> &z, array_1d_t<real_t> &dz, size_t &ncells,
              size_t &nlev);
+/* z and dz may alias, e.g. the dz slot of the state tensor holding z */
+void calc_dz(const real_t *z, real_t *dz, size_t ncells, size_t nlev);
+
+/**
+ * @brief Layer thickness of a single column, derived from full level heights
+ *
+ * Reproduces calc_dz bit for bit. z and dz may alias, since every height is
+ * read before the thickness of the same level is stored.
+ *
+ * @param [in] z Full level height of the top level of the column (m)
+ * @param [out] dz Layer thickness of the top level of the column (m)
+ * @param [in] nlev Number of vertical levels
+ * @param [in] stride Distance between two vertical levels (ncells)
+ * @param [in] kmin Uppermost level for which dz is stored; the heights above
+ *                 it are not read, and nothing for kmin >= nlev
+ */
+TARGET void calc_dz_column(const real_t *z, real_t *dz, size_t nlev,
+                           size_t stride, size_t kmin) {
+  // a dry column needs no thickness, so its heights are not read at all
+  if (kmin >= nlev)
+    return;
+  real_t zh_kp1 = (static_cast<real_t>(3.0) * z[(nlev - 1) * stride] -
+                   z[(nlev - 2) * stride]) *
+                  static_cast<real_t>(0.5);
+
+  for (size_t k = nlev - 1; k < nlev; --k) {
+    // the half levels are summed bottom up, the levels above kmin are not
+    // needed
+    if (k < kmin)
+      break;
+    real_t zh_k = static_cast<real_t>(2.0) * z[k * stride] - zh_kp1;
+    dz[k * stride] = -zh_kp1 + zh_k;
+    zh_kp1 = zh_k;
+  }
+}
+
+/**
+ * @brief Bytes of memory traffic spent on the layer thickness over a run
+ *
+ * calc_dz reads z and writes dz once for all points. With MU_DZ_ON_THE_FLY
+ * every kernel call reads z and writes the dz scratch in pflx from the top
+ * of the precipitation down; the estimate takes all points, so it is an
+ * upper bound for inputs with dry columns.
+ *
+ * @param [in] calls Number of kernel calls of the run
+ */
+inline double dz_traffic_bytes(size_t ncells, size_t nlev,
+                               [[maybe_unused]] size_t calls) {
+#ifdef MU_DZ_ON_THE_FLY
+  return 2.0 * sizeof(real_t) * ncells * nlev * calls;
+#else
+  return 2.0 * sizeof(real_t) * ncells * nlev;
+#endif
 }
+
+/* how dz_traffic_bytes is spent, for the reports */
+#ifdef MU_DZ_ON_THE_FLY
+inline constexpr const char *dz_mode = "on the fly, at most";
+#else
+inline constexpr const char *dz_mode = "calc_dz once";
+#endif
+
+/**
+ * @brief Number of active levels of every column
+ *
+ * A level is active if the kernels compute phase transitions for it, i.e.
+ * with condensate above qmin or supersaturation over ice below tfrz_het2.
+ * The count estimates the cost of a column for load balancing.
+ *
+ * @param [in] state Fields of ncells columns, before or after calc_dz
+ * @param [out] active Active levels per column, ncells entries
+ */
+void active_levels(const State &state, size_t ncells, size_t nlev,
+                   std::uint32_t *active);
+
+/**
+ * @brief Restores the fields the kernels update from a snapshot
+ *
+ * Copies the species, temperature, precipitation flux and surface fields,
+ * which is all a kernel call changes; p, rho and dz are only read and are
+ * left as they are. Both states must have the same shape.
+ *
+ * @param [in] snapshot State before the kernel call
+ * @param [inout] state State to reset
+ */
+void restore_state(const State &snapshot, State &state);
+
+/**
+ * @brief High-water mark of the resident set size of this process
+ *
+ * @return Peak resident memory in bytes
+ */
+size_t peak_memory();
+} // namespace utils_muphys
@@ -10,7 +10,9 @@
 // ---------------------------------------------------------------
 //
 #include "core/common/graupel.hpp"
+#include "core/common/utils.hpp"
 #include <algorithm>
+#include <array>
 #include <iostream>
 #include <numeric>
 
@@ -21,11 +23,9 @@ using namespace idx;
 using namespace graupel_ct;
 
 struct t_qx_ptr {
-  t_qx_ptr(array_1d_t<real_t> &p_, array_1d_t<real_t> &x_) : p(p_), x(x_) {}
-
-  array_1d_t<real_t> &p;
-  array_1d_t<real_t> &x;
-}; // pointer vector
+  real_t *p; // precipitation rate [ncells], nullptr for non-precipitating
+  real_t *x; // specific mass [nlev][ncells]
+}; // views into the state tensor
 
 /**
  * @brief TODO
@@ -57,24 +57,17 @@ void precip(const real_t (&params)[3], real_t (&precip)[3], real_t zeta,
 }
 
 void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
-             size_t &kstart, real_t &dt, array_1d_t<real_t> &dz,
-             array_1d_t<real_t> &t, array_1d_t<real_t> &rho,
-             array_1d_t<real_t> &p, array_1d_t<real_t> &qv,
-             array_1d_t<real_t> &qc, array_1d_t<real_t> &qi,
-             array_1d_t<real_t> &qr, array_1d_t<real_t> &qs,
-             array_1d_t<real_t> &qg, real_t &qnc, array_1d_t<real_t> &prr_gsp,
-             array_1d_t<real_t> &pri_gsp, array_1d_t<real_t> &prs_gsp,
-             array_1d_t<real_t> &prg_gsp, array_1d_t<real_t> &pre_gsp,
-             array_1d_t<real_t> &pflx) {
+             size_t &kstart, real_t &dt, State &state, real_t &qnc) {
   // std::cout << "sequential graupel" << std::endl;
+  check_index_range(ke, ivend);
+  MU_ACTIVITY_SCAN(state, ke, ivstart, ivend);
 
   array_1d_t<bool> is_sig_present(nvec *
                                   ke); // is snow, ice or graupel present?
 
-  array_1d_t<size_t> ind_k(nvec * ke),
-      ind_i(nvec * ke); // k index of gathered point, iv index of gathered point
-  array_2d_t<size_t> kmin(
-      nvec, array_1d_t<size_t>(np)); // first level with condensate
+  array_1d_t<packed_index_t> ind_kiv(nvec * ke); // (k, iv) of gathered point
+  array_2d_t<level_index_t> kmin(
+      nvec, array_1d_t<level_index_t>(np)); // first level with condensate
 
   real_t cv, vc, eta, zeta, qvsi, qice, qliq, qtot, dvsw, dvsw0, dvsi, n_ice,
       m_ice, x_ice, n_snow, l_snow, ice_dep, e_int, stot, xrho;
@@ -89,17 +82,21 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
          array_1d_t<real_t>(
              np)); // terminal velocity for different hydrometeor categories
 
-  array_1d_t<t_qx_ptr>
-      q{}; // vector of pointers to point to four hydrometeor inouts
-  array_1d_t<real_t> emptyArray;
-  q.emplace_back(prr_gsp, qr);
-  q.emplace_back(pri_gsp, qi);
-  q.emplace_back(prs_gsp, qs);
-  q.emplace_back(prg_gsp, qg);
+  // views into the state tensor, indexed by species
+  std::array<t_qx_ptr, nx> q;
+  for (size_t ix = 0; ix < nx; ix++) {
+    q[ix].p = (ix < np) ? state.surface(ix) : nullptr;
+    q[ix].x = state.field(ix);
+  }
 
-  q.emplace_back(emptyArray, qc);
-  q.emplace_back(emptyArray, qv);
+  real_t *t = state.field(fld::t);
+  real_t *rho = state.field(fld::rho);
+  real_t *p = state.field(fld::p);
+  real_t *dz = state.field(fld::dz);
+  real_t *pflx = state.field(fld::pflx);
+  real_t *pre_gsp = state.surface(fld::pre);
 
+  MU_PHASE_TIMER(timer);
   size_t jmx = 0;
   size_t jmx_ = jmx;
 
@@ -117,8 +114,7 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
            (q[lqv].x[oned_vec_index] >
             qsat_ice_rho(t[oned_vec_index], rho[oned_vec_index])))) {
         jmx_ = jmx_ + 1;
-        ind_k[jmx] = i;
-        ind_i[jmx] = j;
+        ind_kiv[jmx] = kiv_t::pack(i, j);
         is_sig_present[jmx] =
             std::max({q[lqs].x[oned_vec_index], q[lqi].x[oned_vec_index],
                       q[lqg].x[oned_vec_index]}) > qmin;
@@ -127,23 +123,43 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
 
       for (size_t ix = 0; ix < np; ix++) {
         if (i == (ke - 1)) {
-          kmin[j][qp_ind[ix]] = ke + 1;
+          kmin[j][qp_ind[ix]] = static_cast<level_index_t>(ke + 1);
           q[qp_ind[ix]].p[j] = ZERO;
           vt[j][ix] = ZERO;
         }
 
         if (q[qp_ind[ix]].x[oned_vec_index] > qmin) {
-          kmin[j][qp_ind[ix]] = i;
+          kmin[j][qp_ind[ix]] = static_cast<level_index_t>(i);
         }
       }
     }
   }
 
+  MU_PHASE_STOP(timer, scan, ke * (ivend - ivstart),
+                static_cast<double>(ke * (ivend - ivstart)) *
+                        phase::scan_fields * sizeof(real_t) +
+                    static_cast<double>(jmx_) *
+                        (sizeof(packed_index_t) + sizeof(bool)));
+
+#ifdef MU_PHASE_TIMERS
+  // branches the transitions take, for their FLOP count
+  size_t cold_points = 0, ice_points = 0, cold_ice_points = 0;
+  for (size_t j = 0; j < jmx_; j++) {
+    const bool cold =
+        t[kiv_t::level(ind_kiv[j]) * ivend + kiv_t::cell(ind_kiv[j])] < tmelt;
+    cold_points += cold;
+    ice_points += is_sig_present[j];
+    cold_ice_points += cold && is_sig_present[j];
+  }
+  MU_PHASE_BRANCH_COUNTS(cold_points, ice_points, cold_ice_points);
+  MU_PHASE_RESTART(timer);
+#endif
+
   size_t k, iv;
   real_t sx2x_sum;
   for (size_t j = 0; j < jmx_; j++) {
-    k = ind_k[j];
-    iv = ind_i[j];
+    k = kiv_t::level(ind_kiv[j]);
+    iv = kiv_t::cell(ind_kiv[j]);
     oned_vec_index = k * ivend + iv;
 
     dvsw = q[lqv].x[oned_vec_index] -
@@ -244,6 +260,7 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
 
         if ((sink[qx_ind[ix]] > stot) &&
             (q[qx_ind[ix]].x[oned_vec_index] > qmin)) {
+          MU_ACTIVITY_LIMITED(qx_ind[ix]);
           real_t nextSink = ZERO;
 
           for (size_t i = 0; i < nx; i++) {
@@ -285,8 +302,44 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
     }
   }
 
+  MU_PHASE_STOP(timer, transitions, jmx_,
+                static_cast<double>(jmx_) *
+                    (phase::transition_fields * sizeof(real_t) +
+                     sizeof(packed_index_t) + sizeof(bool)));
+
   size_t kp1;
   size_t k_end = (lrain) ? ke : kstart - 1;
+  real_t dz_k;
+
+#ifdef MU_PHASE_TIMERS
+  // columns with precipitation and the levels they sediment through
+  size_t precip_columns = 0, sedimentation_points = 0, species_points[np] = {};
+  for (size_t iv = ivstart; iv < ivend; iv++) {
+    const size_t threshold = *std::min_element(kmin[iv].begin(), kmin[iv].end());
+    if (threshold < ke) {
+      ++precip_columns;
+      sedimentation_points += utils_muphys::sedimentation_levels(kstart, k_end, threshold);
+      for (size_t ix = 0; ix < np; ix++)
+        species_points[qp_ind[ix]] +=
+            utils_muphys::sedimentation_levels(kstart, k_end, kmin[iv][qp_ind[ix]]);
+    }
+  }
+  MU_PHASE_COUNTS(jmx_, precip_columns);
+  MU_PHASE_SPECIES_COUNTS(species_points);
+  MU_PHASE_RESTART(timer);
+#endif
+
+#ifdef MU_DZ_ON_THE_FLY
+  // dz holds the full level heights; pflx serves as the dz scratch column,
+  // since the thickness of each level is consumed before its flux is stored
+  for (size_t iv = ivstart; iv < ivend; iv++) {
+    utils_muphys::calc_dz_column(
+        dz + iv, pflx + iv, ke, ivend,
+        std::max(kstart, static_cast<size_t>(*std::min_element(
+                             kmin[iv].begin(), kmin[iv].end()))));
+  }
+#endif
+
   for (size_t k = kstart; k < k_end; k++) {
     for (size_t iv = ivstart; iv < ivend; iv++) {
       oned_vec_index = k * ivend + iv;
@@ -296,15 +349,20 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
 
       kp1 = std::min(ke - 1, k + 1);
       if (k >= *std::min_element(kmin[iv].begin(), kmin[iv].end())) {
+#ifdef MU_DZ_ON_THE_FLY
+        dz_k = pflx[oned_vec_index];
+#else
+        dz_k = dz[oned_vec_index];
+#endif
         qliq = q[lqc].x[oned_vec_index] + q[lqr].x[oned_vec_index];
         qice = q[lqs].x[oned_vec_index] + q[lqi].x[oned_vec_index] +
                q[lqg].x[oned_vec_index];
 
         e_int =
             internal_energy(t[oned_vec_index], q[lqv].x[oned_vec_index], qliq,
-                            qice, rho[oned_vec_index], dz[oned_vec_index]) +
+                            qice, rho[oned_vec_index], dz_k) +
             eflx[iv];
-        zeta = dt / (2.0 * dz[oned_vec_index]);
+        zeta = dt / (2.0 * dz_k);
         xrho = std::sqrt(rho_00 / rho[oned_vec_index]);
 
         for (size_t ix = 0; ix < np; ix++) {
@@ -334,11 +392,15 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
         e_int = e_int - eflx[iv];
         t[oned_vec_index] =
             T_from_internal_energy(e_int, q[lqv].x[oned_vec_index], qliq, qice,
-                                   rho[oned_vec_index], dz[oned_vec_index]);
+                                   rho[oned_vec_index], dz_k);
         if (k == ke - 1) {
           pre_gsp[iv] = eflx[iv] / dt;
         }
       }
     }
   }
+
+  MU_PHASE_STOP(timer, sedimentation, sedimentation_points,
+                static_cast<double>(sedimentation_points) *
+                    phase::sedimentation_fields * sizeof(real_t));
 }
@@ -11,6 +11,7 @@
 // ---------------------------------------------------------------
 //
 #include "core/common/graupel.hpp"
+#include "core/common/utils.hpp"
 #include <iostream>
 #include <numeric>
 #include <execution>
@@ -60,56 +61,35 @@ inline void precip(const real_t (&params)[3], real_t (&precip)[3], real_t zeta,
 }
 
 void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
-             size_t &kstart, real_t &dt, array_1d_t<real_t> &dz,
-             array_1d_t<real_t> &t, array_1d_t<real_t> &rho,
-             array_1d_t<real_t> &p, array_1d_t<real_t> &qv,
-             array_1d_t<real_t> &qc, array_1d_t<real_t> &qi,
-             array_1d_t<real_t> &qr, array_1d_t<real_t> &qs,
-             array_1d_t<real_t> &qg, real_t &qnc, array_1d_t<real_t> &prr_gsp,
-             array_1d_t<real_t> &pri_gsp, array_1d_t<real_t> &prs_gsp,
-             array_1d_t<real_t> &prg_gsp, array_1d_t<real_t> &pre_gsp,
-             array_1d_t<real_t> &pflx) {
-
-  array_1d_t<size_t> kmin(nvec * np, ke + 1); // first level with condensate
-
-  array_1d_t<real_t> emptyArray;
-  // Arrays to store pointers for p and x
-  array_1d_t<real_t*> p_array;
-  array_1d_t<real_t*> x_array;
-
-  // Add pointers to each array instead of storing the whole data
-  p_array.emplace_back(prr_gsp.data());
-  p_array.emplace_back(pri_gsp.data());
-  p_array.emplace_back(prs_gsp.data());
-  p_array.emplace_back(prg_gsp.data());
-  p_array.emplace_back(emptyArray.data()); // Empty array pointer
-  p_array.emplace_back(emptyArray.data());
-
-  x_array.emplace_back(qr.data());
-  x_array.emplace_back(qi.data());
-  x_array.emplace_back(qs.data());
-  x_array.emplace_back(qg.data());
-  x_array.emplace_back(qc.data());
-  x_array.emplace_back(qv.data());
+             size_t &kstart, real_t &dt, State &state, real_t &qnc) {
+
+  check_index_range(ke, ivend);
+  MU_ACTIVITY_SCAN(state, ke, ivstart, ivend);
+
+  // first level with condensate
+  array_1d_t<level_index_t> kmin(nvec * np, static_cast<level_index_t>(ke + 1));
 
   // The loop is intentionally i<nlev; since we are using an unsigned integer
   // data type, when i reaches 0, and you try to decrement further, (to -1), it
   // wraps to the maximum value representable by size_t.
-  array_1d_t<size_t> indices_(ivend - ivstart);
+  array_1d_t<point_index_t> indices_(ivend - ivstart);
   std::iota(indices_.begin(), indices_.end(), ivstart);
   
-  array_1d_t<size_t> flags(ke * (ivend - ivstart + 1));
-  array_1d_t<size_t> prefixsum(ke * (ivend - ivstart + 1));
-
-  real_t** p_array_ptr = p_array.data();
-  real_t** x_array_ptr = x_array.data();
-  real_t* t_ptr = t.data();
-  real_t* rho_ptr = rho.data();
-
-  size_t* kmin_ptr = kmin.data();
-  size_t* flags_ptr = flags.data();
-  size_t* prefixsum_ptr = prefixsum.data();
+  array_1d_t<std::uint8_t> flags(ke * (ivend - ivstart + 1));
+  array_1d_t<point_index_t> prefixsum(ke * (ivend - ivstart + 1));
+
+  // all species and precipitation rates are addressed through one base pointer
+  const size_t nfield = state.field_size();
+  real_t* x_ptr = state.field(0);
+  real_t* pr_ptr = state.surface(0);
+  real_t* t_ptr = state.field(fld::t);
+  real_t* rho_ptr = state.field(fld::rho);
+
+  level_index_t* kmin_ptr = kmin.data();
+  std::uint8_t* flags_ptr = flags.data();
+  point_index_t* prefixsum_ptr = prefixsum.data();
   
+  MU_PHASE_TIMER(timer);
   size_t jmx_ = 0;
   for (size_t i = ke - 1; i < ke; --i) { 
     jmx_ += std::transform_reduce(
@@ -123,23 +103,23 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
         size_t oned_vec_index = i * ivend + j;
         constexpr auto qp_ind = make_qp_ind_array();
 
-        const bool cond1 = (std::max({x_array_ptr[lqc][oned_vec_index], x_array_ptr[lqr][oned_vec_index], 
-                            x_array_ptr[lqs][oned_vec_index], x_array_ptr[lqi][oned_vec_index], 
-                            x_array_ptr[lqg][oned_vec_index]}) > qmin);      
+        const bool cond1 = (std::max({x_ptr[lqc * nfield + oned_vec_index], x_ptr[lqr * nfield + oned_vec_index], 
+                            x_ptr[lqs * nfield + oned_vec_index], x_ptr[lqi * nfield + oned_vec_index], 
+                            x_ptr[lqg * nfield + oned_vec_index]}) > qmin);      
         const bool cond2 = ((t_ptr[oned_vec_index] < tfrz_het2) && 
-                            (x_array_ptr[lqv][oned_vec_index] > qsat_ice_rho(t_ptr[oned_vec_index], rho_ptr[oned_vec_index])));
+                            (x_ptr[lqv * nfield + oned_vec_index] > qsat_ice_rho(t_ptr[oned_vec_index], rho_ptr[oned_vec_index])));
 
         flags_ptr[oned_vec_index] = (cond1 || cond2);
         count += (cond1 || cond2);
         
-        val = (x_array_ptr[qp_ind[0]][oned_vec_index] > qmin);
-        kmin_ptr[j * np + qp_ind[0]] = val * i + (!val) * kmin_ptr[j * np + qp_ind[0]];
-        val = (x_array_ptr[qp_ind[1]][oned_vec_index] > qmin);
-        kmin_ptr[j * np + qp_ind[1]] = val * i + (!val) * kmin_ptr[j * np + qp_ind[1]];
-        val = (x_array_ptr[qp_ind[2]][oned_vec_index] > qmin);
-        kmin_ptr[j * np + qp_ind[2]] = val * i + (!val) * kmin_ptr[j * np + qp_ind[2]];
-        val = (x_array_ptr[qp_ind[3]][oned_vec_index] > qmin);
-        kmin_ptr[j * np + qp_ind[3]] = val * i + (!val) * kmin_ptr[j * np + qp_ind[3]];
+        val = (x_ptr[qp_ind[0] * nfield + oned_vec_index] > qmin);
+        kmin_ptr[j * np + qp_ind[0]] = static_cast<level_index_t>(val * i + (!val) * kmin_ptr[j * np + qp_ind[0]]);
+        val = (x_ptr[qp_ind[1] * nfield + oned_vec_index] > qmin);
+        kmin_ptr[j * np + qp_ind[1]] = static_cast<level_index_t>(val * i + (!val) * kmin_ptr[j * np + qp_ind[1]]);
+        val = (x_ptr[qp_ind[2] * nfield + oned_vec_index] > qmin);
+        kmin_ptr[j * np + qp_ind[2]] = static_cast<level_index_t>(val * i + (!val) * kmin_ptr[j * np + qp_ind[2]]);
+        val = (x_ptr[qp_ind[3] * nfield + oned_vec_index] > qmin);
+        kmin_ptr[j * np + qp_ind[3]] = static_cast<level_index_t>(val * i + (!val) * kmin_ptr[j * np + qp_ind[3]]);
 
         return count;
       }
@@ -147,14 +127,20 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
   
   }
 
-  array_1d_t<size_t> ind_i(jmx_);
-  array_1d_t<size_t> ind_j(jmx_);
+  MU_PHASE_STOP(timer, scan, ke * (ivend - ivstart),
+                static_cast<double>(ke * (ivend - ivstart)) *
+                    (phase::scan_fields * sizeof(real_t) + sizeof(std::uint8_t)));
 
-  size_t* ind_i_ptr = ind_i.data();
-  size_t* ind_j_ptr = ind_j.data();
+  // active points as packed (k, iv) words
+  array_1d_t<packed_index_t> ind_kiv(jmx_);
+
+  packed_index_t* ind_kiv_ptr = ind_kiv.data();
 
   // calculate prefix sum array (exclusive)
-  std::exclusive_scan(std::execution::par_unseq, flags.begin(), flags.end(), prefixsum.begin(), 0);
+  std::exclusive_scan(std::execution::par_unseq, flags.begin(), flags.end(), prefixsum.begin(), point_index_t(0));
+  MU_PHASE_STOP(timer, compaction, flags.size(),
+                static_cast<double>(flags.size()) *
+                    (sizeof(std::uint8_t) + sizeof(point_index_t)));
 
   // calculate index array by prefix sum array
   std::for_each(std::execution::par_unseq, indices_.begin(), indices_.end(),
@@ -163,17 +149,49 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
       for (size_t i = ke - 1; i < ke; --i) {
         oned_vec_index = i * ivend + j;
         if (flags_ptr[oned_vec_index]) {
-          ind_i_ptr[prefixsum_ptr[oned_vec_index]] = i;
-          ind_j_ptr[prefixsum_ptr[oned_vec_index]] = j;
+          ind_kiv_ptr[prefixsum_ptr[oned_vec_index]] = kiv_t::pack(i, j);
         }
       }
   });
+  MU_PHASE_STOP(timer, scatter, ke * (ivend - ivstart),
+                static_cast<double>(ke * (ivend - ivstart)) * sizeof(std::uint8_t) +
+                    static_cast<double>(jmx_) *
+                        (sizeof(point_index_t) + sizeof(packed_index_t)));
   
 
-  array_1d_t<size_t> indices(jmx_);
+  array_1d_t<point_index_t> indices(jmx_);
   std::iota(indices.begin(), indices.end(), 0);
 
-  real_t* p_ptr = p.data();
+#ifdef MU_PHASE_TIMERS
+  // branches the transitions take, for their FLOP count
+  auto count_points = [&](auto predicate) {
+    return std::transform_reduce(std::execution::par_unseq, indices.begin(),
+                                 indices.end(), size_t(0), std::plus<size_t>(),
+                                 [=](size_t j) {
+                                   const size_t oned_vec_index =
+                                       kiv_t::level(ind_kiv_ptr[j]) * ivend +
+                                       kiv_t::cell(ind_kiv_ptr[j]);
+                                   const bool cold = t_ptr[oned_vec_index] < tmelt;
+                                   const bool ice =
+                                       std::max({x_ptr[lqs * nfield + oned_vec_index],
+                                                 x_ptr[lqi * nfield + oned_vec_index],
+                                                 x_ptr[lqg * nfield + oned_vec_index]}) > qmin;
+                                   return size_t(predicate(cold, ice));
+                                 });
+  };
+  MU_PHASE_BRANCH_COUNTS(count_points([](bool cold, bool) { return cold; }),
+                         count_points([](bool, bool ice) { return ice; }),
+                         count_points([](bool cold, bool ice) { return cold && ice; }));
+  MU_PHASE_RESTART(timer);
+#endif
+
+  real_t* p_ptr = state.field(fld::p);
+
+#ifdef MU_ACTIVITY_STATS
+  // species whose sinks the limiter scaled, one bit per species and point
+  array_1d_t<std::uint8_t> limited(jmx_, 0);
+  std::uint8_t* limited_ptr = limited.data();
+#endif
 
   std::for_each(std::execution::par_unseq, indices.begin(), indices.end(),
     [=](size_t j) {
@@ -183,69 +201,69 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
         real_t sx2x_sum;
         real_t sx2x[nx][nx] = {ZERO};
         real_t sink[nx], dqdt[nx];
-        size_t k = ind_i_ptr[j];
-        size_t iv = ind_j_ptr[j];
+        size_t k = kiv_t::level(ind_kiv_ptr[j]);
+        size_t iv = kiv_t::cell(ind_kiv_ptr[j]);
         size_t oned_vec_index = k * ivend + iv;
     
-        bool is_sig_present = std::max({x_array_ptr[lqs][oned_vec_index], x_array_ptr[lqi][oned_vec_index], x_array_ptr[lqg][oned_vec_index]}) > qmin;
+        bool is_sig_present = std::max({x_ptr[lqs * nfield + oned_vec_index], x_ptr[lqi * nfield + oned_vec_index], x_ptr[lqg * nfield + oned_vec_index]}) > qmin;
 
-        dvsw = x_array_ptr[lqv][oned_vec_index] -
+        dvsw = x_ptr[lqv * nfield + oned_vec_index] -
                qsat_rho(t_ptr[oned_vec_index], rho_ptr[oned_vec_index]);
         qvsi = qsat_ice_rho(t_ptr[oned_vec_index], rho_ptr[oned_vec_index]);
-        dvsi = x_array_ptr[lqv][oned_vec_index] - qvsi;
+        dvsi = x_ptr[lqv * nfield + oned_vec_index] - qvsi;
         n_snow = snow_number(t_ptr[oned_vec_index], rho_ptr[oned_vec_index],
-                              x_array_ptr[lqs][oned_vec_index]);
-        l_snow = snow_lambda(rho_ptr[oned_vec_index], x_array_ptr[lqs][oned_vec_index], n_snow);
+                              x_ptr[lqs * nfield + oned_vec_index]);
+        l_snow = snow_lambda(rho_ptr[oned_vec_index], x_ptr[lqs * nfield + oned_vec_index], n_snow);
     
-        sx2x[lqc][lqr] = cloud_to_rain(t_ptr[oned_vec_index], x_array_ptr[lqc][oned_vec_index],
-                                        x_array_ptr[lqr][oned_vec_index], qnc);
+        sx2x[lqc][lqr] = cloud_to_rain(t_ptr[oned_vec_index], x_ptr[lqc * nfield + oned_vec_index],
+                                        x_ptr[lqr * nfield + oned_vec_index], qnc);
         sx2x[lqr][lqv] = rain_to_vapor(t_ptr[oned_vec_index], rho_ptr[oned_vec_index],
-                                      x_array_ptr[lqc][oned_vec_index],
-                                      x_array_ptr[lqr][oned_vec_index], dvsw, dt);
-        sx2x[lqc][lqi] = cloud_x_ice(t_ptr[oned_vec_index], x_array_ptr[lqc][oned_vec_index],
-                                      x_array_ptr[lqi][oned_vec_index], dt);
+                                      x_ptr[lqc * nfield + oned_vec_index],
+                                      x_ptr[lqr * nfield + oned_vec_index], dvsw, dt);
+        sx2x[lqc][lqi] = cloud_x_ice(t_ptr[oned_vec_index], x_ptr[lqc * nfield + oned_vec_index],
+                                      x_ptr[lqi * nfield + oned_vec_index], dt);
         sx2x[lqi][lqc] = -std::fmin(sx2x[lqc][lqi], ZERO);
         sx2x[lqc][lqi] = std::fmax(sx2x[lqc][lqi], ZERO);
-        sx2x[lqc][lqs] = cloud_to_snow(t_ptr[oned_vec_index], x_array_ptr[lqc][oned_vec_index],
-                                        x_array_ptr[lqs][oned_vec_index], n_snow, l_snow);
+        sx2x[lqc][lqs] = cloud_to_snow(t_ptr[oned_vec_index], x_ptr[lqc * nfield + oned_vec_index],
+                                        x_ptr[lqs * nfield + oned_vec_index], n_snow, l_snow);
         sx2x[lqc][lqg] =
             cloud_to_graupel(t_ptr[oned_vec_index], rho_ptr[oned_vec_index],
-                            x_array_ptr[lqc][oned_vec_index], x_array_ptr[lqg][oned_vec_index]);
+                            x_ptr[lqc * nfield + oned_vec_index], x_ptr[lqg * nfield + oned_vec_index]);
     
         if (t_ptr[oned_vec_index] < tmelt) {
           n_ice = ice_number(t_ptr[oned_vec_index], rho_ptr[oned_vec_index]);
-          m_ice = ice_mass(x_array_ptr[lqi][oned_vec_index], n_ice);
+          m_ice = ice_mass(x_ptr[lqi * nfield + oned_vec_index], n_ice);
           x_ice = ice_sticking(t_ptr[oned_vec_index]);
     
           if (is_sig_present) {
             eta = deposition_factor(
                 t_ptr[oned_vec_index],
                 qvsi); // neglect cloud depth cor. from gcsp_graupel
-            sx2x[lqv][lqi] = vapor_x_ice(x_array_ptr[lqi][oned_vec_index], m_ice, eta, dvsi,
+            sx2x[lqv][lqi] = vapor_x_ice(x_ptr[lqi * nfield + oned_vec_index], m_ice, eta, dvsi,
                                          rho_ptr[oned_vec_index], dt);
             sx2x[lqi][lqv] = -std::fmin(sx2x[lqv][lqi], ZERO);
             sx2x[lqv][lqi] = std::fmax(sx2x[lqv][lqi], ZERO);
             ice_dep = std::fmin(sx2x[lqv][lqi], dvsi / dt);
     
-            sx2x[lqi][lqs] = deposition_auto_conversion(x_array_ptr[lqi][oned_vec_index],
+            sx2x[lqi][lqs] = deposition_auto_conversion(x_ptr[lqi * nfield + oned_vec_index],
                                                         m_ice, ice_dep);
-            sx2x[lqi][lqs] = sx2x[lqi][lqs] + ice_to_snow(x_array_ptr[lqi][oned_vec_index],
+            sx2x[lqi][lqs] = sx2x[lqi][lqs] + ice_to_snow(x_ptr[lqi * nfield + oned_vec_index],
                                                           n_snow, l_snow, x_ice);
             sx2x[lqi][lqg] = ice_to_graupel(
-                rho_ptr[oned_vec_index], x_array_ptr[lqr][oned_vec_index],
-                x_array_ptr[lqg][oned_vec_index], x_array_ptr[lqi][oned_vec_index], x_ice);
+                rho_ptr[oned_vec_index], x_ptr[lqr * nfield + oned_vec_index],
+                x_ptr[lqg * nfield + oned_vec_index], x_ptr[lqi * nfield + oned_vec_index], x_ice);
             sx2x[lqs][lqg] =
                 snow_to_graupel(t_ptr[oned_vec_index], rho_ptr[oned_vec_index],
-                                x_array_ptr[lqc][oned_vec_index], x_array_ptr[lqs][oned_vec_index]);
+                                x_ptr[lqc * nfield + oned_vec_index], x_ptr[lqs * nfield + oned_vec_index]);
             sx2x[lqr][lqg] = rain_to_graupel(
-                t_ptr[oned_vec_index], rho_ptr[oned_vec_index], x_array_ptr[lqc][oned_vec_index],
-                x_array_ptr[lqr][oned_vec_index], x_array_ptr[lqi][oned_vec_index],
-                x_array_ptr[lqs][oned_vec_index], m_ice, dvsw, dt);
+                t_ptr[oned_vec_index], rho_ptr[oned_vec_index], x_ptr[lqc * nfield + oned_vec_index],
+                x_ptr[lqr * nfield + oned_vec_index], x_ptr[lqi * nfield + oned_vec_index],
+                x_ptr[lqs * nfield + oned_vec_index], m_ice, dvsw, dt);
           }
           sx2x[lqv][lqi] =
               sx2x[lqv][lqi] +
-              ice_deposition_nucleation(t_ptr[oned_vec_index], x_array_ptr[lqc][oned_vec_index],
-                                        x_array_ptr[lqi][oned_vec_index], n_ice, dvsi, dt);
+              ice_deposition_nucleation(t_ptr[oned_vec_index], x_ptr[lqc * nfield + oned_vec_index],
+                                        x_ptr[lqi * nfield + oned_vec_index], n_ice, dvsi, dt);
         } else {
           sx2x[lqc][lqr] = sx2x[lqc][lqr] + sx2x[lqc][lqs] + sx2x[lqc][lqg];
           sx2x[lqc][lqs] = ZERO;
@@ -255,24 +273,24 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
         }
     
         if (is_sig_present) {
-          dvsw0 = x_array_ptr[lqv][oned_vec_index] - qsat_rho(tmelt, rho_ptr[oned_vec_index]);
+          dvsw0 = x_ptr[lqv * nfield + oned_vec_index] - qsat_rho(tmelt, rho_ptr[oned_vec_index]);
           sx2x[lqv][lqs] =
               vapor_x_snow(t_ptr[oned_vec_index], p_ptr[oned_vec_index],
-                           rho_ptr[oned_vec_index], x_array_ptr[lqs][oned_vec_index], n_snow,
+                           rho_ptr[oned_vec_index], x_ptr[lqs * nfield + oned_vec_index], n_snow,
                            l_snow, eta, ice_dep, dvsw, dvsi, dvsw0, dt);
           sx2x[lqs][lqv] = -std::fmin(sx2x[lqv][lqs], ZERO);
           sx2x[lqv][lqs] = std::fmax(sx2x[lqv][lqs], ZERO);
           sx2x[lqv][lqg] = vapor_x_graupel(
               t_ptr[oned_vec_index], p_ptr[oned_vec_index], rho_ptr[oned_vec_index],
-              x_array_ptr[lqg][oned_vec_index], dvsw, dvsi, dvsw0, dt);
+              x_ptr[lqg * nfield + oned_vec_index], dvsw, dvsi, dvsw0, dt);
           sx2x[lqg][lqv] = -std::fmin(sx2x[lqv][lqg], ZERO);
           sx2x[lqv][lqg] = std::fmax(sx2x[lqv][lqg], ZERO);
           sx2x[lqs][lqr] =
               snow_to_rain(t_ptr[oned_vec_index], p_ptr[oned_vec_index],
-                           rho_ptr[oned_vec_index], dvsw0, x_array_ptr[lqs][oned_vec_index]);
+                           rho_ptr[oned_vec_index], dvsw0, x_ptr[lqs * nfield + oned_vec_index]);
           sx2x[lqg][lqr] =
               graupel_to_rain(t_ptr[oned_vec_index], p_ptr[oned_vec_index],
-                              rho_ptr[oned_vec_index], dvsw0, x_array_ptr[lqg][oned_vec_index]);
+                              rho_ptr[oned_vec_index], dvsw0, x_ptr[lqg * nfield + oned_vec_index]);
         }
     
         #pragma unroll nx
@@ -285,10 +303,13 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
             for (size_t i = 0; i < nx; i++) {
               sink[qx_ind[ix]] = sink[qx_ind[ix]] + sx2x[qx_ind[ix]][i];
             }
-            stot = x_array_ptr[qx_ind[ix]][oned_vec_index] / dt;
+            stot = x_ptr[qx_ind[ix] * nfield + oned_vec_index] / dt;
     
             if ((sink[qx_ind[ix]] > stot) &&
-                (x_array_ptr[qx_ind[ix]][oned_vec_index] > qmin)) {
+                (x_ptr[qx_ind[ix] * nfield + oned_vec_index] > qmin)) {
+#ifdef MU_ACTIVITY_STATS
+              limited_ptr[j] |= std::uint8_t(1u << qx_ind[ix]);
+#endif
               real_t nextSink = ZERO;
     
               #pragma unroll nx
@@ -308,13 +329,13 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
             sx2x_sum = sx2x_sum + sx2x[i][qx_ind[ix]];
           }
           dqdt[qx_ind[ix]] = sx2x_sum - sink[qx_ind[ix]];
-          x_array_ptr[qx_ind[ix]][oned_vec_index] = std::fmax(
-              ZERO, x_array_ptr[qx_ind[ix]][oned_vec_index] + dqdt[qx_ind[ix]] * dt);
+          x_ptr[qx_ind[ix] * nfield + oned_vec_index] = std::fmax(
+              ZERO, x_ptr[qx_ind[ix] * nfield + oned_vec_index] + dqdt[qx_ind[ix]] * dt);
         }
     
-        qice = x_array_ptr[lqs][oned_vec_index] + x_array_ptr[lqi][oned_vec_index] + x_array_ptr[lqg][oned_vec_index];
-        qliq = x_array_ptr[lqc][oned_vec_index] + x_array_ptr[lqr][oned_vec_index];
-        qtot = x_array_ptr[lqv][oned_vec_index] + qice + qliq;
+        qice = x_ptr[lqs * nfield + oned_vec_index] + x_ptr[lqi * nfield + oned_vec_index] + x_ptr[lqg * nfield + oned_vec_index];
+        qliq = x_ptr[lqc * nfield + oned_vec_index] + x_ptr[lqr * nfield + oned_vec_index];
+        qtot = x_ptr[lqv * nfield + oned_vec_index] + qice + qliq;
         cv = cvd + (cvv - cvd) * qtot + (clw - cvv) * qliq +
              (ci - cvv) * qice; // qtot? or qv?
         t_ptr[oned_vec_index] =
@@ -325,12 +346,62 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
                      (lsc - (ci - cvv) * t_ptr[oned_vec_index])) /
                 cv;
   });
+  MU_PHASE_STOP(timer, transitions, jmx_,
+                static_cast<double>(jmx_) *
+                    (phase::transition_fields * sizeof(real_t) + sizeof(packed_index_t)));
+
+#ifdef MU_ACTIVITY_STATS
+  // one pass over the bitmasks, counting every species at once
+  using species_counts = std::array<std::uint64_t, nx>;
+  const species_counts counts = std::transform_reduce(
+      std::execution::par_unseq, limited.begin(), limited.end(), species_counts{},
+      [](species_counts a, const species_counts &b) {
+        for (size_t ix = 0; ix < nx; ix++)
+          a[ix] += b[ix];
+        return a;
+      },
+      [](std::uint8_t bits) {
+        species_counts c;
+        for (size_t ix = 0; ix < nx; ix++)
+          c[ix] = (bits >> ix) & 1u;
+        return c;
+      });
+  for (size_t ix = 0; ix < nx; ix++)
+    utils_muphys::activity_stats().limited[ix] += counts[ix];
+  MU_PHASE_RESTART(timer);
+#endif
 
   size_t k_end = (lrain) ? ke : kstart - 1;
 
-  real_t* dz_ptr = dz.data();
-  real_t* pflx_ptr = pflx.data();
-  real_t* pre_gsp_ptr = pre_gsp.data();
+#ifdef MU_PHASE_TIMERS
+  // columns with precipitation and the levels they sediment through
+  const size_t precip_columns = std::transform_reduce(
+      std::execution::par_unseq, indices_.begin(), indices_.end(), size_t(0),
+      std::plus<size_t>(), [=](size_t iv) {
+        return size_t(*std::min_element(kmin_ptr + (iv * np), kmin_ptr + (iv * np + np)) < ke);
+      });
+  const size_t sedimentation_points = std::transform_reduce(
+      std::execution::par_unseq, indices_.begin(), indices_.end(), size_t(0),
+      std::plus<size_t>(), [=](size_t iv) {
+        const size_t threshold = *std::min_element(kmin_ptr + (iv * np), kmin_ptr + (iv * np + np));
+        return threshold < ke ? utils_muphys::sedimentation_levels(kstart, k_end, threshold) : size_t(0);
+      });
+  size_t species_points[np];
+  for (size_t ix = 0; ix < np; ix++) {
+    species_points[qp_ind[ix]] = std::transform_reduce(
+        std::execution::par_unseq, indices_.begin(), indices_.end(), size_t(0),
+        std::plus<size_t>(), [=](size_t iv) {
+          return utils_muphys::sedimentation_levels(kstart, k_end, kmin_ptr[iv * np + qp_ind[ix]]);
+        });
+  }
+  MU_PHASE_COUNTS(jmx_, precip_columns);
+  MU_PHASE_SPECIES_COUNTS(species_points);
+  MU_PHASE_RESTART(timer);
+#endif
+
+  real_t* dz_ptr = state.field(fld::dz);
+  real_t* pflx_ptr = state.field(fld::pflx);
+  real_t* pre_gsp_ptr = state.surface(fld::pre);
 
   std::for_each(std::execution::par_unseq, indices_.begin(), indices_.end(),
       [=] (size_t iv) {
@@ -339,7 +410,7 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
 
       size_t oned_vec_index, kp1;
 
-      real_t vc, zeta, qice, qliq, e_int, xrho;
+      real_t vc, zeta, qice, qliq, e_int, xrho, dz_k;
       real_t update[3];
       real_t vt[np] = {ZERO};
       real_t eflx = ZERO;
@@ -352,6 +423,13 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
 
       const size_t threshold = *std::min_element(kmin_ptr + (iv * np), kmin_ptr + (iv * np + np));
 
+#ifdef MU_DZ_ON_THE_FLY
+      // dz holds the full level heights; pflx serves as the dz scratch column,
+      // since the thickness of each level is consumed before its flux is stored
+      utils_muphys::calc_dz_column(dz_ptr + iv, pflx_ptr + iv, ke, ivend,
+                                   std::max(kstart, threshold));
+#endif
+
       for (size_t k = kstart; k < k_end; k++) {
 
         if (k < threshold)
@@ -361,14 +439,19 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
 
         kp1 = std::min(ke - 1, k + 1);
 
-        qliq = x_array_ptr[lqc][oned_vec_index] + x_array_ptr[lqr][oned_vec_index];
-        qice = x_array_ptr[lqs][oned_vec_index] + x_array_ptr[lqi][oned_vec_index] + x_array_ptr[lqg][oned_vec_index];
+#ifdef MU_DZ_ON_THE_FLY
+        dz_k = pflx_ptr[oned_vec_index];
+#else
+        dz_k = dz_ptr[oned_vec_index];
+#endif
+        qliq = x_ptr[lqc * nfield + oned_vec_index] + x_ptr[lqr * nfield + oned_vec_index];
+        qice = x_ptr[lqs * nfield + oned_vec_index] + x_ptr[lqi * nfield + oned_vec_index] + x_ptr[lqg * nfield + oned_vec_index];
 
         e_int =
-            internal_energy(t_ptr[oned_vec_index], x_array_ptr[lqv][oned_vec_index], qliq,
-                            qice, rho_ptr[oned_vec_index], dz_ptr[oned_vec_index]) +
+            internal_energy(t_ptr[oned_vec_index], x_ptr[lqv * nfield + oned_vec_index], qliq,
+                            qice, rho_ptr[oned_vec_index], dz_k) +
             eflx;
-        zeta = dt / (2.0 * dz_ptr[oned_vec_index]);
+        zeta = dt / (2.0 * dz_k);
         xrho = std::sqrt(rho_00 / rho_ptr[oned_vec_index]);
         
         #pragma unroll np
@@ -377,31 +460,35 @@ void graupel(size_t &nvec, size_t &ke, size_t &ivstart, size_t &ivend,
             continue;
           vc = vel_scale_factor(qp_ind[ix], xrho, rho_ptr[oned_vec_index],
                                 t_ptr[oned_vec_index],
-                                x_array_ptr[qp_ind[ix]][oned_vec_index]);
-          precip(params[qp_ind[ix]], update, zeta, vc, p_array_ptr[qp_ind[ix]][iv],
-                  vt[ix], x_array_ptr[qp_ind[ix]][oned_vec_index],
-                  x_array_ptr[qp_ind[ix]][kp1 * ivend + iv], rho_ptr[oned_vec_index]);
-                  x_array_ptr[qp_ind[ix]][oned_vec_index] = update[0];
-                  p_array_ptr[qp_ind[ix]][iv] = update[1];
+                                x_ptr[qp_ind[ix] * nfield + oned_vec_index]);
+          precip(params[qp_ind[ix]], update, zeta, vc, pr_ptr[qp_ind[ix] * ivend + iv],
+                  vt[ix], x_ptr[qp_ind[ix] * nfield + oned_vec_index],
+                  x_ptr[qp_ind[ix] * nfield + kp1 * ivend + iv], rho_ptr[oned_vec_index]);
+                  x_ptr[qp_ind[ix] * nfield + oned_vec_index] = update[0];
+                  pr_ptr[qp_ind[ix] * ivend + iv] = update[1];
           vt[ix] = update[2];
         }
 
-        pflx_ptr[oned_vec_index] = p_array_ptr[lqs][iv] + p_array_ptr[lqi][iv] + p_array_ptr[lqg][iv];
+        pflx_ptr[oned_vec_index] = pr_ptr[lqs * ivend + iv] + pr_ptr[lqi * ivend + iv] + pr_ptr[lqg * ivend + iv];
         eflx =
-            dt * (p_array_ptr[lqr][iv] * (clw * t_ptr[oned_vec_index] -
+            dt * (pr_ptr[lqr * ivend + iv] * (clw * t_ptr[oned_vec_index] -
                                   cvd * t_ptr[kp1 * ivend + iv] - lvc) +
                   pflx_ptr[oned_vec_index] * (ci * t_ptr[oned_vec_index] -
                                           cvd * t_ptr[kp1 * ivend + iv] - lsc));
-        pflx_ptr[oned_vec_index] = pflx_ptr[oned_vec_index] + p_array_ptr[lqr][iv];
-        qliq = x_array_ptr[lqc][oned_vec_index] + x_array_ptr[lqr][oned_vec_index];
-        qice = x_array_ptr[lqs][oned_vec_index] + x_array_ptr[lqi][oned_vec_index] +
-        x_array_ptr[lqg][oned_vec_index];
+        pflx_ptr[oned_vec_index] = pflx_ptr[oned_vec_index] + pr_ptr[lqr * ivend + iv];
+        qliq = x_ptr[lqc * nfield + oned_vec_index] + x_ptr[lqr * nfield + oned_vec_index];
+        qice = x_ptr[lqs * nfield + oned_vec_index] + x_ptr[lqi * nfield + oned_vec_index] +
+        x_ptr[lqg * nfield + oned_vec_index];
         e_int = e_int - eflx;
         t_ptr[oned_vec_index] =
-            T_from_internal_energy(e_int, x_array_ptr[lqv][oned_vec_index], qliq, qice,
-                                    rho_ptr[oned_vec_index], dz_ptr[oned_vec_index]);
+            T_from_internal_energy(e_int, x_ptr[lqv * nfield + oned_vec_index], qliq, qice,
+                                    rho_ptr[oned_vec_index], dz_k);
         flag = (k == ke - 1);
         pre_gsp_ptr[iv] = (flag) * eflx / dt + (!flag) * pre_gsp_ptr[iv];
       }
   });
-}
\ No newline at end of file
+
+  MU_PHASE_STOP(timer, sedimentation, sedimentation_points,
+                static_cast<double>(sedimentation_points) *
+                    phase::sedimentation_fields * sizeof(real_t));
+}
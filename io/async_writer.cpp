@@ -0,0 +1,132 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "async_writer.hpp"
+#include "io.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+using clock_type = std::chrono::steady_clock;
+
+static double seconds_since(clock_type::time_point start) {
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+io_muphys::async_writer::async_writer(size_t ncells, size_t nlev,
+                                      const options_t &options)
+    : ncells(ncells), nlev(nlev), options(options) {
+  worker = std::thread(&async_writer::run, this);
+}
+
+io_muphys::async_writer::~async_writer() {
+  try {
+    finish();
+  } catch (const std::exception &e) {
+    std::cerr << "async_writer: " << e.what() << std::endl;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+void io_muphys::async_writer::submit(const std::string &output_file,
+                                     const State &state) {
+  MU_TRACE_SCOPE("submit");
+  auto start = clock_type::now();
+  std::unique_lock<std::mutex> lock(mutex);
+  slot_t &slot = slots[next_fill];
+  cv.wait(lock, [&] { return !slot.pending; });
+  rethrow_if_failed();
+  wait_time += seconds_since(start);
+  lock.unlock();
+
+  // the slot is not touched by the writer until it is marked pending
+  start = clock_type::now();
+  slot.state.assign(state);
+  slot.file = output_file;
+  double copied = seconds_since(start);
+
+  lock.lock();
+  copy_time += copied;
+  slot.pending = true;
+  next_fill = 1 - next_fill;
+  lock.unlock();
+  cv.notify_all();
+}
+
+void io_muphys::async_writer::finish() {
+  MU_TRACE_SCOPE("writer_finish");
+  auto start = clock_type::now();
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return !slots[0].pending && !slots[1].pending; });
+  wait_time += seconds_since(start);
+  rethrow_if_failed();
+}
+
+void io_muphys::async_writer::write(const std::string &output_file,
+                                    const State &state) {
+  finish();
+  MU_TRACE_SCOPE("writer_sync");
+  auto start = clock_type::now();
+  io_muphys::write_fields(output_file, ncells, nlev, state, options);
+  const double elapsed = seconds_since(start);
+  std::lock_guard<std::mutex> lock(mutex);
+  write_time += elapsed;
+  sync_time += elapsed;
+  ++nwritten;
+}
+
+double io_muphys::async_writer::hidden_seconds() const {
+  return std::max(0.0, write_time - wait_time - sync_time);
+}
+
+void io_muphys::async_writer::rethrow_if_failed() {
+  if (error) {
+    std::exception_ptr e = error;
+    error = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+void io_muphys::async_writer::run() {
+  MU_TRACE_THREAD("writer");
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    slot_t &slot = slots[next_write];
+    cv.wait(lock, [&] { return slot.pending || stop; });
+    if (!slot.pending)
+      return;
+    lock.unlock();
+
+    auto start = clock_type::now();
+    std::exception_ptr failed;
+    try {
+      io_muphys::write_fields(slot.file, ncells, nlev, slot.state.view(),
+                              options);
+    } catch (...) {
+      failed = std::current_exception();
+    }
+    double elapsed = seconds_since(start);
+
+    lock.lock();
+    if (failed && !error)
+      error = failed;
+    write_time += elapsed;
+    ++nwritten;
+    slot.pending = false;
+    next_write = 1 - next_write;
+    cv.notify_all();
+  }
+}
@@ -0,0 +1,86 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include "../core/common/state.hpp"
+#include "io.hpp"
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace io_muphys {
+
+/**
+ * @brief Writes state snapshots on a background thread
+ *
+ * Two snapshot buffers are used in turn, so that one step is written while
+ * the next one computes. A snapshot holds only the output fields of the
+ * state. submit() blocks only if both buffers are still pending; a failed
+ * write is rethrown by the next submit(), write() or finish().
+ */
+class async_writer {
+public:
+  async_writer(size_t ncells, size_t nlev,
+               const options_t &options = options_t());
+  ~async_writer();
+
+  async_writer(const async_writer &) = delete;
+  async_writer &operator=(const async_writer &) = delete;
+
+  /* copies the state into a free buffer and queues it for output_file */
+  void submit(const std::string &output_file, const State &state);
+  /* blocks until all queued snapshots are written */
+  void finish();
+  /* finishes the queued snapshots, then writes the state from the caller's
+   * memory on the calling thread, e.g. the final output */
+  void write(const std::string &output_file, const State &state);
+
+  /* time spent in write_fields on the writer thread */
+  double write_seconds() const { return write_time; }
+  /* time the caller was blocked: waiting for the writer, snapshot copies and
+   * the writes of write() */
+  double exposed_seconds() const { return wait_time + copy_time + sync_time; }
+  /* write time overlapped with compute */
+  double hidden_seconds() const;
+  size_t snapshots() const { return nwritten; }
+
+private:
+  struct slot_t {
+    output_state_t state;
+    std::string file;
+    bool pending = false;
+  };
+
+  void run();
+  void rethrow_if_failed();
+
+  size_t ncells, nlev;
+  options_t options;
+  slot_t slots[2];
+  size_t next_fill = 0;  // slot for the next submit()
+  size_t next_write = 0; // slot for the writer thread
+  bool stop = false;
+
+  double write_time = 0.0;
+  double wait_time = 0.0;
+  double copy_time = 0.0;
+  double sync_time = 0.0; // write() on the calling thread
+  std::exception_ptr error; // first failure of the writer thread
+  size_t nwritten = 0;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::thread worker;
+};
+
+} // namespace io_muphys
@@ -0,0 +1,95 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "cell_order.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+static const unsigned CURVE_BITS = 16;
+
+std::uint64_t io_muphys::hilbert_key(std::uint32_t x, std::uint32_t y,
+                                     unsigned bits) {
+  // rotate and flip the quadrants from the coarsest level down
+  std::uint64_t d = 0;
+  for (std::uint32_t s = std::uint32_t(1) << (bits - 1); s > 0; s >>= 1) {
+    const std::uint32_t rx = (x & s) ? 1 : 0;
+    const std::uint32_t ry = (y & s) ? 1 : 0;
+    d += static_cast<std::uint64_t>(s) * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) {
+        x = s - 1 - (x & (s - 1));
+        y = s - 1 - (y & (s - 1));
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+std::uint64_t io_muphys::morton_key(std::uint32_t x, std::uint32_t y) {
+  auto spread = [](std::uint64_t v) {
+    v &= 0xffffffffu;
+    v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+    v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+    v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+    v = (v | (v << 2)) & 0x3333333333333333ull;
+    v = (v | (v << 1)) & 0x5555555555555555ull;
+    return v;
+  };
+  return spread(x) | (spread(y) << 1);
+}
+
+std::vector<std::uint64_t>
+io_muphys::curve_order(const std::vector<double> &clon,
+                       const std::vector<double> &clat,
+                       const std::string &curve) {
+  if (clon.size() != clat.size())
+    throw std::invalid_argument("clon and clat differ in size");
+  if (curve != "hilbert" && curve != "morton")
+    throw std::invalid_argument("unknown space-filling curve " + curve);
+  const size_t ncells = clon.size();
+  std::vector<std::uint64_t> order(ncells);
+  std::iota(order.begin(), order.end(), 0);
+  if (ncells == 0)
+    return order;
+
+  const auto [lon_min, lon_max] = std::minmax_element(clon.begin(), clon.end());
+  const auto [lat_min, lat_max] = std::minmax_element(clat.begin(), clat.end());
+  const double cells = double(std::uint32_t(1) << CURVE_BITS) - 1.0;
+  auto quantise = [cells](double v, double lo, double hi) {
+    return hi > lo ? static_cast<std::uint32_t>(std::lround((v - lo) / (hi - lo) * cells))
+                   : std::uint32_t(0);
+  };
+
+  std::vector<std::uint64_t> keys(ncells);
+  for (size_t i = 0; i < ncells; ++i) {
+    const std::uint32_t x = quantise(clon[i], *lon_min, *lon_max);
+    const std::uint32_t y = quantise(clat[i], *lat_min, *lat_max);
+    keys[i] = curve == "hilbert" ? hilbert_key(x, y, CURVE_BITS)
+                                 : morton_key(x, y);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&keys](std::uint64_t a, std::uint64_t b) {
+                     return keys[a] < keys[b];
+                   });
+  return order;
+}
+
+std::vector<std::uint64_t>
+io_muphys::inverse_order(const std::vector<std::uint64_t> &order) {
+  std::vector<std::uint64_t> inverse(order.size());
+  for (size_t p = 0; p < order.size(); ++p)
+    inverse[order[p]] = p;
+  return inverse;
+}
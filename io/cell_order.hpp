@@ -0,0 +1,45 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace io_muphys {
+
+/* position of (x, y) on the Hilbert curve through a 2^bits x 2^bits grid */
+std::uint64_t hilbert_key(std::uint32_t x, std::uint32_t y, unsigned bits);
+
+/* bit interleaving of x and y, the Morton or Z-order curve */
+std::uint64_t morton_key(std::uint32_t x, std::uint32_t y);
+
+/**
+ * @brief Cell order along a space-filling curve through the cell centres
+ *
+ * The bounding box of the coordinates is quantised to a 2^16 x 2^16 grid,
+ * so the units of clon and clat do not matter. Cells on the same grid
+ * point keep their file order.
+ *
+ * @param [in] clon Longitude of the cell centres
+ * @param [in] clat Latitude of the cell centres
+ * @param [in] curve "hilbert" or "morton"
+ * @return File index of the cell at every position of the curve
+ */
+std::vector<std::uint64_t> curve_order(const std::vector<double> &clon,
+                                       const std::vector<double> &clat,
+                                       const std::string &curve);
+
+/* position of every file cell in order, i.e. the inverse permutation */
+std::vector<std::uint64_t> inverse_order(const std::vector<std::uint64_t> &order);
+
+} // namespace io_muphys
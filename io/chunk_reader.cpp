@@ -0,0 +1,254 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "chunk_reader.hpp"
+#include "parallel_for.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+#include <zlib.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "chunk_reader assumes a little-endian host");
+
+namespace {
+
+/* suppresses the HDF5 error stack while probing the file */
+struct silence_hdf5_errors {
+  H5E_auto2_t func;
+  void *data;
+  silence_hdf5_errors() {
+    H5Eget_auto2(H5E_DEFAULT, &func, &data);
+    H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+  }
+  ~silence_hdf5_errors() { H5Eset_auto2(H5E_DEFAULT, func, data); }
+};
+
+/* storage of one variable, chunk dims are padded to (time, level, cell) */
+struct layout_t {
+  hid_t dset = -1;
+  hsize_t chunk[3] = {1, 1, 1};
+  size_t elem_size = 0;
+  std::vector<H5Z_filter_t> filters; // pipeline order
+  std::atomic<bool> failed{false};
+};
+
+struct raw_chunk_t {
+  size_t request;
+  hsize_t offset[3] = {0, 0, 0};
+  uint32_t filter_mask = 0;
+  std::vector<unsigned char> data;
+};
+
+bool inflate_chunk(const std::vector<unsigned char> &in,
+                   std::vector<unsigned char> &out) {
+  uLongf length = out.size();
+  return uncompress(out.data(), &length, in.data(), in.size()) == Z_OK &&
+         length == out.size();
+}
+
+/* HDF5 shuffle stores byte b of every element in plane b */
+void unshuffle_chunk(const std::vector<unsigned char> &in,
+                     std::vector<unsigned char> &out, size_t elem_size) {
+  const size_t nelem = out.size() / elem_size;
+  for (size_t b = 0; b < elem_size; ++b) {
+    const unsigned char *plane = in.data() + b * nelem;
+    for (size_t e = 0; e < nelem; ++e)
+      out[e * elem_size + b] = plane[e];
+  }
+}
+
+template <typename file_t>
+void scatter_chunk(const unsigned char *bytes, const hsize_t *chunk,
+                   const hsize_t *offset, size_t t, real_t *v, size_t ncells,
+                   size_t nlev) {
+  const size_t kend = std::min<size_t>(offset[1] + chunk[1], nlev);
+  const size_t jend = std::min<size_t>(offset[2] + chunk[2], ncells);
+  const size_t nj = jend - offset[2];
+  for (size_t k = offset[1]; k < kend; ++k) {
+    const size_t row = (t * chunk[1] + (k - offset[1])) * chunk[2];
+    real_t *dst = v + k * ncells + offset[2];
+    if constexpr (std::is_same_v<file_t, real_t>) {
+      std::memcpy(dst, bytes + row * sizeof(file_t), nj * sizeof(file_t));
+    } else {
+      file_t value;
+      for (size_t j = 0; j < nj; ++j) {
+        std::memcpy(&value, bytes + (row + j) * sizeof(file_t),
+                    sizeof(file_t));
+        dst[j] = static_cast<real_t>(value);
+      }
+    }
+  }
+}
+
+} // namespace
+
+io_muphys::chunk_reader::chunk_reader(const std::string &file_name) {
+  silence_hdf5_errors quiet;
+  // classic netCDF files are not HDF5 files and use the netCDF path
+  file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+}
+
+io_muphys::chunk_reader::~chunk_reader() {
+  if (file >= 0)
+    H5Fclose(file);
+}
+
+void io_muphys::chunk_reader::add(const std::string &name, real_t *v,
+                                  size_t ncells, size_t nlev) {
+  requests.push_back({name, v, ncells, nlev, false, 0});
+}
+
+void io_muphys::chunk_reader::add(const std::string &name, real_t *v,
+                                  size_t ncells, size_t nlev, size_t itime) {
+  requests.push_back({name, v, ncells, nlev, true, itime});
+}
+
+std::vector<bool> io_muphys::chunk_reader::read(unsigned nthreads) {
+  std::vector<bool> done(requests.size(), false);
+  if (file < 0)
+    return done;
+
+  silence_hdf5_errors quiet;
+  std::vector<layout_t> layouts(requests.size());
+  std::vector<raw_chunk_t> chunks;
+
+  // raw chunks bypass the chunk cache, so the datasets do not need one
+  hid_t dapl = H5Pcreate(H5P_DATASET_ACCESS);
+  H5Pset_chunk_cache(dapl, 0, 0, 1.0);
+
+  for (size_t r = 0; r < requests.size(); ++r) {
+    const request_t &req = requests[r];
+    layout_t &layout = layouts[r];
+    if (H5Lexists(file, req.name.c_str(), H5P_DEFAULT) <= 0)
+      continue;
+    layout.dset = H5Dopen2(file, req.name.c_str(), dapl);
+    if (layout.dset < 0)
+      continue;
+
+    hid_t dcpl = H5Dget_create_plist(layout.dset);
+    hid_t type = H5Dget_type(layout.dset);
+    hid_t space = H5Dget_space(layout.dset);
+    const int rank = H5Sget_simple_extent_ndims(space);
+    const int expected_rank = req.timed ? 3 : 2;
+    hsize_t dims[3] = {1, 1, 1};
+    bool usable = H5Pget_layout(dcpl) == H5D_CHUNKED &&
+                  H5Tget_class(type) == H5T_FLOAT &&
+                  H5Tget_order(type) == H5T_ORDER_LE &&
+                  rank == expected_rank;
+    layout.elem_size = H5Tget_size(type);
+    usable = usable && (layout.elem_size == sizeof(float) ||
+                        layout.elem_size == sizeof(double));
+    if (usable) {
+      H5Sget_simple_extent_dims(space, dims + 3 - rank, nullptr);
+      H5Pget_chunk(dcpl, rank, layout.chunk + 3 - rank);
+      usable = dims[1] >= req.nlev && dims[2] >= req.ncells &&
+               (!req.timed || req.itime < dims[0]);
+    }
+    const int nfilters = usable ? H5Pget_nfilters(dcpl) : 0;
+    for (int i = 0; i < nfilters; ++i) {
+      unsigned flags;
+      size_t nvalues = 0;
+      H5Z_filter_t id = H5Pget_filter2(dcpl, i, &flags, &nvalues, nullptr, 0,
+                                       nullptr, nullptr);
+      usable = usable && (id == H5Z_FILTER_DEFLATE || id == H5Z_FILTER_SHUFFLE);
+      layout.filters.push_back(id);
+    }
+    H5Tclose(type);
+    H5Pclose(dcpl);
+    if (!usable) {
+      H5Sclose(space);
+      continue;
+    }
+
+    // fetch every chunk overlapping the [nlev][ncells] slab at itime;
+    // unallocated (fill value) chunks are not listed and use the netCDF path
+    hsize_t nchunks = 0;
+    H5Dget_num_chunks(layout.dset, space, &nchunks);
+    const size_t expected =
+        ((req.nlev + layout.chunk[1] - 1) / layout.chunk[1]) *
+        ((req.ncells + layout.chunk[2] - 1) / layout.chunk[2]);
+    const size_t first = chunks.size();
+    for (hsize_t c = 0; c < nchunks && usable; ++c) {
+      raw_chunk_t chunk;
+      chunk.request = r;
+      unsigned mask = 0;
+      haddr_t addr;
+      hsize_t size = 0;
+      usable = H5Dget_chunk_info(layout.dset, space, c,
+                                 chunk.offset + 3 - rank, &mask, &addr,
+                                 &size) >= 0;
+      if (!usable)
+        break;
+      if ((req.timed && (req.itime < chunk.offset[0] ||
+                         req.itime >= chunk.offset[0] + layout.chunk[0])) ||
+          chunk.offset[1] >= req.nlev || chunk.offset[2] >= req.ncells)
+        continue;
+      chunk.data.resize(size);
+      usable = H5Dread_chunk(layout.dset, H5P_DEFAULT, chunk.offset + 3 - rank,
+                             &chunk.filter_mask, chunk.data.data()) >= 0;
+      chunks.push_back(std::move(chunk));
+    }
+    H5Sclose(space);
+    if (!usable || chunks.size() - first != expected) {
+      chunks.resize(first);
+      continue;
+    }
+    done[r] = true;
+  }
+  H5Pclose(dapl);
+
+  parallel_for(chunks.size(), nthreads, [&](size_t c) {
+    raw_chunk_t &chunk = chunks[c];
+    const request_t &req = requests[chunk.request];
+    layout_t &layout = layouts[chunk.request];
+    const size_t nbytes = layout.chunk[0] * layout.chunk[1] *
+                          layout.chunk[2] * layout.elem_size;
+
+    // undo the filter pipeline in reverse, skipping filters masked out
+    std::vector<unsigned char> buffer = std::move(chunk.data), scratch;
+    bool ok = true;
+    for (size_t i = layout.filters.size(); i-- > 0 && ok;) {
+      if (chunk.filter_mask & (1u << i))
+        continue;
+      scratch.assign(nbytes, 0);
+      if (layout.filters[i] == H5Z_FILTER_DEFLATE) {
+        ok = inflate_chunk(buffer, scratch);
+      } else {
+        ok = buffer.size() == nbytes;
+        if (ok)
+          unshuffle_chunk(buffer, scratch, layout.elem_size);
+      }
+      buffer.swap(scratch);
+    }
+    if (!ok || buffer.size() != nbytes) {
+      layout.failed = true;
+      return;
+    }
+
+    const size_t t = req.timed ? req.itime - chunk.offset[0] : 0;
+    if (layout.elem_size == sizeof(float))
+      scatter_chunk<float>(buffer.data(), layout.chunk, chunk.offset, t,
+                           req.v, req.ncells, req.nlev);
+    else
+      scatter_chunk<double>(buffer.data(), layout.chunk, chunk.offset, t,
+                            req.v, req.ncells, req.nlev);
+  });
+
+  for (size_t r = 0; r < requests.size(); ++r) {
+    done[r] = done[r] && !layouts[r].failed;
+    if (layouts[r].dset >= 0)
+      H5Dclose(layouts[r].dset);
+  }
+  requests.clear();
+  return done;
+}
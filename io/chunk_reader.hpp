@@ -0,0 +1,60 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include "../core/common/types.hpp"
+#include <hdf5.h>
+#include <string>
+#include <vector>
+
+namespace io_muphys {
+
+/**
+ * @brief Reads netCDF-4 variables as raw HDF5 chunks
+ *
+ * The compressed chunks of all queued variables are fetched serially with
+ * H5Dread_chunk, then inflated, unshuffled and scattered into the
+ * destination fields on a pool of threads. Only chunked float or double
+ * variables with shuffle and deflate filters are handled; read() reports
+ * every other variable (e.g. contiguous ones) as not read, so that the
+ * caller can fall back to the netCDF path.
+ */
+class chunk_reader {
+public:
+  explicit chunk_reader(const std::string &file);
+  ~chunk_reader();
+
+  chunk_reader(const chunk_reader &) = delete;
+  chunk_reader &operator=(const chunk_reader &) = delete;
+
+  /* queues a time-constant [nlev][ncells] field */
+  void add(const std::string &name, real_t *v, size_t ncells, size_t nlev);
+  /* queues a [nlev][ncells] field at time index itime */
+  void add(const std::string &name, real_t *v, size_t ncells, size_t nlev,
+           size_t itime);
+
+  /* reads the queued fields, returns for each whether it was read */
+  std::vector<bool> read(unsigned nthreads);
+
+private:
+  struct request_t {
+    std::string name;
+    real_t *v;
+    size_t ncells, nlev;
+    bool timed;
+    size_t itime;
+  };
+
+  hid_t file;
+  std::vector<request_t> requests;
+};
+
+} // namespace io_muphys
@@ -0,0 +1,132 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "chunk_writer.hpp"
+#include "parallel_for.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+/* HDF5 shuffle stores byte b of every element in plane b */
+void shuffle_chunk(const std::vector<unsigned char> &in,
+                   std::vector<unsigned char> &out, size_t elem_size) {
+  const size_t nelem = in.size() / elem_size;
+  for (size_t b = 0; b < elem_size; ++b) {
+    unsigned char *plane = out.data() + b * nelem;
+    for (size_t e = 0; e < nelem; ++e)
+      plane[e] = in[e * elem_size + b];
+  }
+}
+
+bool deflate_chunk(const std::vector<unsigned char> &in,
+                   std::vector<unsigned char> &out, int level) {
+  uLongf length = compressBound(in.size());
+  out.resize(length);
+  if (compress2(out.data(), &length, in.data(), in.size(), level) != Z_OK)
+    return false;
+  out.resize(length);
+  return true;
+}
+
+} // namespace
+
+io_muphys::chunk_writer::chunk_writer(const std::string &file_name) {
+  file = H5Fopen(file_name.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+  if (file < 0)
+    throw std::runtime_error("chunk_writer: cannot open " + file_name);
+}
+
+io_muphys::chunk_writer::~chunk_writer() { H5Fclose(file); }
+
+void io_muphys::chunk_writer::write(const std::string &name, const real_t *v,
+                                    size_t ncells, size_t nlev,
+                                    unsigned nthreads) {
+  hid_t dset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+  if (dset < 0)
+    throw std::runtime_error("chunk_writer: no variable " + name);
+
+  hid_t dcpl = H5Dget_create_plist(dset);
+  hid_t type = H5Dget_type(dset);
+  hsize_t chunk[2] = {0, 0};
+  const bool chunked = H5Pget_layout(dcpl) == H5D_CHUNKED &&
+                       H5Pget_chunk(dcpl, 2, chunk) == 2 &&
+                       H5Tget_size(type) == sizeof(real_t);
+  H5Tclose(type);
+
+  // the filter pipeline defined by netCDF, applied in order
+  std::vector<H5Z_filter_t> filters;
+  int level = 0;
+  bool supported = chunked;
+  const int nfilters = chunked ? H5Pget_nfilters(dcpl) : 0;
+  for (int i = 0; i < nfilters; ++i) {
+    unsigned flags, values[4] = {0, 0, 0, 0};
+    size_t nvalues = 4;
+    H5Z_filter_t id = H5Pget_filter2(dcpl, i, &flags, &nvalues, values, 0,
+                                     nullptr, nullptr);
+    if (id == H5Z_FILTER_DEFLATE)
+      level = static_cast<int>(values[0]);
+    supported = supported &&
+                (id == H5Z_FILTER_DEFLATE || id == H5Z_FILTER_SHUFFLE);
+    filters.push_back(id);
+  }
+  H5Pclose(dcpl);
+  if (!supported) {
+    H5Dclose(dset);
+    throw std::runtime_error("chunk_writer: " + name +
+                             " is not a chunked real_t variable with shuffle and deflate");
+  }
+
+  const size_t nchunk_k = (nlev + chunk[0] - 1) / chunk[0];
+  const size_t nchunk_j = (ncells + chunk[1] - 1) / chunk[1];
+  std::vector<std::vector<unsigned char>> compressed(nchunk_k * nchunk_j);
+  std::atomic<bool> failed{false};
+
+  parallel_for(compressed.size(), nthreads, [&](size_t c) {
+    const size_t k0 = (c / nchunk_j) * chunk[0];
+    const size_t j0 = (c % nchunk_j) * chunk[1];
+    const size_t nk = std::min<size_t>(chunk[0], nlev - k0);
+    const size_t nj = std::min<size_t>(chunk[1], ncells - j0);
+
+    // edge chunks are stored at full size, padded with zeros
+    std::vector<unsigned char> buffer(chunk[0] * chunk[1] * sizeof(real_t), 0),
+        scratch;
+    for (size_t k = 0; k < nk; ++k)
+      std::memcpy(buffer.data() + k * chunk[1] * sizeof(real_t),
+                  v + (k0 + k) * ncells + j0, nj * sizeof(real_t));
+
+    for (H5Z_filter_t id : filters) {
+      if (id == H5Z_FILTER_SHUFFLE) {
+        scratch.resize(buffer.size());
+        shuffle_chunk(buffer, scratch, sizeof(real_t));
+      } else if (!deflate_chunk(buffer, scratch, level)) {
+        failed = true;
+        return;
+      }
+      buffer.swap(scratch);
+    }
+    compressed[c] = std::move(buffer);
+  });
+
+  // HDF5 is not thread safe: the chunks are stored from this thread
+  for (size_t c = 0; c < compressed.size() && !failed; ++c) {
+    hsize_t offset[2] = {(c / nchunk_j) * chunk[0], (c % nchunk_j) * chunk[1]};
+    failed = H5Dwrite_chunk(dset, H5P_DEFAULT, 0, offset, compressed[c].size(),
+                            compressed[c].data()) < 0;
+  }
+  H5Dclose(dset);
+  if (failed)
+    throw std::runtime_error("chunk_writer: writing " + name + " failed");
+}
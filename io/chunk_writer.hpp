@@ -0,0 +1,43 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include "../core/common/types.hpp"
+#include <hdf5.h>
+#include <string>
+
+namespace io_muphys {
+
+/**
+ * @brief Writes netCDF-4 variables as precompressed HDF5 chunks
+ *
+ * The variables are defined through netCDF (chunk shape, shuffle, deflate)
+ * and left unwritten; after the file is closed, this writer reopens it with
+ * HDF5, compresses all chunks of a variable on a pool of threads and stores
+ * them with H5Dwrite_chunk, bypassing the serial HDF5 filter pipeline.
+ */
+class chunk_writer {
+public:
+  explicit chunk_writer(const std::string &file);
+  ~chunk_writer();
+
+  chunk_writer(const chunk_writer &) = delete;
+  chunk_writer &operator=(const chunk_writer &) = delete;
+
+  /* writes the [nlev][ncells] field v with the filters of the dataset */
+  void write(const std::string &name, const real_t *v, size_t ncells,
+             size_t nlev, unsigned nthreads);
+
+private:
+  hid_t file;
+};
+
+} // namespace io_muphys
@@ -10,12 +10,206 @@
 // ---------------------------------------------------------------
 //
 #include "io.hpp"
+#include "../core/common/energy.hpp"
 #include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
 #include <map>
 
+#ifdef MU_CHUNK_READER
+#include "chunk_reader.hpp"
+#endif
+#ifdef MU_CHUNK_WRITER
+#include "chunk_writer.hpp"
+#endif
+#if defined(MU_CHUNK_READER) || defined(MU_CHUNK_WRITER)
+#include "parallel_for.hpp"
+#endif
+
 static const int NC_ERR = 2;
 static const std::string BASE_VAR = "zg";
 
+string io_muphys::step_file_name(const string &output_file, size_t step) {
+  string number = std::to_string(step);
+  number.insert(0, number.size() < 4 ? 4 - number.size() : 0, '0');
+  size_t dot = output_file.rfind('.');
+  if (dot == string::npos || output_file.find('/', dot) != string::npos)
+    return output_file + "_" + number;
+  return output_file.substr(0, dot) + "_" + number + output_file.substr(dot);
+}
+
+io_muphys::output_view_t io_muphys::output_view(const State &state) {
+  output_view_t view;
+  for (size_t f = 0; f < n_output; ++f)
+    view[f] = output_fields[f].surface ? state.surface(output_fields[f].slot)
+                                       : state.field(output_fields[f].slot);
+  return view;
+}
+
+size_t io_muphys::output_state_t::offset(size_t f) const {
+  size_t n = 0;
+  for (size_t i = 0; i < f; ++i)
+    n += (output_fields[i].surface ? 1 : nlev) * ncells;
+  return n;
+}
+
+void io_muphys::output_state_t::allocate(size_t ncells_, size_t nlev_) {
+  ncells = ncells_;
+  nlev = nlev_;
+  values.resize(offset(n_output));
+}
+
+void io_muphys::output_state_t::assign(const State &state) {
+  allocate(state.ncells, state.nlev);
+  const output_view_t src = output_view(state);
+  for (size_t f = 0; f < n_output; ++f)
+    std::copy(src[f], src[f] + (output_fields[f].surface ? 1 : nlev) * ncells,
+              field(f));
+}
+
+io_muphys::output_view_t io_muphys::output_state_t::view() const {
+  output_view_t view;
+  for (size_t f = 0; f < n_output; ++f)
+    view[f] = values.data() + offset(f);
+  return view;
+}
+
+io_muphys::options_t io_muphys::parse_options(int &argc, char **argv,
+                                              bool verbose) {
+  options_t options;
+  int nargs = 1;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg.rfind("--", 0) != 0) {
+      argv[nargs++] = argv[i];
+      continue;
+    }
+    const size_t eq = arg.find('=');
+    const string key = arg.substr(2, eq == string::npos ? eq : eq - 2);
+    const string value = eq == string::npos ? "" : arg.substr(eq + 1);
+    if (key == "deflate") {
+      options.deflate_level = std::stoi(value);
+      if (options.deflate_level < 0 || options.deflate_level > 9)
+        throw std::invalid_argument("--deflate must be in 0..9");
+    } else if (key == "chunk") {
+      const size_t x = value.find('x');
+      if (x == string::npos)
+        throw std::invalid_argument("--chunk expects <nlev>x<ncells>");
+      options.chunk_nlev = std::stoul(value.substr(0, x));
+      options.chunk_ncells = std::stoul(value.substr(x + 1));
+      if (options.chunk_nlev == 0 || options.chunk_ncells == 0)
+        throw std::invalid_argument("--chunk sizes must be positive");
+    } else if (key == "mpi-io") {
+      if (value != "collective" && value != "independent")
+        throw std::invalid_argument("--mpi-io expects collective|independent");
+      options.collective_io = value == "collective";
+    } else if (key == "io-tasks") {
+      options.io_tasks = std::stoi(value);
+      if (options.io_tasks < 0)
+        throw std::invalid_argument("--io-tasks must not be negative");
+    } else if (key == "partition") {
+      if (value != "even" && value != "activity")
+        throw std::invalid_argument("--partition expects even|activity");
+      options.partition = value;
+    } else if (key == "node-io") {
+      if (eq != string::npos)
+        throw std::invalid_argument("--node-io takes no value");
+      options.node_io = true;
+    } else if (key == "bind") {
+      if (value != "none" && value != "numa")
+        throw std::invalid_argument("--bind expects none|numa");
+      options.bind = value;
+    } else if (key == "order") {
+      if (value != "file" && value != "hilbert" && value != "morton")
+        throw std::invalid_argument("--order expects file|hilbert|morton");
+      options.cell_order = value;
+    } else if (key == "rebalance") {
+      if (value.empty() || value[0] == '-')
+        throw std::invalid_argument("--rebalance expects a step count");
+      options.rebalance_interval = std::stoul(value);
+    } else if (key == "report") {
+      if (value.empty())
+        throw std::invalid_argument("--report expects a file name");
+      options.report_file = value;
+    } else if (key == "energy") {
+      if (eq != string::npos)
+        throw std::invalid_argument("--energy takes no value");
+      options.energy = true;
+    } else if (key == "activity") {
+      if (value.empty())
+        throw std::invalid_argument("--activity expects a file name");
+      options.activity_file = value;
+    } else if (key == "trace") {
+      if (value.empty())
+        throw std::invalid_argument("--trace expects a file name");
+      options.trace_file = value;
+    } else if (key == "bench" || key == "warmup") {
+      if (value.empty() || value[0] == '-')
+        throw std::invalid_argument("--" + key + " expects an iteration count");
+      (key == "bench" ? options.bench_iterations : options.bench_warmup) =
+          std::stoul(value);
+    } else if (key == "roofline") {
+      options.roofline = true;
+      if (eq != string::npos) {
+        const size_t colon = value.find(':');
+        if (colon == string::npos)
+          throw std::invalid_argument("--roofline expects <GB/s>:<GFLOP/s>");
+        options.roof_gbs = std::stod(value.substr(0, colon));
+        options.roof_gflops = std::stod(value.substr(colon + 1));
+        if (options.roof_gbs <= 0.0 || options.roof_gflops <= 0.0)
+          throw std::invalid_argument("--roofline roof must be positive");
+      }
+    } else if (key == "mpi-hint") {
+      const size_t heq = value.find('=');
+      if (heq == string::npos || heq == 0)
+        throw std::invalid_argument("--mpi-hint expects <key>=<value>");
+      options.mpi_hints.emplace_back(value.substr(0, heq),
+                                     value.substr(heq + 1));
+    } else {
+      throw std::invalid_argument("unknown option " + arg);
+    }
+  }
+  argc = nargs;
+  argv[argc] = nullptr;
+
+  if (!verbose)
+    return options;
+  cout << "deflate: " << options.deflate_level << "\n";
+  if (options.deflate_level > 0)
+    cout << "chunk: " << options.chunk_nlev << "x" << options.chunk_ncells
+         << "\n";
+  if (!options.report_file.empty())
+    cout << "report: " << options.report_file << "\n";
+  if (!options.trace_file.empty())
+    cout << "trace: " << options.trace_file << "\n";
+  if (!options.activity_file.empty())
+    cout << "activity: " << options.activity_file << "\n";
+  if (options.energy)
+    cout << "energy: " << utils_muphys::rapl_root() << "\n";
+  if (options.roofline && options.roof_gbs > 0.0)
+    cout << "roofline: " << options.roof_gbs << " GB/s, " << options.roof_gflops
+         << " GFLOP/s\n";
+  else if (options.roofline)
+    cout << "roofline: probe\n";
+  if (options.bench_iterations > 0)
+    cout << "bench: " << options.bench_iterations << " iterations, "
+         << options.bench_warmup << " warm-up\n";
+#ifdef USE_MPI
+  cout << "mpi-io: " << (options.collective_io ? "collective" : "independent")
+       << "\n";
+  for (const auto &[key, value] : options.mpi_hints)
+    cout << "mpi-hint: " << key << "=" << value << "\n";
+  cout << "io-tasks: " << options.io_tasks << "\n";
+  cout << "partition: " << options.partition << "\n";
+  cout << "rebalance: " << options.rebalance_interval << "\n";
+  cout << "order: " << options.cell_order << "\n";
+  cout << "bind: " << options.bind << "\n";
+  cout << "node-io: " << (options.node_io ? "on" : "off") << "\n";
+#endif
+  return options;
+}
+
 void io_muphys::parse_args(string &file, string &outfile, size_t &itime, real_t &dt, real_t &qnc,
                            int argc, char **argv) {
   file = "aes-new-gr_moderate-dt30s_atm_3d_ml_20080801T000000Z.nc";
@@ -50,11 +244,27 @@ void io_muphys::parse_args(string &file, string &outfile, size_t &itime, real_t
   cout << "qnc: " << qnc << endl;
 }
 
+/* sizes the chunk cache of a chunked variable for one row of chunks across
+ * the cells; chunks are read once, so fully read ones are evicted first */
+static void tune_chunk_cache(const NcVar &var, size_t ncells) {
+  NcVar::ChunkMode mode;
+  array_1d_t<size_t> chunk;
+  var.getChunkingParameters(mode, chunk);
+  if (mode != NcVar::nc_CHUNKED || chunk.empty() || chunk.back() == 0)
+    return;
+
+  size_t chunk_bytes = var.getType().getSize();
+  for (size_t c : chunk)
+    chunk_bytes *= c;
+  const size_t nchunks = (ncells + chunk.back() - 1) / chunk.back();
+  var.setChunkCache(nchunks * chunk_bytes,
+                    std::max<size_t>(1009, 10 * nchunks), 1.0f);
+}
+
 /* read-in time-constant data fields without a time dimension */
-void io_muphys::input_vector(NcFile &datafile, array_1d_t<real_t> &v,
-                             const string input, size_t &ncells, size_t &nlev) {
+void io_muphys::input_vector(NcFile &datafile, real_t *v, const string input,
+                             size_t &ncells, size_t &nlev) {
   NcVar var;
-  v.resize(ncells * nlev);
   /*  access the input variable */
   try {
     var = datafile.getVar(input);
@@ -66,9 +276,10 @@ void io_muphys::input_vector(NcFile &datafile, array_1d_t<real_t> &v,
   }
   /*  read-in input field values */
   try {
+    tune_chunk_cache(var, ncells);
     array_1d_t<size_t> startp = {0, 0};
     array_1d_t<size_t> count = {nlev, ncells};
-    var.getVar(startp, count, v.data());
+    var.getVar(startp, count, v);
   } catch (NcNotVar &e) {
     cout << "FAILURE in reading values from " << input
          << " (no time dimensions) *******" << endl;
@@ -77,18 +288,17 @@ void io_muphys::input_vector(NcFile &datafile, array_1d_t<real_t> &v,
   }
 }
 
-void io_muphys::input_vector(NcFile &datafile, array_1d_t<real_t> &v,
-                             const string input, size_t &ncells, size_t &nlev,
-                             size_t itime) {
+void io_muphys::input_vector(NcFile &datafile, real_t *v, const string input,
+                             size_t &ncells, size_t &nlev, size_t itime) {
   NcVar att = datafile.getVar(input);
   try {
-    v.resize(ncells * nlev);
     if (att.isNull()) {
       throw NC_ERR;
     }
+    tune_chunk_cache(att, ncells);
     array_1d_t<size_t> startp = {itime, 0, 0};
     array_1d_t<size_t> count = {1, nlev, ncells};
-    att.getVar(startp, count, v.data());
+    att.getVar(startp, count, v);
   } catch (NcException &e) {
     e.what();
     cout << "FAILURE in reading " << input << " **************************"
@@ -98,36 +308,48 @@ void io_muphys::input_vector(NcFile &datafile, array_1d_t<real_t> &v,
 }
 
 void io_muphys::output_vector(NcFile &datafile, array_1d_t<NcDim> &dims,
-                              const string output, array_1d_t<real_t> &v,
+                              const string output, const real_t *v,
                               size_t &ncells, size_t &nlev,
-                              int &deflate_level) {
+                              const options_t &options) {
   // fortran:column major while c++ is row major
   NCreal_t ncreal_t;
   netCDF::NcVar var = datafile.addVar(output, ncreal_t, dims);
 
-  for (size_t i = 0; i < nlev; ++i) {
-    var.putVar({i, 0}, {1, ncells}, &v[i * ncells]);
-  }
-  if (deflate_level > 0) {
-    var.setCompression(true, false, deflate_level);
+  if (options.deflate_level > 0) {
+    array_1d_t<size_t> chunk = {std::min(options.chunk_nlev, nlev),
+                                std::min(options.chunk_ncells, ncells)};
+    var.setChunking(NcVar::nc_CHUNKED, chunk);
+    var.setCompression(true, true, options.deflate_level);
   }
+#ifdef MU_CHUNK_WRITER
+  // compressed variables are written by write_compressed_chunks
+  if (options.deflate_level == 0)
+#endif
+  // the [nlev][ncells] field is contiguous: one write for the whole variable
+  var.putVar({0, 0}, {nlev, ncells}, v);
 }
 
 void io_muphys::output_vector(NcFile &datafile, array_1d_t<NcDim> &dims,
                               const string output,
                               std::map<std::string, NcVarAtt> varAttributes,
-                              array_1d_t<real_t> &v, size_t &ncells,
-                              size_t &nlev, int &deflate_level) {
+                              const real_t *v, size_t &ncells,
+                              size_t &nlev, const options_t &options) {
   // fortran:column major while c++ is row major
   NCreal_t ncreal_t;
   netCDF::NcVar var = datafile.addVar(output, ncreal_t, dims);
 
-  for (size_t i = 0; i < nlev; ++i) {
-    var.putVar({i, 0}, {1, ncells}, &v[i * ncells]);
-  }
-  if (deflate_level > 0) {
-    var.setCompression(true, false, deflate_level);
+  if (options.deflate_level > 0) {
+    array_1d_t<size_t> chunk = {std::min(options.chunk_nlev, nlev),
+                                std::min(options.chunk_ncells, ncells)};
+    var.setChunking(NcVar::nc_CHUNKED, chunk);
+    var.setCompression(true, true, options.deflate_level);
   }
+#ifdef MU_CHUNK_WRITER
+  // compressed variables are written by write_compressed_chunks
+  if (options.deflate_level == 0)
+#endif
+  // the [nlev][ncells] field is contiguous: one write for the whole variable
+  var.putVar({0, 0}, {nlev, ncells}, v);
   /* Add given attribues to the output variables (string, only) */
   for (auto &attribute_name : {"standard_name", "long_name", "units",
                                "coordinates", "CDI_grid_type"}) {
@@ -142,13 +364,8 @@ void io_muphys::output_vector(NcFile &datafile, array_1d_t<NcDim> &dims,
 }
 
 void io_muphys::read_fields(const string input_file, size_t &itime,
-                            size_t &ncells, size_t &nlev, array_1d_t<real_t> &z,
-                            array_1d_t<real_t> &t, array_1d_t<real_t> &p,
-                            array_1d_t<real_t> &rho, array_1d_t<real_t> &qv,
-                            array_1d_t<real_t> &qc, array_1d_t<real_t> &qi,
-                            array_1d_t<real_t> &qr, array_1d_t<real_t> &qs,
-                            array_1d_t<real_t> &qg) {
-
+                            size_t &ncells, size_t &nlev, State &state) {
+  MU_TRACE_SCOPE("read_fields");
   NcFile datafile(input_file, NcFile::read);
 
   /*  read in the dimensions from the base variable: zg
@@ -159,65 +376,93 @@ void io_muphys::read_fields(const string input_file, size_t &itime,
   nlev = baseDims[0].getSize();
   ncells = baseDims[1].getSize();
 
-  io_muphys::input_vector(datafile, z, "zg", ncells, nlev);
-  io_muphys::input_vector(datafile, t, "ta", ncells, nlev, itime);
+  /* every variable lands directly in its slice of the state tensor */
+  state.allocate(ncells, nlev);
+
+  std::vector<bool> done(std::size(input_fields), false);
+
+#ifdef MU_CHUNK_READER
+  /* deflated netCDF-4 variables are inflated chunk by chunk on all threads,
+   * everything else (contiguous or classic files) takes the netCDF path */
+  datafile.close();
+  {
+    io_muphys::chunk_reader reader(input_file);
+    for (const auto &field : input_fields) {
+      if (field.timed)
+        reader.add(field.name, state.field(field.slot), ncells, nlev, itime);
+      else
+        reader.add(field.name, state.field(field.slot), ncells, nlev);
+    }
+    done = reader.read(io_muphys::io_threads());
+  }
+  if (std::find(done.begin(), done.end(), false) == done.end())
+    return;
+  datafile.open(input_file, NcFile::read);
+#endif
 
-  io_muphys::input_vector(datafile, p, "pfull", ncells, nlev, itime);
-  io_muphys::input_vector(datafile, rho, "rho", ncells, nlev, itime);
-  io_muphys::input_vector(datafile, qv, "hus", ncells, nlev, itime);
-  io_muphys::input_vector(datafile, qc, "clw", ncells, nlev, itime);
-  io_muphys::input_vector(datafile, qi, "cli", ncells, nlev, itime);
-  io_muphys::input_vector(datafile, qr, "qr", ncells, nlev, itime);
-  io_muphys::input_vector(datafile, qs, "qs", ncells, nlev, itime);
-  io_muphys::input_vector(datafile, qg, "qg", ncells, nlev, itime);
+  for (size_t i = 0; i < std::size(input_fields); ++i) {
+    if (done[i])
+      continue;
+    const auto &field = input_fields[i];
+    if (field.timed)
+      io_muphys::input_vector(datafile, state.field(field.slot), field.name,
+                              ncells, nlev, itime);
+    else
+      io_muphys::input_vector(datafile, state.field(field.slot), field.name,
+                              ncells, nlev);
+  }
 
   datafile.close();
 }
 
-void io_muphys::write_fields(
-    string output_file, size_t &ncells, size_t &nlev, array_1d_t<real_t> &t,
-    array_1d_t<real_t> &qv, array_1d_t<real_t> &qc, array_1d_t<real_t> &qi,
-    array_1d_t<real_t> &qr, array_1d_t<real_t> &qs, array_1d_t<real_t> &qg,
-    array_1d_t<real_t> &prr_gsp, array_1d_t<real_t> &pri_gsp,
-    array_1d_t<real_t> &prs_gsp, array_1d_t<real_t> &prg_gsp,
-    array_1d_t<real_t> &pre_gsp, array_1d_t<real_t> &pflx) {
+/* stores the variables left unwritten by output_vector as chunks that are
+ * compressed on all threads */
+static void write_compressed_chunks([[maybe_unused]] const string &output_file,
+                                    [[maybe_unused]] size_t ncells,
+                                    [[maybe_unused]] size_t nlev,
+                                    [[maybe_unused]] const io_muphys::output_view_t &fields,
+                                    const io_muphys::options_t &options) {
+  if (options.deflate_level == 0)
+    return;
+#ifdef MU_CHUNK_WRITER
+  io_muphys::chunk_writer writer(output_file);
+  const unsigned nthreads = io_muphys::io_threads();
+  for (size_t f = 0; f < io_muphys::n_output; ++f) {
+    const auto &field = io_muphys::output_fields[f];
+    writer.write(field.name, fields[f], ncells, field.surface ? 1 : nlev,
+                 nthreads);
+  }
+#endif
+}
+
+void io_muphys::write_fields(string output_file, size_t &ncells, size_t &nlev,
+                             const State &state, const options_t &options) {
+  io_muphys::write_fields(output_file, ncells, nlev, output_view(state),
+                          options);
+}
+
+void io_muphys::write_fields(string output_file, size_t ncells, size_t nlev,
+                             const output_view_t &fields,
+                             const options_t &options) {
+  MU_TRACE_SCOPE("write_fields");
   NcFile datafile(output_file, NcFile::replace);
   NcDim ncells_dim = datafile.addDim("ncells", ncells);
   NcDim nlev_dim = datafile.addDim("height", nlev);
   std::vector<NcDim> dims = {nlev_dim, ncells_dim};
-  int deflate_level = 0;
   size_t onelev = 1;
   NcDim onelev_dim = datafile.addDim("height1", onelev);
   std::vector<NcDim> dims1d = {onelev_dim, ncells_dim};
 
-  io_muphys::output_vector(datafile, dims, "ta", t, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "hus", qv, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "clw", qc, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "cli", qi, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "qr", qr, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "qs", qs, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "qg", qg, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "pflx", pflx, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "prr_gsp", prr_gsp, ncells, onelev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "prs_gsp", prs_gsp, ncells, onelev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "pri_gsp", pri_gsp, ncells, onelev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "prg_gsp", prg_gsp, ncells, onelev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "pre_gsp", pre_gsp, ncells, onelev,
-                           deflate_level);
+  for (size_t f = 0; f < n_output; ++f) {
+    const auto &field = output_fields[f];
+    io_muphys::output_vector(datafile, field.surface ? dims1d : dims,
+                             field.name, fields[f], ncells,
+                             field.surface ? onelev : nlev, options);
+  }
 
   datafile.close();
+
+  write_compressed_chunks(output_file, ncells, nlev, fields, options);
 }
 
 
@@ -267,14 +512,10 @@ void io_muphys::write_fields(
   }
 }
 
-void io_muphys::write_fields(
-    string output_file, string input_file, size_t &ncells, size_t &nlev,
-    array_1d_t<real_t> &t, array_1d_t<real_t> &qv, array_1d_t<real_t> &qc,
-    array_1d_t<real_t> &qi, array_1d_t<real_t> &qr, array_1d_t<real_t> &qs,
-    array_1d_t<real_t> &qg, array_1d_t<real_t> &prr_gsp,
-    array_1d_t<real_t> &pri_gsp, array_1d_t<real_t> &prs_gsp,
-    array_1d_t<real_t> &prg_gsp, array_1d_t<real_t> &pre_gsp,
-    array_1d_t<real_t> &pflx) {
+void io_muphys::write_fields(string output_file, string input_file,
+                             size_t &ncells, size_t &nlev, const State &state,
+                             const options_t &options) {
+  MU_TRACE_SCOPE("write_fields");
   NcFile datafile(output_file, NcFile::replace);
   NcFile inputfile(input_file, NcFile::read);
   auto baseDims = inputfile.getVar(BASE_VAR).getDims();
@@ -290,46 +531,32 @@ void io_muphys::write_fields(
   /*TODO  height_bnds might have a different name */
 
   std::vector<NcDim> dims = {nlev_dim, ncells_dim};
-  int deflate_level = 0;
   size_t onelev = 1;
   NcDim onelev_dim = datafile.addDim("height1", onelev);
   std::vector<NcDim> dims1d = {onelev_dim, ncells_dim};
 
-  io_muphys::output_vector(datafile, dims, "ta",
-                           inputfile.getVar("ta").getAtts(), t, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "hus",
-                           inputfile.getVar("hus").getAtts(), qv, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "clw",
-                           inputfile.getVar("clw").getAtts(), qc, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "cli",
-                           inputfile.getVar("cli").getAtts(), qi, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "qr",
-                           inputfile.getVar("qr").getAtts(), qr, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "qs",
-                           inputfile.getVar("qs").getAtts(), qs, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "qg",
-                           inputfile.getVar("qg").getAtts(), qg, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims, "pflx", pflx, ncells, nlev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "prr_gsp", prr_gsp, ncells, onelev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "prs_gsp", prs_gsp, ncells, onelev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "pri_gsp", pri_gsp, ncells, onelev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "prg_gsp", prg_gsp, ncells, onelev,
-                           deflate_level);
-  io_muphys::output_vector(datafile, dims1d, "pre_gsp", pre_gsp, ncells, onelev,
-                           deflate_level);
+  const output_view_t fields = output_view(state);
+  for (size_t f = 0; f < n_output; ++f) {
+    const auto &field = output_fields[f];
+    // the variables that are also inputs keep the attributes of the input
+    const bool input =
+        std::any_of(std::begin(input_fields), std::end(input_fields),
+                    [&](const input_field_t &in) {
+                      return std::strcmp(in.name, field.name) == 0;
+                    });
+    if (input)
+      io_muphys::output_vector(datafile, dims, field.name,
+                               inputfile.getVar(field.name).getAtts(),
+                               fields[f], ncells, nlev, options);
+    else
+      io_muphys::output_vector(datafile, field.surface ? dims1d : dims,
+                               field.name, fields[f], ncells,
+                               field.surface ? onelev : nlev, options);
+  }
   inputfile.close();
   datafile.close();
+
+  write_compressed_chunks(output_file, ncells, nlev, fields, options);
 }
 
 [[maybe_unused]] static void copy_coordinate_variables(NcFile &datafile, NcFile &inputfile,
@@ -448,20 +675,19 @@ namespace io_muphys {
                         size_t start_cell,
                         size_t ncell_loc,
                         size_t nlev,
-                        array_1d_t<real_t> &arr) {
+                        real_t *arr,
+                        int par_access) {
       int varid;
       // find variable ID
       if (nc_inq_varid(ncid, name, &varid)) 
           throw std::runtime_error(std::string("Variable not found: ") + name);
-      // set collective I/O
-      nc_var_par_access(ncid, varid, NC_INDEPENDENT);
+      // independent or collective I/O
+      nc_var_par_access(ncid, varid, par_access);
       // define the hyperslab: [time, level, cell]
       size_t start[3] = { itime, 0, start_cell };
       size_t count[3] = { 1, nlev, ncell_loc };
-      // allocate local buffer
-      arr.resize(nlev * ncell_loc);
       // read
-      if (NC_GET_VARA(ncid, varid, start, count, arr.data()))
+      if (NC_GET_VARA(ncid, varid, start, count, arr))
           throw std::runtime_error(std::string("Failed to read var: ") + name);
   }
 
@@ -471,20 +697,19 @@ namespace io_muphys {
                         size_t start_cell,
                         size_t ncell_loc,
                         size_t nlev,
-                        array_1d_t<real_t> &arr) {
+                        real_t *arr,
+                        int par_access) {
       int varid;
       // find variable ID
       if (nc_inq_varid(ncid, name, &varid)) 
           throw std::runtime_error(std::string("Variable not found: ") + name);
-      // independent I/O is fine for static fields
-      nc_var_par_access(ncid, varid, NC_INDEPENDENT);
+      // independent or collective I/O
+      nc_var_par_access(ncid, varid, par_access);
       // define hyperslab: [level, cell]
       size_t start[2] = { 0, start_cell };
       size_t count[2] = { nlev, ncell_loc };
-      // allocate local buffer
-      arr.resize(nlev * ncell_loc);
       // read
-      if (NC_GET_VARA(ncid, varid, start, count, arr.data()))
+      if (NC_GET_VARA(ncid, varid, start, count, arr))
           throw std::runtime_error(std::string("Failed to read var: ") + name);
   }
   // Helper: write a 3D variable [time, level, cell] in parallel
@@ -494,14 +719,14 @@ namespace io_muphys {
                          size_t start_cell,
                          size_t ncell_loc,
                          size_t nlev,
-                         const array_1d_t<real_t>& arr) {
+                         const real_t *arr) {
 
       // define hyperslab: [time, level, cell]
       size_t startp[3] = { itime, 0, start_cell };
       size_t countp[3] = { 1, nlev, ncell_loc };
 
       // write data (assuming arr is ordered as [level][cell])
-      if (NC_PUT_VARA(ncid, varid, startp, countp, arr.data())) {
+      if (NC_PUT_VARA(ncid, varid, startp, countp, arr)) {
           throw std::runtime_error("Failed to write var: " + std::to_string(varid));
       }
   }
@@ -511,100 +736,160 @@ namespace io_muphys {
                          size_t start_cell,
                          size_t ncell_loc,
                          size_t nlev,
-                         const array_1d_t<real_t>& arr) {
-      // write data block (assuming arr is ordered as [level][cell])
-      for (size_t lvl = 0; lvl < nlev; ++lvl) {
-          size_t startp[2] = { lvl, start_cell };
-          size_t countp[2] = { 1, ncell_loc };
-          const real_t* data_ptr = arr.data() + lvl * ncell_loc;
-          if (NC_PUT_VARA(ncid, varid, startp, countp, data_ptr)) {
-              throw std::runtime_error("Failed to write var: " + std::to_string(varid));
-          }
+                         const real_t *arr) {
+      // the local [level][cell] block is contiguous: one hyperslab write
+      size_t startp[2] = { 0, start_cell };
+      size_t countp[2] = { nlev, ncell_loc };
+      if (NC_PUT_VARA(ncid, varid, startp, countp, arr)) {
+          throw std::runtime_error("Failed to write var: " + std::to_string(varid));
       }
   }
-  void read_fields_mpi(const string input_file, size_t &itime,
-                            size_t &ncells, size_t &nlev, array_1d_t<real_t> &z,
-                            array_1d_t<real_t> &t, array_1d_t<real_t> &p,
-                            array_1d_t<real_t> &rho, array_1d_t<real_t> &qv,
-                            array_1d_t<real_t> &qc, array_1d_t<real_t> &qi,
-                            array_1d_t<real_t> &qr, array_1d_t<real_t> &qs,
-                            array_1d_t<real_t> &qg, MPI_Comm comm, MPI_Info info) {
-    int rank, nprocs;
-    MPI_Comm_rank(comm, &rank);
-    MPI_Comm_size(comm, &nprocs);
-
+#ifndef MU_PNETCDF
+  int open_input_mpi(const string &input_file, MPI_Comm comm, MPI_Info info) {
     int ncid;
     // open file in parallel mode
     if (nc_open_par(input_file.c_str(), NC_NOWRITE | NC_MPIIO, comm, info, &ncid)) {
         throw std::runtime_error("Failed to open NetCDF file in parallel");
     }
+    return ncid;
+  }
 
+  void close_input_mpi(int ncid) { nc_close(ncid); }
+
+  void input_dims_mpi(int ncid, size_t &ncells, size_t &nlev) {
     // inquire dimensions from "zg": [lev, cell]
-    
     int varid_zg;
-    nc_inq_varid(ncid, BASE_VAR.c_str(), &varid_zg);
-    size_t dimlen_lev, dimlen_cell;
     int dimids[2];
-    nc_inq_vardimid(ncid, varid_zg, dimids);  // Gets dimension IDs for zg
-    nc_inq_dimlen(ncid, dimids[0], &dimlen_lev); 
-    nc_inq_dimlen(ncid, dimids[1], &dimlen_cell);
-
-    nlev   = dimlen_lev;
-    ncells = dimlen_cell;
-
-    // compute local cell block
-    size_t base = ncells / nprocs;
-    size_t rem  = ncells % nprocs;
-    size_t ncell_loc = base + (rank < rem ? 1 : 0);
-    size_t start_cell = rank * base + std::min(rank, (int)rem);
-
-    // read static vertical grid
-    io_muphys::input_vector_mpi(ncid, "zg", start_cell, ncell_loc, nlev, z);
-
-    // read time‐dependent fields
-    io_muphys::input_vector_mpi(ncid, "ta",  itime, start_cell, ncell_loc, nlev, t);
-    io_muphys::input_vector_mpi(ncid, "pfull",itime, start_cell, ncell_loc, nlev, p);
-    io_muphys::input_vector_mpi(ncid, "rho", itime, start_cell, ncell_loc, nlev, rho);
-    io_muphys::input_vector_mpi(ncid, "hus", itime, start_cell, ncell_loc, nlev, qv);
-    io_muphys::input_vector_mpi(ncid, "clw", itime, start_cell, ncell_loc, nlev, qc);
-    io_muphys::input_vector_mpi(ncid, "cli", itime, start_cell, ncell_loc, nlev, qi);
-    io_muphys::input_vector_mpi(ncid, "qr",  itime, start_cell, ncell_loc, nlev, qr);
-    io_muphys::input_vector_mpi(ncid, "qs",  itime, start_cell, ncell_loc, nlev, qs);
-    io_muphys::input_vector_mpi(ncid, "qg",  itime, start_cell, ncell_loc, nlev, qg);
+    if (nc_inq_varid(ncid, BASE_VAR.c_str(), &varid_zg) ||
+        nc_inq_vardimid(ncid, varid_zg, dimids) ||
+        nc_inq_dimlen(ncid, dimids[0], &nlev) ||
+        nc_inq_dimlen(ncid, dimids[1], &ncells)) {
+        throw std::runtime_error("Variable not found: " + BASE_VAR);
+    }
+  }
+
+  void input_blocks_mpi(int ncid, size_t itime, size_t nlev,
+                        const std::vector<State *> &states,
+                        const std::vector<cell_block_t> &blocks,
+                        int par_access, MPI_Comm comm) {
+    // collective access needs the same number of calls on every rank
+    int nblocks = static_cast<int>(blocks.size()), ncalls = nblocks;
+    if (par_access == NC_COLLECTIVE)
+      MPI_Allreduce(&nblocks, &ncalls, 1, MPI_INT, MPI_MAX, comm);
+    real_t none = ZERO;
+    for (const auto &field : input_fields) {
+      for (int b = 0; b < ncalls; ++b) {
+        const cell_block_t block = b < nblocks ? blocks[b] : cell_block_t();
+        real_t *v = b < nblocks ? states[b]->field(field.slot) : &none;
+        if (field.timed)
+          io_muphys::input_vector_mpi(ncid, field.name, itime, block.start,
+                                      block.count, nlev, v, par_access);
+        else
+          io_muphys::input_vector_mpi(ncid, field.name, block.start,
+                                      block.count, nlev, v, par_access);
+      }
+    }
+  }
+#endif // MU_PNETCDF
+
+  void read_fields_mpi(const string input_file, size_t &itime,
+                            size_t &ncells, size_t &nlev, State &state,
+                            MPI_Comm comm, MPI_Info info,
+                            const options_t &options, io_timing_t *timing) {
+    MU_TRACE_SCOPE("read_fields_mpi");
+    int rank, nprocs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+    const int par_access = options.collective_io ? NC_COLLECTIVE : NC_INDEPENDENT;
+    io_timing_t t;
+    double t0 = MPI_Wtime();
+
+    const int ncid = io_muphys::open_input_mpi(input_file, comm, info);
+    io_muphys::input_dims_mpi(ncid, ncells, nlev);
+
+    // local cell block; the activity partition needs the input of all
+    // cells first, so it migrates them after the read
+    const cell_block_t local = even_block(ncells, rank, nprocs);
+
+    // every variable lands directly in its slice of the state tensor
+    state.allocate(local.count, nlev);
+
+    t.open = MPI_Wtime() - t0;
+    t0 = MPI_Wtime();
+
+    io_muphys::input_blocks_mpi(ncid, itime, nlev, {&state}, {local}, par_access, comm);
+    t.data = MPI_Wtime() - t0;
+    t0 = MPI_Wtime();
 
     // close file
-    nc_close(ncid);
+    io_muphys::close_input_mpi(ncid);
+    t.close = MPI_Wtime() - t0;
+    if (timing)
+      *timing = t;
   }
 
   // Write 3D and 2D fields in parallel, splitting horizontal dimension across ranks
   void write_fields_mpi(const std::string &output_file,
                         size_t ncells,
                         size_t nlev,
-                        const array_1d_t<real_t> &t,
-                        const array_1d_t<real_t> &qv,
-                        const array_1d_t<real_t> &qc,
-                        const array_1d_t<real_t> &qi,
-                        const array_1d_t<real_t> &qr,
-                        const array_1d_t<real_t> &qs,
-                        const array_1d_t<real_t> &qg,
-                        const array_1d_t<real_t> &prr_gsp,
-                        const array_1d_t<real_t> &pri_gsp,
-                        const array_1d_t<real_t> &prs_gsp,
-                        const array_1d_t<real_t> &prg_gsp,
-                        const array_1d_t<real_t> &pre_gsp,
-                        const array_1d_t<real_t> &pflx,
-                        int deflate_level,
+                        const State &state,
+                        const options_t &options,
                         MPI_Comm comm,
-                        MPI_Info info) {
+                        MPI_Info info,
+                        io_timing_t *timing,
+                        const cell_block_t *block) {
     int rank, nprocs;
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &nprocs);
+    // local block of the cell dimension
+    const cell_block_t local = block ? *block : even_block(ncells, rank, nprocs);
+    io_muphys::write_fields_mpi(output_file, ncells, nlev, {output_view(state)},
+                                {local}, options, comm, info, timing);
+  }
+
+#ifndef MU_PNETCDF
+  void read_cell_coordinates_mpi(const string input_file,
+                                 std::vector<double> &clon,
+                                 std::vector<double> &clat, MPI_Comm comm,
+                                 MPI_Info info) {
+    MU_TRACE_SCOPE("read_cell_coordinates_mpi");
+    int ncid;
+    if (nc_open_par(input_file.c_str(), NC_NOWRITE | NC_MPIIO, comm, info, &ncid)) {
+        throw std::runtime_error("Failed to open NetCDF file in parallel");
+    }
+    for (auto [name, values] : {std::pair{"clon", &clon}, std::pair{"clat", &clat}}) {
+        int varid, dimid;
+        size_t len;
+        if (nc_inq_varid(ncid, name, &varid) || nc_inq_vardimid(ncid, varid, &dimid) ||
+            nc_inq_dimlen(ncid, dimid, &len)) {
+            nc_close(ncid);
+            throw std::runtime_error(string("cell ordering needs the variable ") + name);
+        }
+        values->resize(len);
+        if (nc_get_var_double(ncid, varid, values->data())) {
+            nc_close(ncid);
+            throw std::runtime_error(string("Failed to read var: ") + name);
+        }
+    }
+    nc_close(ncid);
+  }
 
-    // Compute local block for cell dimension
-    size_t base = ncells / nprocs;
-    size_t rem  = ncells % nprocs;
-    size_t ncell_loc = base + (rank < (int)rem ? 1 : 0);
-    size_t start_cell = rank * base + std::min<size_t>(rank, rem);
+  void write_fields_mpi(const std::string &output_file,
+                        size_t ncells,
+                        size_t nlev,
+                        const std::vector<output_view_t> &fields,
+                        const std::vector<cell_block_t> &blocks,
+                        const options_t &options,
+                        MPI_Comm comm,
+                        MPI_Info info,
+                        io_timing_t *timing) {
+    MU_TRACE_SCOPE("write_fields_mpi");
+    // netCDF only applies filters with collective access
+    const int deflate_level = options.deflate_level;
+    const int par_access = (options.collective_io || deflate_level > 0)
+                               ? NC_COLLECTIVE : NC_INDEPENDENT;
+    io_timing_t t;
+    double t0 = MPI_Wtime();
 
     int ncid;
     // create file in parallel mode
@@ -639,49 +924,171 @@ namespace io_muphys {
       int dimids[2] = {dim0, dim1};
       if (nc_def_var(ncid, name, NC_REAL_TYPE, 2, dimids, &varid))
           throw std::runtime_error("define failed");
-      if (deflate_level > 0)
-          nc_def_var_deflate(ncid, varid, 0, 1, deflate_level);
-      nc_var_par_access(ncid, varid, NC_INDEPENDENT);
+      if (deflate_level > 0) {
+          size_t chunk[2] = {std::min(options.chunk_nlev, dim0 == dimid_height ? nlev : onelev),
+                             std::min(options.chunk_ncells, ncells)};
+          if (nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunk))
+              throw std::runtime_error(string("chunking failed: ") + name);
+          if (nc_def_var_deflate(ncid, varid, 1, 1, deflate_level))
+              throw std::runtime_error(string("deflate failed: ") + name);
+      }
+      nc_var_par_access(ncid, varid, par_access);
       varids[name] = varid;
     };
 
-    def_var("ta", dimid_height, dimid_cell);
-    def_var("hus", dimid_height, dimid_cell);
-    def_var("clw", dimid_height, dimid_cell);
-    def_var("cli", dimid_height, dimid_cell);
-    def_var("qr", dimid_height, dimid_cell);
-    def_var("qs", dimid_height, dimid_cell);
-    def_var("qg", dimid_height, dimid_cell);
-    def_var("pflx", dimid_height, dimid_cell);
-
-    def_var("prr_gsp", dimid_height1, dimid_cell);
-    def_var("prs_gsp", dimid_height1, dimid_cell);
-    def_var("pri_gsp", dimid_height1, dimid_cell);
-    def_var("prg_gsp", dimid_height1, dimid_cell);
-    def_var("pre_gsp", dimid_height1, dimid_cell);
+    for (const auto &field : output_fields)
+      def_var(field.name, field.surface ? dimid_height1 : dimid_height,
+              dimid_cell);
 
     // exit define mode
     nc_enddef(ncid);
-
-    // 2D fields [height x cell]
-    io_muphys::output_vector_par(ncid, varids["ta"], start_cell, ncell_loc, nlev, t);
-    io_muphys::output_vector_par(ncid, varids["hus"], start_cell, ncell_loc, nlev, qv);
-    io_muphys::output_vector_par(ncid, varids["clw"], start_cell, ncell_loc, nlev, qc);
-    io_muphys::output_vector_par(ncid, varids["cli"], start_cell, ncell_loc, nlev, qi);
-    io_muphys::output_vector_par(ncid, varids["qr"], start_cell, ncell_loc, nlev, qr);
-    io_muphys::output_vector_par(ncid, varids["qs"], start_cell, ncell_loc, nlev, qs);
-    io_muphys::output_vector_par(ncid, varids["qg"], start_cell, ncell_loc, nlev, qg);
-    io_muphys::output_vector_par(ncid, varids["pflx"], start_cell, ncell_loc, nlev, pflx);
-
-    // surface fields [height1 x cell]
-    io_muphys::output_vector_par(ncid, varids["prr_gsp"], start_cell, ncell_loc, onelev, prr_gsp);
-    io_muphys::output_vector_par(ncid, varids["prs_gsp"], start_cell, ncell_loc, onelev, prs_gsp);
-    io_muphys::output_vector_par(ncid, varids["pri_gsp"], start_cell, ncell_loc, onelev, pri_gsp);
-    io_muphys::output_vector_par(ncid, varids["prg_gsp"], start_cell, ncell_loc, onelev, prg_gsp);
-    io_muphys::output_vector_par(ncid, varids["pre_gsp"], start_cell, ncell_loc, onelev, pre_gsp);
+    t.open = MPI_Wtime() - t0;
+    t0 = MPI_Wtime();
+
+    // collective access needs the same number of calls on every rank
+    int nblocks = static_cast<int>(blocks.size()), ncalls = nblocks;
+    if (par_access == NC_COLLECTIVE)
+      MPI_Allreduce(&nblocks, &ncalls, 1, MPI_INT, MPI_MAX, comm);
+    const real_t none = ZERO;
+    for (size_t f = 0; f < n_output; ++f) {
+      const auto &field = output_fields[f];
+      for (int b = 0; b < ncalls; ++b) {
+        const cell_block_t block = b < nblocks ? blocks[b] : cell_block_t();
+        const real_t *v = b < nblocks ? fields[b][f] : &none;
+        // 2D fields [height x cell], surface fields [height1 x cell]
+        io_muphys::output_vector_par(ncid, varids[field.name], block.start,
+                                     block.count, field.surface ? onelev : nlev, v);
+      }
+    }
+    t.data = MPI_Wtime() - t0;
+    t0 = MPI_Wtime();
 
     // close file
     nc_close(ncid);
+    t.close = MPI_Wtime() - t0;
+    if (timing)
+      *timing = t;
+  }
+
+#endif // MU_PNETCDF
+
+  MPI_Info make_mpi_info(const options_t &options) {
+    MPI_Info info = MPI_INFO_NULL;
+    if (options.mpi_hints.empty())
+      return info;
+    MPI_Info_create(&info);
+    for (const auto &[key, value] : options.mpi_hints)
+      MPI_Info_set(info, key.c_str(), value.c_str());
+    return info;
+  }
+
+  void check_options_mpi([[maybe_unused]] const options_t &options) {
+#ifdef MU_PNETCDF
+    if (options.deflate_level > 0)
+      throw std::invalid_argument(
+          "--deflate needs the NetCDF-4 backend, PnetCDF writes CDF-5");
+#endif
+  }
+
+  void report_io_timing(const char *label, const io_timing_t &timing,
+                        MPI_Comm comm) {
+    int rank, nprocs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+    const double local[3] = {timing.open, timing.data, timing.close};
+    double tmin[3], tmax[3], tsum[3];
+    MPI_Reduce(local, tmin, 3, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(local, tmax, 3, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(local, tsum, 3, MPI_DOUBLE, MPI_SUM, 0, comm);
+    if (rank)
+      return;
+    const char *phases[3] = {"open", "data", "close"};
+    for (int i = 0; i < 3; ++i)
+      cout << label << " " << phases[i] << " [s] min/mean/max : " << tmin[i]
+           << " / " << tsum[i] / nprocs << " / " << tmax[i] << "\n";
+  }
+
+  std::int64_t clock_offset_mpi(MPI_Comm comm) {
+    constexpr int rounds = 8;
+    constexpr int tag = 4712;
+    int rank, nprocs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+    std::int64_t offset = 0;
+    if (rank == 0) {
+      for (int r = 1; r < nprocs; ++r)
+        for (int i = 0; i < rounds; ++i) {
+          std::int64_t now;
+          MPI_Recv(&now, 1, MPI_INT64_T, r, tag, comm, MPI_STATUS_IGNORE);
+          now = utils_muphys::trace_now();
+          MPI_Send(&now, 1, MPI_INT64_T, r, tag, comm);
+        }
+      return offset;
+    }
+    std::int64_t best = INT64_MAX;
+    for (int i = 0; i < rounds; ++i) {
+      std::int64_t sent = utils_muphys::trace_now(), remote;
+      MPI_Send(&sent, 1, MPI_INT64_T, 0, tag, comm);
+      MPI_Recv(&remote, 1, MPI_INT64_T, 0, tag, comm, MPI_STATUS_IGNORE);
+      const std::int64_t received = utils_muphys::trace_now();
+      // rank 0 read its clock half way through the round trip
+      if (received - sent < best) {
+        best = received - sent;
+        offset = remote - (sent + received) / 2;
+      }
+    }
+    return offset;
+  }
+
+  void write_trace_mpi(const std::string &file, MPI_Comm comm) {
+    constexpr int tag = 4713;
+    int rank, nprocs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+    // times relative to the start of the trace on rank 0
+    std::int64_t origin = utils_muphys::trace_origin();
+    MPI_Bcast(&origin, 1, MPI_INT64_T, 0, comm);
+    const std::int64_t offset = clock_offset_mpi(comm) - origin;
+    const std::string events = utils_muphys::trace_events_json(
+        "rank " + std::to_string(rank), rank, offset);
+
+    // rank 0 opens the file first, so that all ranks give up together
+    std::ofstream out;
+    int opened = 1;
+    if (!rank) {
+      out.open(file);
+      opened = static_cast<bool>(out);
+    }
+    MPI_Bcast(&opened, 1, MPI_INT, 0, comm);
+    if (!opened)
+      throw std::runtime_error("cannot open the trace file " + file);
+
+    // rank 0 streams the events of one rank after the other into the file
+    if (rank) {
+      unsigned long long size = events.size();
+      MPI_Send(&size, 1, MPI_UNSIGNED_LONG_LONG, 0, tag, comm);
+      for (size_t pos = 0; pos < events.size(); pos += INT_MAX) {
+        const int count = static_cast<int>(
+            std::min<size_t>(INT_MAX, events.size() - pos));
+        MPI_Send(events.data() + pos, count, MPI_CHAR, 0, tag, comm);
+      }
+      return;
+    }
+    out << "{\"traceEvents\":[\n" << events;
+    std::string remote;
+    for (int r = 1; r < nprocs; ++r) {
+      unsigned long long size;
+      MPI_Recv(&size, 1, MPI_UNSIGNED_LONG_LONG, r, tag, comm, MPI_STATUS_IGNORE);
+      remote.resize(size);
+      for (size_t pos = 0; pos < remote.size(); pos += INT_MAX) {
+        const int count = static_cast<int>(
+            std::min<size_t>(INT_MAX, remote.size() - pos));
+        MPI_Recv(remote.data() + pos, count, MPI_CHAR, r, tag, comm,
+                 MPI_STATUS_IGNORE);
+      }
+      out << ",\n" << remote;
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
   }
 } // namespace io_muphys
 #endif
\ No newline at end of file
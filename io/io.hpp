@@ -10,10 +10,16 @@
 // ---------------------------------------------------------------
 //
 #pragma once
+#include "../core/common/state.hpp"
+#include "../core/common/trace.hpp"
 #include "../core/common/types.hpp"
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <netcdf>
+#include <utility>
+#include <vector>
 
 #ifdef USE_MPI
 #include <netcdf_par.h>
@@ -37,46 +43,166 @@ using NCreal_t = NcFloat;
 using NCreal_t = NcDouble;
 #endif
 
+/* I/O options, given on the command line as --key=value */
+struct options_t {
+  int deflate_level = 0;       // --deflate=<1..9>, 0 writes uncompressed
+  size_t chunk_nlev = 1;       // --chunk=<nlev>x<ncells>, shape of the
+  size_t chunk_ncells = 65536; // chunks of compressed variables
+  bool collective_io = false;  // --mpi-io=collective|independent
+  /* --mpi-hint=<key>=<value>, MPI-IO hints such as cb_nodes,
+   * cb_buffer_size or striping_factor */
+  std::vector<std::pair<std::string, std::string>> mpi_hints;
+  int io_tasks = 0; // --io-tasks=<n>, trailing MPI ranks that only write
+  /* --partition=even|activity, cell blocks of the MPI ranks: equal counts
+   * or equal cost of the active levels of the input */
+  std::string partition = "even";
+  /* --rebalance=<n>, repartition by the measured kernel time every n steps
+   * and migrate the cells, 0 keeps the initial blocks */
+  size_t rebalance_interval = 0;
+  /* --order=file|hilbert|morton, global cell order of the MPI blocks and
+   * of the cells within a rank, from clon and clat of the input */
+  std::string cell_order = "file";
+  /* --bind=none|numa, pin the threads of every rank to a slice of the
+   * cores of its node ordered by NUMA domain */
+  std::string bind = "none";
+  /* --node-io, the first rank of every node reads and writes for all ranks
+   * of the node through MPI shared memory */
+  bool node_io = false;
+  /* --report=<file>, phase times and bandwidth of the run as JSON, or as
+   * CSV for a .csv file */
+  std::string report_file;
+  /* --bench=<n>, replay the input n times, each timed iteration starting
+   * from the same state, and report the latency distribution */
+  size_t bench_iterations = 0;
+  size_t bench_warmup = 3; // --warmup=<n>, untimed iterations before them
+  /* --roofline, probe the bandwidth and FP rate of the machine at startup
+   * and place the kernel phases on the roofline; --roofline=<GB/s>:<GFLOP/s>
+   * takes the roof as given, e.g. of a GPU */
+  bool roofline = false;
+  double roof_gbs = 0.0, roof_gflops = 0.0;
+  /* --trace=<file>, record the scopes of all threads (and ranks) and write
+   * them as Chrome Trace Event JSON; needs MU_ENABLE_TRACE */
+  std::string trace_file;
+  /* --energy, read the RAPL package and DRAM energy of the node around the
+   * phases of the run; MU_RAPL_ROOT=<dir> reads a stand-in directory */
+  bool energy = false;
+  /* --activity=<file>, active points per level, kmin, regimes and limiter
+   * activations of every step as JSON, or as CSV for a .csv file; needs
+   * MU_ENABLE_ACTIVITY_STATS */
+  std::string activity_file;
+};
+
+/* contiguous block of cells owned by one rank */
+struct cell_block_t {
+  size_t start = 0;
+  size_t count = 0;
+};
+
+/* even split of ncells over nprocs ranks, the first ranks get one more */
+inline cell_block_t even_block(size_t ncells, size_t rank, size_t nprocs) {
+  const size_t base = ncells / nprocs;
+  const size_t rem = ncells % nprocs;
+  return {rank * base + std::min(rank, rem), base + (rank < rem ? 1 : 0)};
+}
+
+/* a variable of the output files: name, state slot, surface or 3D field */
+struct output_field_t {
+  const char *name;
+  size_t slot;
+  bool surface;
+};
+
+inline constexpr output_field_t output_fields[] = {
+    {"ta", fld::t, false},        {"hus", idx::lqv, false},
+    {"clw", idx::lqc, false},     {"cli", idx::lqi, false},
+    {"qr", idx::lqr, false},      {"qs", idx::lqs, false},
+    {"qg", idx::lqg, false},      {"pflx", fld::pflx, false},
+    {"prr_gsp", idx::lqr, true},  {"prs_gsp", idx::lqs, true},
+    {"pri_gsp", idx::lqi, true},  {"prg_gsp", idx::lqg, true},
+    {"pre_gsp", fld::pre, true}};
+
+constexpr size_t n_output = std::size(output_fields);
+
+/* the output fields of a block of cells in the order of output_fields,
+ * [nlev][ncells] or [ncells] for the surface fields */
+using output_view_t = std::array<const real_t *, n_output>;
+
+/* the output fields of the state */
+output_view_t output_view(const State &state);
+
+/**
+ * @brief Copy of the output fields of a state
+ *
+ * Holds the 8 three-dimensional and 5 surface fields that are written, one
+ * after the other in the order of output_fields, without the inputs p, rho
+ * and dz of the state tensor.
+ */
+class output_state_t {
+public:
+  size_t ncells = 0;
+  size_t nlev = 0;
+
+  void allocate(size_t ncells, size_t nlev);
+  /* allocates and copies the output fields of the state */
+  void assign(const State &state);
+
+  /* the f-th field of output_fields */
+  real_t *field(size_t f) { return values.data() + offset(f); }
+  output_view_t view() const;
+
+private:
+  size_t offset(size_t f) const;
+  array_1d_t<real_t> values;
+};
+
+/* a variable of the input files: name, state slot, time dimension */
+struct input_field_t {
+  const char *name;
+  size_t slot;
+  bool timed;
+};
+
+/* zg is replaced by the layer thickness dz after reading */
+inline constexpr input_field_t input_fields[] = {
+    {"zg", fld::dz, false},   {"ta", fld::t, true},    {"pfull", fld::p, true},
+    {"rho", fld::rho, true},  {"hus", idx::lqv, true}, {"clw", idx::lqc, true},
+    {"cli", idx::lqi, true},  {"qr", idx::lqr, true},  {"qs", idx::lqs, true},
+    {"qg", idx::lqg, true}};
+
+/* output.nc -> output_0004.nc for the snapshot after step 4 */
+string step_file_name(const string &output_file, size_t step);
+
+/* removes the --key=value options from argv, leaving the positional ones */
+options_t parse_options(int &argc, char **argv, bool verbose = true);
+
 void parse_args(std::string &file, string &outfile, size_t &itime, real_t &dt, real_t &qnc,
                 int argc, char **argv);
 
-void input_vector(NcFile &datafile, array_1d_t<real_t> &v,
-                  const std::string input, size_t &ncells, size_t &nlev,
-                  size_t itime);
-void input_vector(NcFile &datafile, array_1d_t<real_t> &v,
-                  const std::string input, size_t &ncells, size_t &nlev);
+void input_vector(NcFile &datafile, real_t *v, const std::string input,
+                  size_t &ncells, size_t &nlev, size_t itime);
+void input_vector(NcFile &datafile, real_t *v, const std::string input,
+                  size_t &ncells, size_t &nlev);
 
 void output_vector(NcFile &datafile, array_1d_t<NcDim> &dims,
-                   const std::string output, array_1d_t<real_t> &v,
-                   size_t &ncells, size_t &nlev, int &deflate_level);
+                   const std::string output, const real_t *v, size_t &ncells,
+                   size_t &nlev, const options_t &options);
 void output_vector(NcFile &datafile, array_1d_t<NcDim> &dims,
                    const std::string output, std::map<std::string, NcVarAtt>,
-                   array_1d_t<real_t> &v, size_t &ncells, size_t &nlev,
-                   int &deflate_level);
+                   const real_t *v, size_t &ncells, size_t &nlev,
+                   const options_t &options);
 
+/* allocates the state tensor and reads all input fields into its slices */
 void read_fields(const std::string input_file, size_t &itime, size_t &ncells,
-                 size_t &nlev, array_1d_t<real_t> &z, array_1d_t<real_t> &t,
-                 array_1d_t<real_t> &p, array_1d_t<real_t> &rho,
-                 array_1d_t<real_t> &qv, array_1d_t<real_t> &qc,
-                 array_1d_t<real_t> &qi, array_1d_t<real_t> &qr,
-                 array_1d_t<real_t> &qs, array_1d_t<real_t> &qg);
+                 size_t &nlev, State &state);
 
 void write_fields(const string output_file, size_t &ncells, size_t &nlev,
-                  array_1d_t<real_t> &t, array_1d_t<real_t> &qv,
-                  array_1d_t<real_t> &qc, array_1d_t<real_t> &qi,
-                  array_1d_t<real_t> &qr, array_1d_t<real_t> &qs,
-                  array_1d_t<real_t> &qg, array_1d_t<real_t> &prr_gsp,
-                  array_1d_t<real_t> &pri_gsp, array_1d_t<real_t> &prs_gsp,
-                  array_1d_t<real_t> &prg_gsp, array_1d_t<real_t> &pre_gsp,
-                  array_1d_t<real_t> &pflx);
+                  const State &state, const options_t &options = options_t());
+void write_fields(const string output_file, size_t ncells, size_t nlev,
+                  const output_view_t &fields,
+                  const options_t &options = options_t());
 void write_fields(const string output_file, const string input_file,
-                  size_t &ncells, size_t &nlev, array_1d_t<real_t> &t,
-                  array_1d_t<real_t> &qv, array_1d_t<real_t> &qc,
-                  array_1d_t<real_t> &qi, array_1d_t<real_t> &qr,
-                  array_1d_t<real_t> &qs, array_1d_t<real_t> &qg,
-                  array_1d_t<real_t> &prr_gsp, array_1d_t<real_t> &pri_gsp,
-                  array_1d_t<real_t> &prs_gsp, array_1d_t<real_t> &prg_gsp,
-                  array_1d_t<real_t> &pre_gsp, array_1d_t<real_t> &pflx);
+                  size_t &ncells, size_t &nlev, const State &state,
+                  const options_t &options = options_t());
 } // namespace io_muphys
 
 #ifdef USE_MPI
@@ -92,32 +218,84 @@ namespace io_muphys {
   #endif
   void parse_args_mpi_rank0(string &file, string &outfile, size_t &itime, real_t &dt, real_t &qnc, int argc, char **argv);
   void parse_args_mpi(string &file, string &outfile, size_t &itime, real_t &dt, real_t &qnc, int argc, char **argv);
+  // Wall time of the phases of a parallel read or write on this rank.
+  struct io_timing_t {
+    double open = 0.0;  // open or create, definitions
+    double data = 0.0;  // get/put of the local blocks
+    double close = 0.0; // close, flushes the remaining buffers
+  };
+  // Min, mean and max of every phase over comm, printed on rank 0.
+  void report_io_timing(const char *label, const io_timing_t &timing,
+                        MPI_Comm comm = MPI_COMM_WORLD);
+
+  // MPI_Info holding the --mpi-hint options, free with MPI_Info_free.
+  MPI_Info make_mpi_info(const options_t &options);
+  // Throws for options the parallel backend cannot honour, e.g. --deflate
+  // with MU_PNETCDF, so that the run fails before it starts.
+  void check_options_mpi(const options_t &options);
+
+  // Offset (ns) of the steady clock of rank 0 against the one of this rank,
+  // from the round trip with the smallest latency of a few ping-pongs.
+  std::int64_t clock_offset_mpi(MPI_Comm comm = MPI_COMM_WORLD);
+  // Trace events of all ranks of comm in one Chrome Trace Event file written
+  // by rank 0, one process per rank on the clock of rank 0.
+  void write_trace_mpi(const std::string &file, MPI_Comm comm = MPI_COMM_WORLD);
+
   // Read a vector variable (level and cell dimensions) at given time index.
-  void input_vector_mpi(const std::string &filename, array_1d_t<real_t> &v,
-                        const std::string &var_name, size_t ncells,
-                        size_t nlev, size_t itime, MPI_Comm comm, MPI_Info info);
-  
-  // Read all fields (wrapper for multiple input_vector_mpi calls).
+  void input_vector_mpi(int ncid, const char *name, size_t itime,
+                        size_t start_cell, size_t ncell_loc, size_t nlev,
+                        real_t *arr, int par_access = NC_INDEPENDENT);
+  // Read a static vector variable (level and cell dimensions).
+  void input_vector_mpi(int ncid, const char *name, size_t start_cell,
+                        size_t ncell_loc, size_t nlev, real_t *arr,
+                        int par_access = NC_INDEPENDENT);
+
+  // Open the input on all ranks of comm and close it again; the id is one of
+  // the NetCDF-4 or, with MU_PNETCDF, of the PnetCDF backend.
+  int open_input_mpi(const string &input_file, MPI_Comm comm, MPI_Info info);
+  void close_input_mpi(int ncid);
+  // Level and cell dimensions of the input file, from zg.
+  void input_dims_mpi(int ncid, size_t &ncells, size_t &nlev);
+  // Read the input fields of several cell blocks into their states, which
+  // are allocated; with collective access the ranks of comm may pass
+  // different numbers of blocks.
+  void input_blocks_mpi(int ncid, size_t itime, size_t nlev,
+                        const std::vector<State *> &states,
+                        const std::vector<cell_block_t> &blocks,
+                        int par_access, MPI_Comm comm);
+
+  // Read all fields of the local block of the even split of the cells over
+  // comm into the state tensor.
   void read_fields_mpi(const string input_file, size_t &itime,
-                        size_t &ncells, size_t &nlev, array_1d_t<real_t> &z,
-                        array_1d_t<real_t> &t, array_1d_t<real_t> &p,
-                        array_1d_t<real_t> &rho, array_1d_t<real_t> &qv,
-                        array_1d_t<real_t> &qc, array_1d_t<real_t> &qi,
-                        array_1d_t<real_t> &qr, array_1d_t<real_t> &qs,
-                        array_1d_t<real_t> &qg, MPI_Comm comm = MPI_COMM_WORLD, MPI_Info info = MPI_INFO_NULL);
+                        size_t &ncells, size_t &nlev, State &state,
+                        MPI_Comm comm = MPI_COMM_WORLD, MPI_Info info = MPI_INFO_NULL,
+                        const options_t &options = options_t(),
+                        io_timing_t *timing = nullptr);
 
-  void output_vector_par(int ncid, int varid, size_t itime, size_t start_cell, size_t ncell_loc, size_t nlev, const array_1d_t<real_t>& arr);
+  // Read the cell centres clon and clat of all cells on every rank of comm.
+  void read_cell_coordinates_mpi(const string input_file,
+                                 std::vector<double> &clon,
+                                 std::vector<double> &clat,
+                                 MPI_Comm comm = MPI_COMM_WORLD,
+                                 MPI_Info info = MPI_INFO_NULL);
 
-  void output_vector_par(int ncid, int varid, size_t start_cell, size_t ncell_loc, size_t nlev, const array_1d_t<real_t>& arr);
+  void output_vector_par(int ncid, int varid, size_t itime, size_t start_cell, size_t ncell_loc, size_t nlev, const real_t *arr);
 
+  void output_vector_par(int ncid, int varid, size_t start_cell, size_t ncell_loc, size_t nlev, const real_t *arr);
+
+  // Write the local cell block of the state; the block defaults to the even
+  // split of the cells over comm.
+  void write_fields_mpi(const std::string &output_file, size_t ncells, size_t nlev,
+                        const State &state, const options_t &options = options_t(),
+                        MPI_Comm comm = MPI_COMM_WORLD, MPI_Info info = MPI_INFO_NULL,
+                        io_timing_t *timing = nullptr,
+                        const cell_block_t *block = nullptr);
+  // Write several cell blocks, each from the output fields of its own
+  // state, into one file.
   void write_fields_mpi(const std::string &output_file, size_t ncells, size_t nlev,
-                        const array_1d_t<real_t> &t, const array_1d_t<real_t> &qv,
-                        const array_1d_t<real_t> &qc, const array_1d_t<real_t> &qi,
-                        const array_1d_t<real_t> &qr, const array_1d_t<real_t> &qs,
-                        const array_1d_t<real_t> &qg, const array_1d_t<real_t> &prr_gsp,
-                        const array_1d_t<real_t> &pri_gsp, const array_1d_t<real_t> &prs_gsp,
-                        const array_1d_t<real_t> &prg_gsp, const array_1d_t<real_t> &pre_gsp,
-                        const array_1d_t<real_t> &pflx, int deflate_level = 0,
-                        MPI_Comm comm = MPI_COMM_WORLD, MPI_Info info = MPI_INFO_NULL);
+                        const std::vector<output_view_t> &fields,
+                        const std::vector<cell_block_t> &blocks,
+                        const options_t &options, MPI_Comm comm, MPI_Info info,
+                        io_timing_t *timing = nullptr);
 } // namespace io_muphys
 #endif
\ No newline at end of file
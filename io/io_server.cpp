@@ -0,0 +1,199 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "io_server.hpp"
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+static const int OUTPUT_TAG = 4711;
+
+/* levels of the output fields, the rows of ncell_loc values of a message */
+static size_t packed_rows(size_t nlev) {
+  size_t n = 0;
+  for (const auto &field : io_muphys::output_fields)
+    n += field.surface ? 1 : nlev;
+  return n;
+}
+
+/* one row of a message as one MPI element, so that the count of a message
+ * is its rows and stays small for any block */
+static MPI_Datatype row_type(size_t ncell_loc) {
+  if (ncell_loc > INT_MAX)
+    throw std::runtime_error("output block exceeds the MPI count range");
+  MPI_Datatype row;
+  MPI_Type_contiguous(static_cast<int>(ncell_loc), MPI_REAL_T, &row);
+  MPI_Type_commit(&row);
+  return row;
+}
+
+int io_muphys::io_layout_t::server_of(int compute_rank) const {
+  int server = nio - 1;
+  while (server > 0 && first_client(server) > compute_rank)
+    --server;
+  return server;
+}
+
+io_muphys::io_layout_t io_muphys::split_io_ranks(int io_tasks,
+                                                 MPI_Comm world) {
+  int rank, nprocs;
+  MPI_Comm_rank(world, &rank);
+  MPI_Comm_size(world, &nprocs);
+  if (io_tasks < 0 || io_tasks >= nprocs)
+    throw std::invalid_argument("--io-tasks must leave at least one compute "
+                                "rank");
+
+  io_layout_t layout;
+  layout.world = world;
+  layout.nio = io_tasks;
+  layout.ncompute = nprocs - io_tasks;
+  layout.is_io = rank >= layout.ncompute;
+  MPI_Comm_split(world, layout.is_io ? 1 : 0, rank, &layout.local);
+  return layout;
+}
+
+io_muphys::io_client::io_client(const io_layout_t &layout, size_t ncell_loc,
+                                 size_t nlev)
+    : layout(layout), ncell_loc(ncell_loc), nlev(nlev) {
+  resize(ncell_loc);
+}
+
+void io_muphys::io_client::resize(size_t ncell_loc_) {
+  finish();
+  ncell_loc = ncell_loc_;
+  const size_t n = packed_rows(nlev) * ncell_loc;
+  buffers[0].resize(n);
+  buffers[1].resize(n);
+  if (row != MPI_DATATYPE_NULL)
+    MPI_Type_free(&row);
+  row = row_type(ncell_loc);
+}
+
+io_muphys::io_client::~io_client() {
+  finish();
+  if (row != MPI_DATATYPE_NULL)
+    MPI_Type_free(&row);
+}
+
+void io_muphys::io_client::send(const State &state) {
+  MU_TRACE_SCOPE("send");
+  const double t0 = MPI_Wtime();
+  {
+    MU_TRACE_SCOPE("send_wait");
+    MPI_Wait(&requests[next], MPI_STATUS_IGNORE);
+  }
+  wait_time += MPI_Wtime() - t0;
+
+  real_t *p = buffers[next].data();
+  for (const auto &field : output_fields) {
+    const size_t n = (field.surface ? 1 : nlev) * ncell_loc;
+    const real_t *src =
+        field.surface ? state.surface(field.slot) : state.field(field.slot);
+    std::memcpy(p, src, n * sizeof(real_t));
+    p += n;
+  }
+
+  int rank;
+  MPI_Comm_rank(layout.local, &rank);
+  const int server = layout.world_rank_of_server(layout.server_of(rank));
+  MPI_Isend(buffers[next].data(), static_cast<int>(packed_rows(nlev)), row,
+            server, OUTPUT_TAG, layout.world, &requests[next]);
+  next = 1 - next;
+}
+
+void io_muphys::io_client::finish() {
+  MU_TRACE_SCOPE("send_wait");
+  const double t0 = MPI_Wtime();
+  MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+  wait_time += MPI_Wtime() - t0;
+}
+
+io_muphys::io_server::io_server(const io_layout_t &layout,
+                                const std::vector<cell_block_t> &blocks,
+                                size_t ncells, size_t nlev)
+    : layout(layout), ncells(ncells), nlev(nlev) {
+  set_blocks(blocks);
+}
+
+void io_muphys::io_server::set_blocks(
+    const std::vector<cell_block_t> &blocks) {
+  int rank;
+  MPI_Comm_rank(layout.local, &rank);
+  const int first = layout.first_client(rank);
+  const int last = rank + 1 < layout.nio ? layout.first_client(rank + 1)
+                                         : layout.ncompute;
+  client_blocks.assign(blocks.begin() + first, blocks.begin() + last);
+
+  block.start = client_blocks.empty() ? 0 : client_blocks.front().start;
+  block.count = 0;
+  for (const auto &b : client_blocks) {
+    if (b.start != block.start + block.count)
+      throw std::runtime_error("io_server: client blocks are not contiguous");
+    block.count += b.count;
+  }
+
+  aggregate.allocate(block.count, nlev);
+  buffers.clear();
+  for (const auto &b : client_blocks)
+    buffers.emplace_back(packed_rows(nlev) * b.count);
+  free_rows();
+  for (const auto &b : client_blocks)
+    rows.push_back(row_type(b.count));
+}
+
+void io_muphys::io_server::free_rows() {
+  for (MPI_Datatype &row : rows)
+    MPI_Type_free(&row);
+  rows.clear();
+}
+
+void io_muphys::io_server::write(const std::string &output_file,
+                                 const options_t &options, MPI_Info info) {
+  MU_TRACE_SCOPE("server_write");
+  int rank;
+  MPI_Comm_rank(layout.local, &rank);
+  const int first = layout.first_client(rank);
+
+  const double t0 = MPI_Wtime();
+  std::vector<MPI_Request> requests(client_blocks.size());
+  for (size_t c = 0; c < client_blocks.size(); ++c)
+    MPI_Irecv(buffers[c].data(), static_cast<int>(packed_rows(nlev)), rows[c],
+              first + static_cast<int>(c), OUTPUT_TAG, layout.world,
+              &requests[c]);
+  {
+    MU_TRACE_SCOPE("receive");
+    MPI_Waitall(static_cast<int>(requests.size()), requests.data(),
+                MPI_STATUSES_IGNORE);
+  }
+
+  // scatter each client block into its columns of the aggregate block
+  for (size_t c = 0; c < client_blocks.size(); ++c) {
+    const size_t count = client_blocks[c].count;
+    const size_t offset = client_blocks[c].start - block.start;
+    const real_t *p = buffers[c].data();
+    for (size_t f = 0; f < n_output; ++f) {
+      const size_t levels = output_fields[f].surface ? 1 : nlev;
+      real_t *dst = aggregate.field(f);
+      for (size_t k = 0; k < levels; ++k)
+        std::memcpy(dst + k * block.count + offset, p + k * count,
+                    count * sizeof(real_t));
+      p += levels * count;
+    }
+  }
+  receive_time += MPI_Wtime() - t0;
+
+  io_timing_t t;
+  write_fields_mpi(output_file, ncells, nlev, {aggregate.view()}, {block},
+                   options, layout.local, info, &t);
+  write_timing.open += t.open;
+  write_timing.data += t.data;
+  write_timing.close += t.close;
+}
@@ -0,0 +1,111 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include "io.hpp"
+#include <mpi.h>
+
+namespace io_muphys {
+
+/**
+ * @brief Split of MPI_COMM_WORLD into compute and I/O ranks
+ *
+ * The last io_tasks ranks serve I/O, as laid out by run_wrapper_levante.sh.
+ * I/O rank i aggregates the consecutive compute ranks
+ * [first_client(i), first_client(i + 1)).
+ */
+struct io_layout_t {
+  MPI_Comm world = MPI_COMM_WORLD;
+  MPI_Comm local = MPI_COMM_NULL; // compute or I/O communicator
+  bool is_io = false;
+  int ncompute = 0, nio = 0;
+
+  int first_client(int io_rank) const {
+    return static_cast<int>(static_cast<long>(io_rank) * ncompute / nio);
+  }
+  int server_of(int compute_rank) const;
+  int world_rank_of_server(int io_rank) const { return ncompute + io_rank; }
+};
+
+io_layout_t split_io_ranks(int io_tasks, MPI_Comm world = MPI_COMM_WORLD);
+
+/**
+ * @brief Compute side: ships the output fields of the local block to its
+ * I/O rank with non-blocking sends
+ *
+ * The fields are packed into one of two buffers, so that a send may still
+ * be in flight while the next step computes; send() only waits for the
+ * send issued two outputs earlier.
+ */
+class io_client {
+public:
+  io_client(const io_layout_t &layout, size_t ncell_loc, size_t nlev);
+  ~io_client();
+
+  io_client(const io_client &) = delete;
+  io_client &operator=(const io_client &) = delete;
+
+  void send(const State &state);
+  void finish();
+  /* new local block size after a migration, waits for the pending sends */
+  void resize(size_t ncell_loc);
+
+  /* time blocked waiting for earlier sends to complete */
+  double wait_seconds() const { return wait_time; }
+
+private:
+  const io_layout_t &layout;
+  size_t ncell_loc, nlev;
+  array_1d_t<real_t> buffers[2];
+  MPI_Datatype row = MPI_DATATYPE_NULL; // ncell_loc values
+  MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+  int next = 0;
+  double wait_time = 0.0;
+};
+
+/**
+ * @brief I/O side: receives the blocks of its compute ranks and writes
+ * them as one contiguous block per variable with the other I/O ranks
+ */
+class io_server {
+public:
+  /* blocks: the cell block of every compute rank */
+  io_server(const io_layout_t &layout, const std::vector<cell_block_t> &blocks,
+            size_t ncells, size_t nlev);
+  ~io_server() { free_rows(); }
+
+  io_server(const io_server &) = delete;
+  io_server &operator=(const io_server &) = delete;
+
+  /* new blocks of the compute ranks after a migration */
+  void set_blocks(const std::vector<cell_block_t> &blocks);
+
+  void write(const std::string &output_file, const options_t &options,
+             MPI_Info info);
+
+  /* accumulated over all writes */
+  double receive_seconds() const { return receive_time; }
+  const io_timing_t &timing() const { return write_timing; }
+
+private:
+  const io_layout_t &layout;
+  std::vector<cell_block_t> client_blocks;
+  cell_block_t block; // union of the client blocks
+  size_t ncells, nlev;
+  output_state_t aggregate; // only the fields that are written
+  std::vector<array_1d_t<real_t>> buffers;
+  std::vector<MPI_Datatype> rows; // row of every client block
+  void free_rows();
+  double receive_time = 0.0;
+  io_timing_t write_timing;
+};
+
+} // namespace io_muphys
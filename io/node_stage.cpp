@@ -0,0 +1,196 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "node_stage.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+/* values of the state tensor of a block */
+static size_t tensor_size(size_t ncells, size_t nlev) {
+  return (fld::n3d * nlev + fld::n2d) * ncells;
+}
+
+io_muphys::node_stage::node_stage(MPI_Comm comm_) : comm(comm_) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+  MPI_Comm_rank(node, &node_rank);
+  MPI_Comm_size(node, &node_size);
+  MPI_Comm_split(comm, node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &leaders);
+}
+
+io_muphys::node_stage::~node_stage() {
+  release(state_window);
+  release(output_window);
+  if (leaders != MPI_COMM_NULL)
+    MPI_Comm_free(&leaders);
+  MPI_Comm_free(&node);
+}
+
+io_muphys::node_stage::window_t io_muphys::node_stage::allocate(size_t size) {
+  // every slice is placed on its own pages, first touched by its rank
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "alloc_shared_noncontig", "true");
+  window_t window;
+  window.size = size;
+  MPI_Win_allocate_shared(static_cast<MPI_Aint>(size * sizeof(real_t)),
+                          sizeof(real_t), info, node, &window.base,
+                          &window.win);
+  MPI_Info_free(&info);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, window.win);
+  std::fill(window.base, window.base + size, ZERO);
+  return window;
+}
+
+void io_muphys::node_stage::release(window_t &window) {
+  if (window.win == MPI_WIN_NULL)
+    return;
+  MPI_Win_unlock_all(window.win);
+  MPI_Win_free(&window.win);
+  window = window_t();
+}
+
+void io_muphys::node_stage::sync(const window_t &window) {
+  MPI_Win_sync(window.win);
+  MPI_Barrier(node);
+  MPI_Win_sync(window.win);
+}
+
+std::vector<State>
+io_muphys::node_stage::views(const window_t &window,
+                             const std::vector<cell_block_t> &blocks,
+                             size_t nlev) {
+  std::vector<State> states(node_size);
+  for (int r = 0; r < node_size; ++r) {
+    MPI_Aint size;
+    int disp_unit;
+    real_t *base;
+    MPI_Win_shared_query(window.win, r, &size, &disp_unit, &base);
+    if (static_cast<size_t>(size) < tensor_size(blocks[r].count, nlev) * sizeof(real_t))
+      throw std::runtime_error("node_stage: window slice too small");
+    states[r].bind(base, blocks[r].count, nlev);
+  }
+  return states;
+}
+
+std::vector<io_muphys::cell_block_t>
+io_muphys::node_stage::gather_blocks(const cell_block_t &block) {
+  const uint64_t local[2] = {block.start, block.count};
+  std::vector<uint64_t> all(leader() ? 2 * node_size : 0);
+  MPI_Gather(local, 2, MPI_UINT64_T, all.data(), 2, MPI_UINT64_T, 0, node);
+  std::vector<cell_block_t> blocks(all.size() / 2);
+  for (size_t r = 0; r < blocks.size(); ++r)
+    blocks[r] = {all[2 * r], all[2 * r + 1]};
+  return blocks;
+}
+
+void io_muphys::node_stage::read(const std::string &input_file, size_t itime,
+                                 size_t &ncells, size_t &nlev, State &state,
+                                 MPI_Info info, const options_t &options,
+                                 io_timing_t *timing) {
+  MU_TRACE_SCOPE("node_stage_read");
+  const int par_access =
+      options.collective_io ? NC_COLLECTIVE : NC_INDEPENDENT;
+  io_timing_t t;
+  double t0 = MPI_Wtime();
+
+  int ncid = -1;
+  uint64_t dims[2] = {0, 0};
+  if (leader()) {
+    ncid = io_muphys::open_input_mpi(input_file, leaders, info);
+    size_t n, l;
+    io_muphys::input_dims_mpi(ncid, n, l);
+    dims[0] = n;
+    dims[1] = l;
+  }
+  MPI_Bcast(dims, 2, MPI_UINT64_T, 0, node);
+  ncells = dims[0];
+  nlev = dims[1];
+
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+  const cell_block_t block = even_block(ncells, rank, nprocs);
+  release(state_window);
+  state_window = allocate(tensor_size(block.count, nlev));
+  state.bind(state_window.base, block.count, nlev);
+  const std::vector<cell_block_t> blocks = gather_blocks(block);
+  sync(state_window);
+  t.open = MPI_Wtime() - t0;
+
+  if (leader()) {
+    t0 = MPI_Wtime();
+    std::vector<State> slices = views(state_window, blocks, nlev);
+    std::vector<State *> states;
+    for (auto &slice : slices)
+      states.push_back(&slice);
+    io_muphys::input_blocks_mpi(ncid, itime, nlev, states, blocks, par_access,
+                                leaders);
+    t.data = MPI_Wtime() - t0;
+    t0 = MPI_Wtime();
+    io_muphys::close_input_mpi(ncid);
+    t.close = MPI_Wtime() - t0;
+  }
+  sync(state_window);
+  if (timing)
+    *timing = t;
+}
+
+void io_muphys::node_stage::bind(State &state) {
+  window_t window = allocate(state.size());
+  std::memcpy(window.base, state.data(), state.size() * sizeof(real_t));
+  state.bind(window.base, state.ncells, state.nlev);
+  release(state_window);
+  state_window = window;
+}
+
+void io_muphys::node_stage::write(const std::string &output_file,
+                                  size_t ncells, size_t nlev,
+                                  const State &state,
+                                  const cell_block_t &block,
+                                  const options_t &options, MPI_Info info,
+                                  io_timing_t *timing) {
+  MU_TRACE_SCOPE("node_stage_write");
+  // all ranks of the node write from the same window
+  int in_window = state.data() == state_window.base &&
+                  state.size() <= state_window.size;
+  MPI_Allreduce(MPI_IN_PLACE, &in_window, 1, MPI_INT, MPI_LAND, node);
+  const window_t *window = &state_window;
+  if (!in_window) {
+    int grow = state.size() > output_window.size;
+    MPI_Allreduce(MPI_IN_PLACE, &grow, 1, MPI_INT, MPI_LOR, node);
+    if (grow) {
+      release(output_window);
+      output_window = allocate(state.size());
+    }
+    std::memcpy(output_window.base, state.data(),
+                state.size() * sizeof(real_t));
+    window = &output_window;
+  }
+  const std::vector<cell_block_t> blocks = gather_blocks(block);
+  sync(*window);
+
+  if (leader()) {
+    const std::vector<State> slices = views(*window, blocks, nlev);
+    std::vector<output_view_t> fields;
+    for (const auto &slice : slices)
+      fields.push_back(output_view(slice));
+    io_muphys::write_fields_mpi(output_file, ncells, nlev, fields, blocks,
+                                options, leaders, info, timing);
+  }
+  else if (timing) {
+    *timing = io_timing_t();
+  }
+  // the ranks may change their slices again
+  sync(*window);
+}
@@ -0,0 +1,77 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include "io.hpp"
+#include <mpi.h>
+
+namespace io_muphys {
+
+/**
+ * @brief Node-level staging of the input and output in MPI shared memory
+ *
+ * Only the first rank of every node opens the files. It reads the cell
+ * blocks of all ranks of its node directly into their slices of an
+ * MPI_Win_allocate_shared window, and every rank binds its state to its
+ * slice without a copy. Writes go the same way in reverse. This replaces
+ * one parallel open per rank by one per node.
+ */
+class node_stage {
+public:
+  /* comm: the ranks that read and write, grouped by shared memory */
+  explicit node_stage(MPI_Comm comm);
+  ~node_stage();
+
+  node_stage(const node_stage &) = delete;
+  node_stage &operator=(const node_stage &) = delete;
+
+  /* reads the even block of this rank of comm, state is bound to the
+   * window afterwards */
+  void read(const std::string &input_file, size_t itime, size_t &ncells,
+            size_t &nlev, State &state, MPI_Info info,
+            const options_t &options, io_timing_t *timing = nullptr);
+
+  /* moves a state that left the window, e.g. after a migration, into a new
+   * slice of the window; collective over comm */
+  void bind(State &state);
+
+  /* writes the block of every rank of comm; a state outside the window is
+   * copied into an output window first */
+  void write(const std::string &output_file, size_t ncells, size_t nlev,
+             const State &state, const cell_block_t &block,
+             const options_t &options, MPI_Info info,
+             io_timing_t *timing = nullptr);
+
+  bool leader() const { return node_rank == 0; }
+
+private:
+  struct window_t {
+    MPI_Win win = MPI_WIN_NULL;
+    real_t *base = nullptr;
+    size_t size = 0;
+  };
+  window_t allocate(size_t size);
+  void release(window_t &window);
+  void sync(const window_t &window);
+  /* states bound to the slices of all node ranks, on the leader */
+  std::vector<State> views(const window_t &window,
+                           const std::vector<cell_block_t> &blocks,
+                           size_t nlev);
+  std::vector<cell_block_t> gather_blocks(const cell_block_t &block);
+
+  MPI_Comm comm = MPI_COMM_NULL;
+  MPI_Comm node = MPI_COMM_NULL;    // ranks sharing memory
+  MPI_Comm leaders = MPI_COMM_NULL; // first rank of every node, else null
+  int node_rank = 0, node_size = 1;
+  window_t state_window, output_window;
+};
+
+} // namespace io_muphys
@@ -0,0 +1,72 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include "../core/common/trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace io_muphys {
+
+/* number of I/O worker threads, MU_IO_THREADS or all hardware threads the
+ * process may run on */
+inline unsigned io_threads() {
+  if (const char *env = std::getenv("MU_IO_THREADS")) {
+    int n = std::atoi(env);
+    if (n > 0)
+      return static_cast<unsigned>(n);
+  }
+#ifdef __linux__
+  cpu_set_t mask;
+  if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+    return std::max(1, CPU_COUNT(&mask));
+#endif
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * @brief Calls f(i) for i in [0, n) on up to nthreads threads
+ *
+ * Items are handed out one at a time, since the cost of (de)compressing a
+ * chunk varies. f must not throw.
+ */
+template <typename F> void parallel_for(size_t n, unsigned nthreads, F f) {
+  nthreads = static_cast<unsigned>(std::min<size_t>(nthreads, n));
+  if (nthreads <= 1) {
+    for (size_t i = 0; i < n; ++i)
+      f(i);
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  auto work = [&] {
+    MU_TRACE_SCOPE("io_worker");
+    for (size_t i = next++; i < n; i = next++)
+      f(i);
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < nthreads; ++t)
+    pool.emplace_back([&] {
+      MU_TRACE_THREAD("io worker");
+      work();
+    });
+  work();
+  for (auto &thread : pool)
+    thread.join();
+}
+
+} // namespace io_muphys
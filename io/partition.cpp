@@ -0,0 +1,332 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "partition.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+/* common cells of two blocks */
+static io_muphys::cell_block_t overlap(const io_muphys::cell_block_t &a,
+                                       const io_muphys::cell_block_t &b) {
+  const size_t start = std::max(a.start, b.start);
+  const size_t end = std::min(a.start + a.count, b.start + b.count);
+  return {start, end > start ? end - start : 0};
+}
+
+static int mpi_count(size_t n) {
+  if (n > INT_MAX)
+    throw std::runtime_error("cell migration exceeds the MPI count range");
+  return static_cast<int>(n);
+}
+
+/* all rows of one cell as one MPI element, so that the counts and
+ * displacements of the exchanges are cells rather than values */
+static MPI_Datatype column_type(size_t rows) {
+  MPI_Datatype column;
+  MPI_Type_contiguous(mpi_count(rows), MPI_REAL_T, &column);
+  MPI_Type_commit(&column);
+  return column;
+}
+
+std::vector<std::uint64_t> io_muphys::block_starts(const double *cost,
+                                                   size_t ncells, double offset,
+                                                   double total,
+                                                   size_t nblocks) {
+  std::vector<double> prefix(ncells + 1, 0.0);
+  for (size_t i = 0; i < ncells; ++i)
+    prefix[i + 1] = prefix[i] + cost[i];
+
+  // cells before the boundary of block b: midpoint of the cost below
+  // b * total / nblocks
+  std::vector<std::uint64_t> starts(nblocks, 0);
+  for (size_t b = 1; b < nblocks; ++b) {
+    const double bound = b * total / nblocks;
+    size_t lo = 0, hi = ncells;
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (offset + prefix[mid] + 0.5 * cost[mid] < bound)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    starts[b] = lo;
+  }
+  return starts;
+}
+
+std::vector<io_muphys::cell_block_t>
+io_muphys::balanced_blocks(const double *cost, size_t ncell_loc,
+                           size_t ncells, MPI_Comm comm) {
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+
+  // global exclusive prefix sum of the cost
+  double local = 0.0, offset = 0.0, total = 0.0;
+  for (size_t i = 0; i < ncell_loc; ++i)
+    local += cost[i];
+  MPI_Exscan(&local, &offset, 1, MPI_DOUBLE, MPI_SUM, comm);
+  if (rank == 0)
+    offset = 0.0; // undefined on the first rank
+  MPI_Allreduce(&local, &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+
+  // the local cells before every boundary, summed over the ranks
+  std::vector<uint64_t> starts =
+      block_starts(cost, ncell_loc, offset, total, nprocs);
+  MPI_Allreduce(MPI_IN_PLACE, starts.data(), nprocs, MPI_UINT64_T, MPI_SUM,
+                comm);
+  starts.push_back(ncells);
+
+  std::vector<cell_block_t> blocks(nprocs);
+  for (int r = 0; r < nprocs; ++r)
+    blocks[r] = {starts[r], starts[r + 1] - starts[r]};
+  return blocks;
+}
+
+std::vector<io_muphys::cell_block_t>
+io_muphys::balanced_blocks(const std::uint32_t *active, size_t ncell_loc,
+                           size_t ncells, MPI_Comm comm) {
+  std::vector<double> cost(ncell_loc);
+  for (size_t i = 0; i < ncell_loc; ++i)
+    cost[i] = 1.0 + active[i];
+  return balanced_blocks(cost.data(), ncell_loc, ncells, comm);
+}
+
+double io_muphys::cost_imbalance(const std::uint32_t *active,
+                                 size_t ncell_loc, MPI_Comm comm) {
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+  double cost = 0.0, cost_max, cost_sum;
+  for (size_t i = 0; i < ncell_loc; ++i)
+    cost += 1.0 + active[i];
+  MPI_Allreduce(&cost, &cost_max, 1, MPI_DOUBLE, MPI_MAX, comm);
+  MPI_Allreduce(&cost, &cost_sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+  return cost_sum > 0.0 ? cost_max * nprocs / cost_sum : 1.0;
+}
+
+std::vector<double>
+io_muphys::block_costs(const double *cost, const cell_block_t &local,
+                       const std::vector<cell_block_t> &blocks,
+                       MPI_Comm comm) {
+  std::vector<double> sums(blocks.size(), 0.0);
+  for (size_t r = 0; r < blocks.size(); ++r) {
+    const cell_block_t common = overlap(local, blocks[r]);
+    for (size_t i = 0; i < common.count; ++i)
+      sums[r] += cost[common.start - local.start + i];
+  }
+  MPI_Allreduce(MPI_IN_PLACE, sums.data(), mpi_count(sums.size()),
+                MPI_DOUBLE, MPI_SUM, comm);
+  return sums;
+}
+
+size_t io_muphys::migrate_cells(State &state,
+                                const std::vector<cell_block_t> &from,
+                                const std::vector<cell_block_t> &to,
+                                MPI_Comm comm) {
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+  const cell_block_t &src = from[rank];
+  const cell_block_t &dst = to[rank];
+  const size_t nlev = state.nlev;
+  // the tensor is a [row][cell] matrix: all levels of the 3D fields, then
+  // the surface fields
+  const size_t rows = fld::n3d * nlev + fld::n2d;
+
+  // every destination gets all rows of the cells it shares with src; the
+  // counts are cells, each a [row][cell] segment of the buffers
+  std::vector<int> send_counts(nprocs), send_displs(nprocs);
+  std::vector<int> recv_counts(nprocs), recv_displs(nprocs);
+  size_t nsend = 0, nrecv = 0, moved = 0;
+  for (int r = 0; r < nprocs; ++r) {
+    const size_t out = overlap(src, to[r]).count;
+    const size_t in = overlap(from[r], dst).count;
+    send_displs[r] = mpi_count(nsend);
+    send_counts[r] = mpi_count(out);
+    recv_displs[r] = mpi_count(nrecv);
+    recv_counts[r] = mpi_count(in);
+    nsend += out;
+    nrecv += in;
+    if (r != rank)
+      moved += out;
+  }
+  mpi_count(nsend);
+  mpi_count(nrecv);
+
+  array_1d_t<real_t> send(rows * nsend), recv(rows * nrecv);
+  for (int r = 0; r < nprocs; ++r) {
+    const cell_block_t common = overlap(src, to[r]);
+    real_t *p = send.data() + rows * send_displs[r];
+    for (size_t row = 0; row < rows; ++row)
+      std::memcpy(p + row * common.count,
+                  state.data() + row * src.count + (common.start - src.start),
+                  common.count * sizeof(real_t));
+  }
+
+  MPI_Datatype column = column_type(rows);
+  MPI_Alltoallv(send.data(), send_counts.data(), send_displs.data(), column,
+                recv.data(), recv_counts.data(), recv_displs.data(), column,
+                comm);
+  MPI_Type_free(&column);
+  send = array_1d_t<real_t>();
+
+  State next;
+  next.allocate(dst.count, nlev);
+  for (int r = 0; r < nprocs; ++r) {
+    const cell_block_t common = overlap(from[r], dst);
+    const real_t *p = recv.data() + rows * recv_displs[r];
+    for (size_t row = 0; row < rows; ++row)
+      std::memcpy(next.data() + row * dst.count + (common.start - dst.start),
+                  p + row * common.count, common.count * sizeof(real_t));
+  }
+  state = std::move(next);
+  return moved;
+}
+
+State io_muphys::permute_cells(const State &state,
+                              const std::vector<cell_block_t> &src,
+                              const std::vector<cell_block_t> &dst,
+                              const std::uint64_t *dst_of_src,
+                              const std::uint64_t *src_of_dst, MPI_Comm comm) {
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+  const cell_block_t &mine = src[rank];
+  const cell_block_t &target = dst[rank];
+  const size_t nlev = state.nlev;
+  const size_t rows = fld::n3d * nlev + fld::n2d;
+
+  auto owner = [](const std::vector<cell_block_t> &blocks, size_t cell) {
+    const auto next = std::upper_bound(
+        blocks.begin(), blocks.end(), cell,
+        [](size_t c, const cell_block_t &b) { return c < b.start; });
+    return next - blocks.begin() - 1;
+  };
+  // local columns sent to every rank, in the order of its result columns
+  std::vector<std::vector<size_t>> send_cols(nprocs);
+  {
+    std::vector<std::pair<std::uint64_t, size_t>> by_dst(mine.count);
+    for (size_t c = 0; c < mine.count; ++c)
+      by_dst[c] = {dst_of_src[c], c};
+    std::sort(by_dst.begin(), by_dst.end());
+    for (const auto &[p, c] : by_dst)
+      send_cols[owner(dst, p)].push_back(c);
+  }
+  // local result columns received from every rank, in the same order
+  std::vector<std::vector<size_t>> recv_cols(nprocs);
+  for (size_t c = 0; c < target.count; ++c)
+    recv_cols[owner(src, src_of_dst[c])].push_back(c);
+
+  std::vector<int> send_counts(nprocs), send_displs(nprocs);
+  std::vector<int> recv_counts(nprocs), recv_displs(nprocs);
+  size_t nsend = 0, nrecv = 0;
+  // counts in cells, as in migrate_cells
+  for (int r = 0; r < nprocs; ++r) {
+    send_displs[r] = mpi_count(nsend);
+    send_counts[r] = mpi_count(send_cols[r].size());
+    recv_displs[r] = mpi_count(nrecv);
+    recv_counts[r] = mpi_count(recv_cols[r].size());
+    nsend += send_cols[r].size();
+    nrecv += recv_cols[r].size();
+  }
+  mpi_count(nsend);
+  mpi_count(nrecv);
+
+  array_1d_t<real_t> send(rows * nsend), recv(rows * nrecv);
+  for (int r = 0; r < nprocs; ++r) {
+    real_t *p = send.data() + rows * send_displs[r];
+    for (size_t row = 0; row < rows; ++row) {
+      const real_t *src_row = state.data() + row * mine.count;
+      for (size_t col : send_cols[r])
+        *p++ = src_row[col];
+    }
+  }
+
+  MPI_Datatype column = column_type(rows);
+  MPI_Alltoallv(send.data(), send_counts.data(), send_displs.data(), column,
+                recv.data(), recv_counts.data(), recv_displs.data(), column,
+                comm);
+  MPI_Type_free(&column);
+  send = array_1d_t<real_t>();
+
+  State result;
+  result.allocate(target.count, nlev);
+  for (int r = 0; r < nprocs; ++r) {
+    const real_t *p = recv.data() + rows * recv_displs[r];
+    for (size_t row = 0; row < rows; ++row) {
+      real_t *dst_row = result.data() + row * target.count;
+      for (size_t col : recv_cols[r])
+        dst_row[col] = *p++;
+    }
+  }
+  return result;
+}
+
+std::vector<std::uint64_t>
+io_muphys::scatter_order(const std::vector<std::uint64_t> &order,
+                         const std::vector<cell_block_t> &blocks, int root,
+                         MPI_Comm comm) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  std::vector<int> counts(blocks.size()), displs(blocks.size());
+  for (size_t r = 0; r < blocks.size(); ++r) {
+    counts[r] = mpi_count(blocks[r].count);
+    displs[r] = mpi_count(blocks[r].start);
+  }
+  std::vector<std::uint64_t> slice(blocks[rank].count);
+  MPI_Scatterv(order.data(), counts.data(), displs.data(), MPI_UINT64_T,
+               slice.data(), counts[rank], MPI_UINT64_T, root, comm);
+  return slice;
+}
+
+void io_muphys::migrate_order(std::vector<std::uint64_t> &slice,
+                              const std::vector<cell_block_t> &from,
+                              const std::vector<cell_block_t> &to,
+                              MPI_Comm comm) {
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+  const cell_block_t &src = from[rank];
+  const cell_block_t &dst = to[rank];
+
+  // the common cells are contiguous in both slices, so no packing
+  std::vector<int> send_counts(nprocs), send_displs(nprocs);
+  std::vector<int> recv_counts(nprocs), recv_displs(nprocs);
+  for (int r = 0; r < nprocs; ++r) {
+    const cell_block_t out = overlap(src, to[r]);
+    const cell_block_t in = overlap(from[r], dst);
+    send_counts[r] = mpi_count(out.count);
+    send_displs[r] = out.count ? mpi_count(out.start - src.start) : 0;
+    recv_counts[r] = mpi_count(in.count);
+    recv_displs[r] = in.count ? mpi_count(in.start - dst.start) : 0;
+  }
+  std::vector<std::uint64_t> next(dst.count);
+  MPI_Alltoallv(slice.data(), send_counts.data(), send_displs.data(),
+                MPI_UINT64_T, next.data(), recv_counts.data(),
+                recv_displs.data(), MPI_UINT64_T, comm);
+  slice = std::move(next);
+}
+
+void io_muphys::bcast_blocks(std::vector<cell_block_t> &blocks, int root,
+                             MPI_Comm comm) {
+  std::vector<uint64_t> bounds(2 * blocks.size());
+  for (size_t c = 0; c < blocks.size(); ++c) {
+    bounds[2 * c] = blocks[c].start;
+    bounds[2 * c + 1] = blocks[c].count;
+  }
+  MPI_Bcast(bounds.data(), mpi_count(bounds.size()), MPI_UINT64_T, root,
+            comm);
+  for (size_t c = 0; c < blocks.size(); ++c)
+    blocks[c] = {bounds[2 * c], bounds[2 * c + 1]};
+}
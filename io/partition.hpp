@@ -0,0 +1,126 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include "io.hpp"
+#include <cstdint>
+#include <mpi.h>
+#include <vector>
+
+namespace io_muphys {
+
+/**
+ * @brief Boundaries of contiguous blocks of equal cost within a run of cells
+ *
+ * A cell goes to the block whose share of the total cost holds the
+ * midpoint of the cell's cost. The run is a stretch of the global cell
+ * order whose cost starts at offset; summed over all runs, the counts are
+ * the first cells of the blocks.
+ *
+ * @param [in] cost Cost of the cells of the run
+ * @param [in] ncells Number of cells of the run
+ * @param [in] offset Total cost of the cells before the run
+ * @param [in] total Total cost of all cells
+ * @param [in] nblocks Number of blocks
+ * @return Cells of the run before the start of every block
+ */
+std::vector<std::uint64_t> block_starts(const double *cost, size_t ncells,
+                                        double offset, double total,
+                                        size_t nblocks);
+
+/**
+ * @brief Contiguous cell blocks of equal cost
+ *
+ * The local cells [0, ncell_loc) of every rank of comm are consecutive in
+ * the global cell order. A cell goes to the rank whose share of the total
+ * cost holds the midpoint of the cell's cost.
+ *
+ * @param [in] cost Cost of the local cells
+ * @param [in] ncell_loc Number of local cells
+ * @param [in] ncells Number of cells of all ranks
+ * @param [in] comm Communicator of the ranks that share the cells
+ * @return Block of every rank of comm
+ */
+std::vector<cell_block_t> balanced_blocks(const double *cost,
+                                          size_t ncell_loc, size_t ncells,
+                                          MPI_Comm comm);
+
+/**
+ * @brief Cell blocks of equal microphysics cost
+ *
+ * The cost of a cell is 1 + its number of active levels, so cloud-free
+ * columns still count for the kernel sweeps over all points.
+ */
+std::vector<cell_block_t> balanced_blocks(const std::uint32_t *active,
+                                          size_t ncell_loc, size_t ncells,
+                                          MPI_Comm comm);
+
+/* max over mean of the local cost 1 + active levels, 1 is balanced */
+double cost_imbalance(const std::uint32_t *active, size_t ncell_loc,
+                      MPI_Comm comm);
+
+/* total cost of every block, from the costs of the local block of each
+ * rank of comm */
+std::vector<double> block_costs(const double *cost, const cell_block_t &local,
+                                const std::vector<cell_block_t> &blocks,
+                                MPI_Comm comm);
+
+/**
+ * @brief Moves the columns of the state from the blocks from to the blocks
+ * to with one MPI_Alltoallv
+ *
+ * All fields of the state tensor move, so the kernel continues with the
+ * migrated state as if it had been computed on the new blocks.
+ *
+ * @param [in,out] state Local block from[rank] on entry, to[rank] on return
+ * @param [in] from Current block of every rank of comm
+ * @param [in] to New block of every rank of comm
+ * @param [in] comm Communicator of the ranks that share the cells
+ * @return Number of cells that left this rank
+ */
+size_t migrate_cells(State &state, const std::vector<cell_block_t> &from,
+                     const std::vector<cell_block_t> &to, MPI_Comm comm);
+
+/**
+ * @brief Gathers the columns of the state in a different global cell order
+ *
+ * Every rank only knows the order of its own cells: the result position of
+ * its input columns and the input index of its result columns. With the
+ * order of a space-filling curve this moves the file blocks to the curve
+ * blocks, with its inverse back.
+ *
+ * @param [in] state Local block src[rank] in the input order
+ * @param [in] src Block of every rank of comm in the input order
+ * @param [in] dst Block of every rank of comm in the result order
+ * @param [in] dst_of_src Result index of every local input column
+ * @param [in] src_of_dst Input index of every local result column
+ * @param [in] comm Communicator of the ranks that share the cells
+ * @return Local block dst[rank] in the result order
+ */
+State permute_cells(const State &state, const std::vector<cell_block_t> &src,
+                    const std::vector<cell_block_t> &dst,
+                    const std::uint64_t *dst_of_src,
+                    const std::uint64_t *src_of_dst, MPI_Comm comm);
+
+/* slice blocks[rank] of a global cell order that only root holds */
+std::vector<std::uint64_t> scatter_order(const std::vector<std::uint64_t> &order,
+                                         const std::vector<cell_block_t> &blocks,
+                                         int root, MPI_Comm comm);
+
+/* moves the local slice of a cell order along with migrate_cells */
+void migrate_order(std::vector<std::uint64_t> &slice,
+                   const std::vector<cell_block_t> &from,
+                   const std::vector<cell_block_t> &to, MPI_Comm comm);
+
+/* broadcasts the blocks from root; blocks has the same size on all ranks */
+void bcast_blocks(std::vector<cell_block_t> &blocks, int root, MPI_Comm comm);
+
+} // namespace io_muphys
@@ -0,0 +1,187 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+// PnetCDF backend of the MPI I/O: every variable of every block is posted as
+// a non-blocking request and all of them complete in one ncmpi_wait_all, so
+// PnetCDF aggregates the hyperslabs into few large MPI-IO accesses.
+//
+#include "io.hpp"
+#include <pnetcdf.h>
+#include <stdexcept>
+
+#ifdef __SINGLE_PRECISION
+#define NCMPI_IGET_VARA ncmpi_iget_vara_float
+#define NCMPI_IPUT_VARA ncmpi_iput_vara_float
+#else
+#define NCMPI_IGET_VARA ncmpi_iget_vara_double
+#define NCMPI_IPUT_VARA ncmpi_iput_vara_double
+#endif
+
+static void check(int status, const std::string &what) {
+  if (status != NC_NOERR)
+    throw std::runtime_error(what + ": " + ncmpi_strerror(status));
+}
+
+/* completes the requests collectively and checks every one of them */
+static void wait_all(int ncid, std::vector<int> &requests,
+                     const std::string &what) {
+  std::vector<int> statuses(requests.size());
+  check(ncmpi_wait_all(ncid, static_cast<int>(requests.size()),
+                       requests.data(), statuses.data()),
+        what);
+  for (int status : statuses)
+    check(status, what);
+}
+
+int io_muphys::open_input_mpi(const string &input_file, MPI_Comm comm,
+                              MPI_Info info) {
+  int ncid;
+  // classic, 64-bit offset and CDF-5 files
+  check(ncmpi_open(comm, input_file.c_str(), NC_NOWRITE, info, &ncid),
+        "Failed to open " + input_file + " with PnetCDF");
+  return ncid;
+}
+
+void io_muphys::close_input_mpi(int ncid) { ncmpi_close(ncid); }
+
+void io_muphys::input_dims_mpi(int ncid, size_t &ncells, size_t &nlev) {
+  int varid, dimids[2];
+  MPI_Offset len[2];
+  check(ncmpi_inq_varid(ncid, "zg", &varid), "Variable not found: zg");
+  check(ncmpi_inq_vardimid(ncid, varid, dimids), "zg");
+  check(ncmpi_inq_dimlen(ncid, dimids[0], &len[0]), "zg");
+  check(ncmpi_inq_dimlen(ncid, dimids[1], &len[1]), "zg");
+  nlev = static_cast<size_t>(len[0]);
+  ncells = static_cast<size_t>(len[1]);
+}
+
+void io_muphys::input_blocks_mpi(int ncid, size_t itime, size_t nlev,
+                                 const std::vector<State *> &states,
+                                 const std::vector<cell_block_t> &blocks,
+                                 int /*par_access*/, MPI_Comm /*comm*/) {
+  // ncmpi_wait_all is collective, the number of requests may differ
+  std::vector<int> requests;
+  for (const auto &field : input_fields) {
+    int varid;
+    check(ncmpi_inq_varid(ncid, field.name, &varid),
+          std::string("Variable not found: ") + field.name);
+    for (size_t b = 0; b < blocks.size(); ++b) {
+      // [time, level, cell] or [level, cell]
+      const MPI_Offset start[3] = {static_cast<MPI_Offset>(itime), 0,
+                                   static_cast<MPI_Offset>(blocks[b].start)};
+      const MPI_Offset count[3] = {1, static_cast<MPI_Offset>(nlev),
+                                   static_cast<MPI_Offset>(blocks[b].count)};
+      const int skip = field.timed ? 0 : 1;
+      int request;
+      check(NCMPI_IGET_VARA(ncid, varid, start + skip, count + skip,
+                            states[b]->field(field.slot), &request),
+            std::string("Failed to read var: ") + field.name);
+      requests.push_back(request);
+    }
+  }
+  wait_all(ncid, requests, "Failed to read the input");
+}
+
+void io_muphys::read_cell_coordinates_mpi(const string input_file,
+                                          std::vector<double> &clon,
+                                          std::vector<double> &clat,
+                                          MPI_Comm comm, MPI_Info info) {
+  MU_TRACE_SCOPE("read_cell_coordinates_mpi");
+  const int ncid = open_input_mpi(input_file, comm, info);
+  std::vector<int> requests;
+  for (auto [name, values] :
+       {std::pair{"clon", &clon}, std::pair{"clat", &clat}}) {
+    int varid, dimid;
+    MPI_Offset len;
+    if (ncmpi_inq_varid(ncid, name, &varid) ||
+        ncmpi_inq_vardimid(ncid, varid, &dimid) ||
+        ncmpi_inq_dimlen(ncid, dimid, &len)) {
+      ncmpi_close(ncid);
+      throw std::runtime_error(string("cell ordering needs the variable ") +
+                               name);
+    }
+    values->resize(static_cast<size_t>(len));
+    const MPI_Offset start = 0;
+    int request;
+    check(ncmpi_iget_vara_double(ncid, varid, &start, &len, values->data(),
+                                 &request),
+          string("Failed to read var: ") + name);
+    requests.push_back(request);
+  }
+  wait_all(ncid, requests, "Failed to read clon and clat");
+  ncmpi_close(ncid);
+}
+
+void io_muphys::write_fields_mpi(const std::string &output_file,
+                                 size_t ncells, size_t nlev,
+                                 const std::vector<output_view_t> &fields,
+                                 const std::vector<cell_block_t> &blocks,
+                                 const options_t &options, MPI_Comm comm,
+                                 MPI_Info info, io_timing_t *timing) {
+  MU_TRACE_SCOPE("write_fields_mpi");
+  if (options.deflate_level > 0)
+    throw std::invalid_argument(
+        "--deflate needs the NetCDF-4 backend, PnetCDF writes CDF-5");
+  io_timing_t t;
+  double t0 = MPI_Wtime();
+
+  int ncid;
+  // CDF-5 lifts the 4 GiB limit of a variable
+  check(ncmpi_create(comm, output_file.c_str(), NC_CLOBBER | NC_64BIT_DATA,
+                     info, &ncid),
+        "Failed to create " + output_file + " with PnetCDF");
+  int dimid_cell, dimid_height, dimid_height1;
+  check(ncmpi_def_dim(ncid, "ncells", static_cast<MPI_Offset>(ncells),
+                      &dimid_cell),
+        "Failed to define cell dimension");
+  check(ncmpi_def_dim(ncid, "height", static_cast<MPI_Offset>(nlev),
+                      &dimid_height),
+        "Failed to define height dimension");
+  check(ncmpi_def_dim(ncid, "height1", 1, &dimid_height1),
+        "Failed to define height1 dimension");
+
+  std::vector<int> varids;
+  for (const auto &field : output_fields) {
+    const int dimids[2] = {field.surface ? dimid_height1 : dimid_height,
+                           dimid_cell};
+    int varid;
+    check(ncmpi_def_var(ncid, field.name, NC_REAL_TYPE, 2, dimids, &varid),
+          std::string("define failed: ") + field.name);
+    varids.push_back(varid);
+  }
+  check(ncmpi_enddef(ncid), "Failed to leave define mode");
+  t.open = MPI_Wtime() - t0;
+  t0 = MPI_Wtime();
+
+  std::vector<int> requests;
+  for (size_t f = 0; f < std::size(output_fields); ++f) {
+    const auto &field = output_fields[f];
+    for (size_t b = 0; b < blocks.size(); ++b) {
+      const MPI_Offset start[2] = {0, static_cast<MPI_Offset>(blocks[b].start)};
+      const MPI_Offset count[2] = {
+          field.surface ? 1 : static_cast<MPI_Offset>(nlev),
+          static_cast<MPI_Offset>(blocks[b].count)};
+      int request;
+      check(NCMPI_IPUT_VARA(ncid, varids[f], start, count, fields[b][f],
+                            &request),
+            std::string("Failed to write var: ") + field.name);
+      requests.push_back(request);
+    }
+  }
+  wait_all(ncid, requests, "Failed to write " + output_file);
+  t.data = MPI_Wtime() - t0;
+  t0 = MPI_Wtime();
+
+  check(ncmpi_close(ncid), "Failed to close " + output_file);
+  t.close = MPI_Wtime() - t0;
+  if (timing)
+    *timing = t;
+}
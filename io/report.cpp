@@ -0,0 +1,430 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "report.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+/* JSON escapes quotes with a backslash, CSV doubles them */
+static std::string quote(const std::string &s, bool csv = false) {
+  std::string q = "\"";
+  for (char c : s) {
+    if (c == '"' || (c == '\\' && !csv))
+      q += csv ? '"' : '\\';
+    q += c;
+  }
+  return q + "\"";
+}
+
+static std::string number(double value) {
+  if (!std::isfinite(value))
+    return "null";
+  std::ostringstream os;
+  os.precision(std::numeric_limits<double>::max_digits10);
+  os << value;
+  return os.str();
+}
+
+void io_muphys::report_t::set(const std::string &section,
+                              const std::string &name,
+                              const std::string &field, double value) {
+  entries.push_back({section, name, field, number(value), false});
+}
+
+void io_muphys::report_t::set(const std::string &section,
+                              const std::string &name,
+                              const std::string &field,
+                              const std::string &value) {
+  entries.push_back({section, name, field, value, true});
+}
+
+void io_muphys::report_t::set(const std::string &section,
+                              const std::string &name, const stats_t &stats) {
+  set(section, name, "min", stats.min);
+  set(section, name, "max", stats.max);
+  set(section, name, "mean", stats.mean);
+  set(section, name, "stddev", stats.stddev);
+  set(section, name, "imbalance", stats.imbalance());
+  set(section, name, "ranks", static_cast<double>(stats.count));
+}
+
+void io_muphys::report_t::set(const std::string &section,
+                              const std::string &name,
+                              const latency_t &latency) {
+  set(section, name, "min", latency.min);
+  set(section, name, "median", latency.median);
+  set(section, name, "p90", latency.p90);
+  set(section, name, "p99", latency.p99);
+  set(section, name, "max", latency.max);
+  set(section, name, "mean", latency.mean);
+  set(section, name, "iterations", static_cast<double>(latency.count));
+}
+
+void io_muphys::report_t::write(const std::string &path) const {
+  std::ofstream out(path);
+  if (!out)
+    throw std::runtime_error("cannot write the report " + path);
+
+  const bool csv =
+      path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+  if (csv) {
+    out << "section,name,field,value\n";
+    for (const auto &e : entries)
+      out << e.section << "," << e.name << "," << e.field << ","
+          << (e.text ? quote(e.value, true) : e.value) << "\n";
+    return;
+  }
+
+  // group by section, then by name, keeping the order of first appearance
+  std::vector<std::string> sections;
+  for (const auto &e : entries)
+    if (std::find(sections.begin(), sections.end(), e.section) ==
+        sections.end())
+      sections.push_back(e.section);
+
+  out << "{";
+  for (size_t s = 0; s < sections.size(); ++s) {
+    out << (s ? "," : "") << "\n  " << quote(sections[s]) << ": {";
+    std::vector<std::string> names;
+    for (const auto &e : entries)
+      if (e.section == sections[s] &&
+          std::find(names.begin(), names.end(), e.name) == names.end())
+        names.push_back(e.name);
+    bool first = true;
+    for (const auto &name : names) {
+      const std::string indent = name.empty() ? "    " : "      ";
+      if (!name.empty()) {
+        out << (first ? "" : ",") << "\n    " << quote(name) << ": {";
+        first = true;
+      }
+      for (const auto &e : entries) {
+        if (e.section != sections[s] || e.name != name)
+          continue;
+        out << (first ? "" : ",") << "\n" << indent << quote(e.field) << ": "
+            << (e.text ? quote(e.value) : e.value);
+        first = false;
+      }
+      if (!name.empty())
+        out << "\n    }";
+      first = false;
+    }
+    out << "\n  }";
+  }
+  out << "\n}\n";
+}
+
+io_muphys::latency_t io_muphys::summarize(std::vector<double> samples) {
+  latency_t latency;
+  latency.count = samples.size();
+  if (samples.empty())
+    return latency;
+  std::sort(samples.begin(), samples.end());
+  // smallest sample with at least q of all samples at or below it
+  auto rank = [&](double q) {
+    const size_t n = static_cast<size_t>(std::ceil(q * samples.size()));
+    return samples[std::max<size_t>(n, 1) - 1];
+  };
+  latency.min = samples.front();
+  latency.median = rank(0.5);
+  latency.p90 = rank(0.9);
+  latency.p99 = rank(0.99);
+  latency.max = samples.back();
+  double sum = 0.0;
+  for (double sample : samples)
+    sum += sample;
+  latency.mean = sum / samples.size();
+  return latency;
+}
+
+void io_muphys::report_phases(report_t &report,
+                              const utils_muphys::phase_stats_t &stats) {
+  const double steps = static_cast<double>(std::max<std::uint64_t>(stats.calls, 1));
+  report.set("kernel", "", "steps", static_cast<double>(stats.calls));
+  report.set("kernel", "", "active_points_per_step", stats.active_points / steps);
+  report.set("kernel", "", "precip_columns_per_step", stats.precip_columns / steps);
+  for (size_t p = 0; p < phase::n; ++p) {
+    if (stats.points[p] == 0)
+      continue;
+    const double seconds = stats.seconds[p];
+    const double points = static_cast<double>(stats.points[p]);
+    report.set("kernel_phases", phase::names[p], "seconds", seconds);
+    report.set("kernel_phases", phase::names[p], "points", points);
+    report.set("kernel_phases", phase::names[p], "points/s",
+               seconds > 0.0 ? points / seconds : 0.0);
+    report.set("kernel_phases", phase::names[p], "bytes", stats.bytes[p]);
+    report.set("kernel_phases", phase::names[p], "GB/s",
+               seconds > 0.0 ? stats.bytes[p] / seconds / 1e9 : 0.0);
+  }
+
+#ifdef MU_PERF_COUNTERS
+  // hardware events of the phases summed over threads and ranks
+  const utils_muphys::perf_counters &counters = utils_muphys::process_counters();
+  report.set("kernel", "", "perf_counters",
+             counters.status().empty() ? "all events" : counters.status());
+  auto counted = [&](size_t e) { return (stats.perf_events >> e) & 1u; };
+  for (size_t p = 0; p < phase::n; ++p) {
+    if (stats.points[p] == 0 || stats.perf_events == 0)
+      continue;
+    for (size_t e = 0; e < perf::n; ++e)
+      if (counted(e))
+        report.set("kernel_counters", phase::names[p], perf::names[e],
+                   stats.events[p][e]);
+    if (counted(perf::cycles) && counted(perf::instructions) &&
+        stats.events[p][perf::cycles] > 0.0)
+      report.set("kernel_counters", phase::names[p], "ipc",
+                 stats.events[p][perf::instructions] /
+                     stats.events[p][perf::cycles]);
+  }
+#endif
+}
+
+void io_muphys::report_roofline(report_t &report,
+                                const utils_muphys::phase_stats_t &stats,
+                                const utils_muphys::roof_t &roof) {
+  report.set("roofline", "", "roof", roof.probed ? "probe" : "given");
+  report.set("roofline", "", "threads", static_cast<double>(roof.threads));
+  report.set("roofline", "", "GB/s", roof.bytes_per_second / 1e9);
+  report.set("roofline", "", "GFLOP/s", roof.flops_per_second / 1e9);
+  report.set("roofline", "", "ridge_FLOP/B", roof.ridge());
+  for (size_t p : {phase::scan, phase::transitions, phase::sedimentation}) {
+    if (stats.points[p] == 0)
+      continue;
+    const utils_muphys::roofline_point_t point =
+        utils_muphys::roofline_point(stats, p, roof);
+    report.set("roofline_phases", phase::names[p], "flops", point.flops);
+    report.set("roofline_phases", phase::names[p], "FLOP/B", point.intensity);
+    report.set("roofline_phases", phase::names[p], "GFLOP/s", point.flop_rate / 1e9);
+    report.set("roofline_phases", phase::names[p], "GB/s", point.byte_rate / 1e9);
+    report.set("roofline_phases", phase::names[p], "roof_GFLOP/s", point.roof / 1e9);
+    report.set("roofline_phases", phase::names[p], "of_roof", point.fraction);
+    report.set("roofline_phases", phase::names[p], "bound",
+               point.memory_bound ? "memory" : "compute");
+  }
+}
+
+void io_muphys::report_energy(report_t &report,
+                              const utils_muphys::energy_summary_t &energy,
+                              double cell_steps) {
+  report.set("energy", "", "nodes", energy.nodes);
+  report.set("energy", "", "seconds", energy.seconds);
+  auto set = [&](const std::string &name, const double *joules) {
+    double sum = 0.0;
+    for (size_t d = 0; d < energy::n; ++d) {
+      if (!((energy.mask >> d) & 1u))
+        continue;
+      report.set("energy", name, std::string(energy::names[d]) + "_J", joules[d]);
+      sum += joules[d];
+    }
+    report.set("energy", name, "J", sum);
+    report.set("energy", name, "J/cell-step",
+               cell_steps > 0.0 ? sum / cell_steps : 0.0);
+    return sum;
+  };
+  for (size_t p = 0; p < energy.phases.size(); ++p)
+    set(energy.phases[p], energy.joules[p].data());
+  const double total = set("total", energy.total);
+  report.set("energy", "total", "W",
+             energy.seconds > 0.0 ? total / energy.seconds : 0.0);
+}
+
+void io_muphys::print_energy(const utils_muphys::energy_summary_t &energy,
+                             double cell_steps) {
+  auto print = [&](const std::string &name, const double *joules) {
+    double sum = 0.0;
+    std::cout << "energy " << name << " [J] :";
+    for (size_t d = 0; d < energy::n; ++d)
+      if ((energy.mask >> d) & 1u) {
+        std::cout << " " << energy::names[d] << " " << joules[d];
+        sum += joules[d];
+      }
+    std::cout << std::endl;
+    return sum;
+  };
+  for (size_t p = 0; p < energy.phases.size(); ++p)
+    print(energy.phases[p], energy.joules[p].data());
+  const double total = print("total", energy.total);
+  std::cout << "energy : " << energy.nodes << " nodes, "
+            << (cell_steps > 0.0 ? 1e6 * total / cell_steps : 0.0)
+            << " uJ/cell-step, "
+            << (energy.seconds > 0.0 ? total / energy.seconds : 0.0) << " W"
+            << std::endl;
+}
+
+io_muphys::activity_log::activity_log(const std::string &path, size_t ncells,
+                                      size_t nlev)
+    : out(path),
+      csv(path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0) {
+  if (!out)
+    throw std::runtime_error("cannot write the activity log " + path);
+  if (csv)
+    out << "step,quantity,key,count\n";
+  else
+    out << "{\"ncells\": " << ncells << ", \"nlev\": " << nlev
+        << ", \"steps\": [";
+}
+
+io_muphys::activity_log::~activity_log() {
+  if (!csv)
+    out << "\n]}\n";
+}
+
+void io_muphys::activity_log::write(size_t step,
+                                    const utils_muphys::activity_t &activity) {
+  const size_t nlev = activity.nlev;
+  if (csv) {
+    auto line = [&](const char *quantity, const std::string &key,
+                    std::uint64_t count) {
+      out << step << "," << quantity << "," << key << "," << count << "\n";
+    };
+    line("columns", "", activity.columns);
+    for (size_t k = 0; k < nlev; ++k)
+      if (activity.active[k])
+        line("active", std::to_string(k), activity.active[k]);
+    for (size_t k = 0; k <= nlev; ++k)
+      if (activity.kmin[k])
+        line("kmin", k < nlev ? std::to_string(k) : "none", activity.kmin[k]);
+    for (size_t ix = 0; ix < idx::np; ++ix)
+      line("precip_columns", activity::species[idx::qp_ind[ix]],
+           activity.precip_columns[idx::qp_ind[ix]]);
+    for (size_t r = 0; r < activity::n; ++r)
+      line("regime", activity::names[r], activity.regimes[r]);
+    for (size_t ix = 0; ix < idx::nx; ++ix)
+      line("limited", activity::species[idx::qx_ind[ix]],
+           activity.limited[idx::qx_ind[ix]]);
+  } else {
+    auto array = [&](const std::vector<std::uint64_t> &counts) {
+      out << "[";
+      for (size_t i = 0; i < counts.size(); ++i)
+        out << (i ? "," : "") << counts[i];
+      out << "]";
+    };
+    auto object = [&](const char *const *keys, const size_t *order, size_t n,
+                      const std::uint64_t *counts) {
+      out << "{";
+      for (size_t i = 0; i < n; ++i)
+        out << (i ? ", " : "") << quote(keys[order[i]]) << ": "
+            << counts[order[i]];
+      out << "}";
+    };
+    const size_t regimes[activity::n] = {activity::warm, activity::cold,
+                                         activity::mixed};
+    out << (steps ? "," : "") << "\n  {\"step\": " << step
+        << ", \"columns\": " << activity.columns << ", \"active\": ";
+    array(activity.active);
+    out << ", \"kmin\": ";
+    array(activity.kmin);
+    out << ", \"precip_columns\": ";
+    object(activity::species, idx::qp_ind, idx::np, activity.precip_columns);
+    out << ", \"regimes\": ";
+    object(activity::names, regimes, activity::n, activity.regimes);
+    out << ", \"limited\": ";
+    object(activity::species, idx::qx_ind, idx::nx, activity.limited);
+    out << "}";
+  }
+  ++steps;
+  out.flush();
+}
+
+#ifdef USE_MPI
+io_muphys::stats_t io_muphys::reduce_stats(double value, bool participates,
+                                           MPI_Comm comm) {
+  const double inf = std::numeric_limits<double>::infinity();
+  const double lo = participates ? value : inf;
+  const double hi = participates ? -value : inf;
+  const double sums[3] = {participates ? value : 0.0,
+                          participates ? value * value : 0.0,
+                          participates ? 1.0 : 0.0};
+  double extremes[2] = {lo, hi}, min_max[2], totals[3];
+  MPI_Reduce(extremes, min_max, 2, MPI_DOUBLE, MPI_MIN, 0, comm);
+  MPI_Reduce(sums, totals, 3, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+  stats_t stats;
+  stats.count = static_cast<int>(totals[2]);
+  if (stats.count == 0)
+    return stats;
+  stats.min = min_max[0];
+  stats.max = -min_max[1];
+  stats.mean = totals[0] / totals[2];
+  stats.stddev =
+      std::sqrt(std::max(0.0, totals[1] / totals[2] - stats.mean * stats.mean));
+  return stats;
+}
+
+utils_muphys::energy_summary_t
+io_muphys::reduce_energy(const utils_muphys::energy_summary_t &energy,
+                         bool measures, MPI_Comm comm) {
+  utils_muphys::energy_summary_t sum;
+  sum.phases = energy.phases;
+  sum.joules.resize(energy.phases.size());
+  std::vector<double> local;
+  for (const auto &joules : energy.joules)
+    for (size_t d = 0; d < energy::n; ++d)
+      local.push_back(measures ? joules[d] : 0.0);
+  for (size_t d = 0; d < energy::n; ++d)
+    local.push_back(measures ? energy.total[d] : 0.0);
+  local.push_back(measures ? 1.0 : 0.0);
+  std::vector<double> global(local.size());
+  MPI_Reduce(local.data(), global.data(), static_cast<int>(local.size()),
+             MPI_DOUBLE, MPI_SUM, 0, comm);
+  double seconds = measures ? energy.seconds : 0.0;
+  MPI_Reduce(&seconds, &sum.seconds, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+  unsigned mask = measures ? energy.mask : ~0u;
+  MPI_Reduce(&mask, &sum.mask, 1, MPI_UNSIGNED, MPI_BAND, 0, comm);
+
+  size_t i = 0;
+  for (auto &joules : sum.joules)
+    for (size_t d = 0; d < energy::n; ++d)
+      joules[d] = global[i++];
+  for (size_t d = 0; d < energy::n; ++d)
+    sum.total[d] = global[i++];
+  sum.nodes = static_cast<int>(global[i]);
+  if (sum.nodes == 0)
+    sum.mask = 0;
+  return sum;
+}
+
+utils_muphys::activity_t
+io_muphys::reduce_activity(const utils_muphys::activity_t &activity,
+                           MPI_Comm comm) {
+  // every count in one buffer: columns, active, kmin and the fixed arrays
+  std::vector<std::uint64_t> local{activity.columns};
+  local.insert(local.end(), activity.active.begin(), activity.active.end());
+  local.insert(local.end(), activity.kmin.begin(), activity.kmin.end());
+  local.insert(local.end(), activity.precip_columns,
+               activity.precip_columns + idx::np);
+  local.insert(local.end(), activity.regimes, activity.regimes + activity::n);
+  local.insert(local.end(), activity.limited, activity.limited + idx::nx);
+  std::vector<std::uint64_t> global(local.size());
+  MPI_Reduce(local.data(), global.data(), static_cast<int>(local.size()),
+             MPI_UINT64_T, MPI_SUM, 0, comm);
+
+  utils_muphys::activity_t sum;
+  sum.reset(activity.nlev);
+  MPI_Reduce(&activity.calls, &sum.calls, 1, MPI_UINT64_T, MPI_MAX, 0, comm);
+  auto next = global.begin();
+  sum.columns = *next++;
+  std::copy(next, next + sum.nlev, sum.active.begin());
+  next += sum.nlev;
+  std::copy(next, next + sum.nlev + 1, sum.kmin.begin());
+  next += sum.nlev + 1;
+  std::copy(next, next + idx::np, sum.precip_columns);
+  next += idx::np;
+  std::copy(next, next + activity::n, sum.regimes);
+  next += activity::n;
+  std::copy(next, next + idx::nx, sum.limited);
+  return sum;
+}
+#endif
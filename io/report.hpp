@@ -0,0 +1,131 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include "../core/common/activity.hpp"
+#include "../core/common/energy.hpp"
+#include "../core/common/roofline.hpp"
+#include "../core/common/timer.hpp"
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+namespace io_muphys {
+
+/* min, max, mean and standard deviation of a quantity over ranks */
+struct stats_t {
+  double min = 0.0, max = 0.0, mean = 0.0, stddev = 0.0;
+  int count = 0; // ranks that contributed
+  /* load-imbalance factor max/mean, 1 is balanced */
+  double imbalance() const { return mean > 0.0 ? max / mean : 1.0; }
+};
+
+/* distribution of the per-iteration times of a benchmark run */
+struct latency_t {
+  double min = 0.0, median = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0;
+  double mean = 0.0;
+  size_t count = 0; // timed iterations
+};
+
+/* latency of the samples, percentiles by nearest rank */
+latency_t summarize(std::vector<double> samples);
+
+/**
+ * @brief Machine-readable run report
+ *
+ * Values are grouped as section / name / field, in the order they are set.
+ * write() emits JSON, {"section": {"name": {"field": value}}}, or with a
+ * .csv path one section,name,field,value line per value. An empty name
+ * puts the fields directly into the section.
+ */
+class report_t {
+public:
+  void set(const std::string &section, const std::string &name,
+           const std::string &field, double value);
+  void set(const std::string &section, const std::string &name,
+           const std::string &field, const std::string &value);
+  /* min, max, mean, stddev, imbalance and ranks of stats */
+  void set(const std::string &section, const std::string &name,
+           const stats_t &stats);
+  /* min, median, p90, p99, max, mean and iterations of latency */
+  void set(const std::string &section, const std::string &name,
+           const latency_t &latency);
+
+  void write(const std::string &path) const;
+
+private:
+  struct entry_t {
+    std::string section, name, field, value;
+    bool text; // a string value, quoted in the output
+  };
+  std::vector<entry_t> entries;
+};
+
+/* time, points, points/s, bytes and GB/s of the kernel phases that ran,
+ * with the active points and precipitating columns per step */
+void report_phases(report_t &report, const utils_muphys::phase_stats_t &stats);
+
+/* the roof and FLOPs, intensity, achieved and attainable FLOP/s of the
+ * scan, transitions and sedimentation */
+void report_roofline(report_t &report, const utils_muphys::phase_stats_t &stats,
+                     const utils_muphys::roof_t &roof);
+
+/* joules of the package and DRAM domains of the phases and the run, their
+ * sum per cell-step and the mean power of the run */
+void report_energy(report_t &report, const utils_muphys::energy_summary_t &energy,
+                   double cell_steps);
+/* the same on stdout */
+void print_energy(const utils_muphys::energy_summary_t &energy,
+                  double cell_steps);
+
+/**
+ * @brief Activity statistics of every step, written as the steps complete
+ *
+ * JSON holds the grid and one compact object per step and line with the
+ * active points per level, the columns per kmin (the last bin has no
+ * precipitation), the precipitating columns per species, the regimes and
+ * the limiter activations per species. A .csv path gets step,quantity,key,
+ * count lines instead, without the empty bins of the level histograms.
+ */
+class activity_log {
+public:
+  activity_log(const std::string &path, size_t ncells, size_t nlev);
+  ~activity_log();
+
+  void write(size_t step, const utils_muphys::activity_t &activity);
+
+private:
+  std::ofstream out;
+  bool csv;
+  size_t steps = 0;
+};
+
+#ifdef USE_MPI
+/* stats of value over the ranks of comm that take part, valid on rank 0 */
+stats_t reduce_stats(double value, bool participates, MPI_Comm comm);
+
+/* energy summed over the ranks of comm that measure, one per node, valid
+ * on rank 0 */
+utils_muphys::energy_summary_t
+reduce_energy(const utils_muphys::energy_summary_t &energy, bool measures,
+              MPI_Comm comm);
+
+/* activity summed over the ranks of comm, valid on rank 0 */
+utils_muphys::activity_t
+reduce_activity(const utils_muphys::activity_t &activity, MPI_Comm comm);
+#endif
+
+} // namespace io_muphys
@@ -0,0 +1,242 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "topology.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+static const char *SYSFS_NODES = "/sys/devices/system/node";
+static const char *SYSFS_CPUS = "/sys/devices/system/cpu";
+
+/* "0-3,8,10-11" -> 0 1 2 3 8 10 11 */
+static std::vector<int> parse_cpu_list(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.find_first_of("0123456789") == std::string::npos)
+      continue;
+    const size_t dash = range.find('-');
+    const int first = std::stoi(range.substr(0, dash));
+    const int last =
+        dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+/* 0 1 2 3 8 10 11 -> "0-3,8,10-11" */
+static std::string format_cpu_list(std::vector<int> cpus) {
+  std::sort(cpus.begin(), cpus.end());
+  std::string list;
+  for (size_t i = 0; i < cpus.size();) {
+    size_t j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+      ++j;
+    list += (list.empty() ? "" : ",") + std::to_string(cpus[i]);
+    if (j > i)
+      list += "-" + std::to_string(cpus[j]);
+    i = j + 1;
+  }
+  return list;
+}
+
+static std::string read_line(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+/* first CPU of the core of cpu, so that SMT siblings sort together */
+static int core_of(int cpu) {
+  const std::vector<int> siblings = parse_cpu_list(
+      read_line(std::filesystem::path(SYSFS_CPUS) / ("cpu" + std::to_string(cpu)) /
+                "topology" / "thread_siblings_list"));
+  return siblings.empty() ? cpu : siblings.front();
+}
+
+#ifdef __linux__
+static std::vector<int> allowed_cpus() {
+  cpu_set_t mask;
+  std::vector<int> cpus;
+  if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      if (CPU_ISSET(cpu, &mask))
+        cpus.push_back(cpu);
+  return cpus;
+}
+#endif
+
+std::vector<std::vector<int>> io_muphys::numa_domains() {
+  std::vector<std::pair<int, std::vector<int>>> nodes;
+  std::error_code error;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(SYSFS_NODES, error)) {
+    const std::string name = entry.path().filename().string();
+    if (name.size() < 5 || name.compare(0, 4, "node") != 0 ||
+        name.find_first_not_of("0123456789", 4) != std::string::npos)
+      continue;
+    std::vector<int> cpus = parse_cpu_list(read_line(entry.path() / "cpulist"));
+    if (!cpus.empty()) // memory-only domains have no CPUs
+      nodes.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+  }
+  std::sort(nodes.begin(), nodes.end());
+
+  std::vector<std::vector<int>> domains;
+  for (auto &node : nodes)
+    domains.push_back(std::move(node.second));
+#ifdef __linux__
+  if (domains.empty())
+    domains.push_back(allowed_cpus());
+#endif
+  return domains;
+}
+
+io_muphys::rank_placement_t io_muphys::bind_ranks(const std::string &bind,
+                                                  MPI_Comm comm) {
+  if (bind != "none" && bind != "numa")
+    throw std::invalid_argument("--bind expects none|numa");
+  rank_placement_t placement;
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+                      &placement.node);
+  MPI_Comm_rank(placement.node, &placement.node_rank);
+  MPI_Comm_size(placement.node, &placement.node_size);
+
+#ifdef __linux__
+  // CPUs any rank of the node may run on: the launcher may already have
+  // bound every rank to a few cores of the job
+  cpu_set_t node_mask, mask;
+  CPU_ZERO(&node_mask);
+  sched_getaffinity(0, sizeof(mask), &mask);
+  MPI_Allreduce(&mask, &node_mask, sizeof(cpu_set_t), MPI_BYTE, MPI_BOR,
+                placement.node);
+
+  // CPUs of the node by domain and core
+  std::vector<std::vector<int>> domains = numa_domains();
+  std::vector<int> cpus, domain_of;
+  for (size_t d = 0; d < domains.size(); ++d) {
+    std::vector<std::pair<int, int>> usable; // core, cpu
+    for (int cpu : domains[d])
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &node_mask))
+        usable.emplace_back(core_of(cpu), cpu);
+    std::sort(usable.begin(), usable.end());
+    for (const auto &[core, cpu] : usable) {
+      cpus.push_back(cpu);
+      domain_of.push_back(static_cast<int>(d));
+    }
+  }
+  placement.ndomains = static_cast<int>(domains.size());
+  if (cpus.empty())
+    return placement;
+
+  // consecutive slice of at least one CPU per rank
+  const size_t n = cpus.size();
+  const size_t r = placement.node_rank, nr = placement.node_size;
+  const size_t first = r * n / nr;
+  const size_t last = std::max(first + 1, (r + 1) * n / nr);
+
+  if (bind == "numa") {
+    placement.cpus.assign(cpus.begin() + first, cpus.begin() + last);
+    CPU_ZERO(&mask);
+    for (int cpu : placement.cpus)
+      CPU_SET(cpu, &mask);
+    if (sched_setaffinity(0, sizeof(mask), &mask) != 0)
+      throw std::runtime_error("sched_setaffinity failed for rank " +
+                               std::to_string(rank));
+    placement.bound = true;
+  }
+  else {
+    placement.cpus = allowed_cpus();
+  }
+  if (!placement.cpus.empty()) {
+    const auto it =
+        std::find(cpus.begin(), cpus.end(), placement.cpus.front());
+    placement.domain = it == cpus.end() ? 0 : domain_of[it - cpus.begin()];
+  }
+#else
+  if (bind == "numa")
+    throw std::runtime_error("--bind=numa needs Linux CPU affinity");
+#endif
+  return placement;
+}
+
+void io_muphys::report_topology(const rank_placement_t &placement,
+                                int thread_level, MPI_Comm comm) {
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+
+  // node index of every rank from the first rank of its node
+  int leader = placement.node_rank == 0 ? 1 : 0, node_index = 0, nnodes;
+  MPI_Exscan(&leader, &node_index, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0)
+    node_index = 0;
+  MPI_Bcast(&node_index, 1, MPI_INT, 0, placement.node);
+  MPI_Allreduce(&leader, &nnodes, 1, MPI_INT, MPI_SUM, comm);
+
+  const int NINFO = 4, NLIST = 64;
+  int info[NINFO] = {node_index, placement.domain,
+                     static_cast<int>(placement.cpus.size()),
+                     placement.node_size};
+  char list[NLIST] = {};
+  std::strncpy(list, format_cpu_list(placement.cpus).c_str(), NLIST - 1);
+  std::vector<int> all(rank == 0 ? NINFO * nprocs : 0);
+  std::vector<char> lists(rank == 0 ? NLIST * nprocs : 0);
+  MPI_Gather(info, NINFO, MPI_INT, all.data(), NINFO, MPI_INT, 0, comm);
+  MPI_Gather(list, NLIST, MPI_CHAR, lists.data(), NLIST, MPI_CHAR, 0, comm);
+  if (rank != 0)
+    return;
+
+  int ranks_min = INT_MAX, ranks_max = 0, cpus_min = INT_MAX, cpus_max = 0;
+  for (int r = 0; r < nprocs; ++r) {
+    cpus_min = std::min(cpus_min, all[NINFO * r + 2]);
+    cpus_max = std::max(cpus_max, all[NINFO * r + 2]);
+    ranks_min = std::min(ranks_min, all[NINFO * r + 3]);
+    ranks_max = std::max(ranks_max, all[NINFO * r + 3]);
+  }
+  auto range = [](int lo, int hi) {
+    return lo == hi ? std::to_string(lo)
+                    : std::to_string(lo) + "-" + std::to_string(hi);
+  };
+  const char *level = "single";
+  if (thread_level == MPI_THREAD_FUNNELED)
+    level = "funneled";
+  else if (thread_level == MPI_THREAD_SERIALIZED)
+    level = "serialized";
+  else if (thread_level == MPI_THREAD_MULTIPLE)
+    level = "multiple";
+  std::cout << "topology : " << nnodes << " nodes, "
+            << range(ranks_min, ranks_max) << " ranks per node, "
+            << placement.ndomains << " NUMA domains per node, "
+            << range(cpus_min, cpus_max) << " cpus per rank, thread level "
+            << level << ", " << (placement.bound ? "bound" : "unbound")
+            << std::endl;
+  // one line per rank for the runs that tune the ranks x threads split
+  if (nprocs > 64)
+    return;
+  for (int r = 0; r < nprocs; ++r)
+    std::cout << "rank " << r << " : node " << all[NINFO * r] << ", numa "
+              << all[NINFO * r + 1] << ", cpus " << &lists[NLIST * r] << " ("
+              << all[NINFO * r + 2] << ")" << std::endl;
+}
@@ -0,0 +1,55 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+namespace io_muphys {
+
+/* CPUs of every NUMA domain of this node, from sysfs; one domain with all
+ * CPUs the process may run on if the node does not report any */
+std::vector<std::vector<int>> numa_domains();
+
+/**
+ * @brief Placement of this rank on its node
+ *
+ * The ranks of a node, found with MPI_Comm_split_type(MPI_COMM_TYPE_SHARED),
+ * get consecutive slices of the CPUs of the node ordered by NUMA domain.
+ * With one or more ranks per domain every slice lies within one domain.
+ */
+struct rank_placement_t {
+  MPI_Comm node = MPI_COMM_NULL; // ranks sharing memory, free after use
+  int node_rank = 0, node_size = 1;
+  int ndomains = 1;           // NUMA domains of the node
+  int domain = 0;             // domain of the first CPU of the rank
+  std::vector<int> cpus;      // CPUs of the rank
+  bool bound = false;         // affinity set by bind_ranks
+};
+
+/**
+ * @brief Places the ranks of comm on the NUMA domains of their nodes
+ *
+ * With bind = "numa" the affinity of the calling thread, inherited by all
+ * threads it creates later, is set to the CPUs of the rank, so this must
+ * run before the first parallel algorithm. OMP_PROC_BIND and OMP_PLACES
+ * default to close and cores so that OpenMP threads stay inside the slice.
+ * With bind = "none" the placement is only reported.
+ */
+rank_placement_t bind_ranks(const std::string &bind,
+                            MPI_Comm comm = MPI_COMM_WORLD);
+
+/* prints the ranks x threads layout of all nodes on rank 0 of comm */
+void report_topology(const rank_placement_t &placement, int thread_level,
+                     MPI_Comm comm = MPI_COMM_WORLD);
+
+} // namespace io_muphys
@@ -12,11 +12,22 @@
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
+#include "core/common/activity.hpp"
+#include "core/common/energy.hpp"
 #include "core/common/graupel.hpp"
+#include "core/common/roofline.hpp"
+#include "core/common/trace.hpp"
 #include "core/common/types.hpp"
 #include "core/common/utils.hpp"
+#include "io/async_writer.hpp"
 #include "io/io.hpp"
+#include "io/report.hpp"
+#include "synth/synth.hpp"
 #include <chrono>
 
 int main(int argc, char *argv[]) {
@@ -25,30 +36,86 @@ int main(int argc, char *argv[]) {
   string output_file;
   size_t itime;
   real_t dt, qnc, qnc_1;
+  const io_muphys::options_t options = io_muphys::parse_options(argc, argv);
   io_muphys::parse_args(file, output_file, itime, dt, qnc, argc, argv);
+  if (!options.trace_file.empty()) {
+#ifndef MU_TRACE
+    throw std::invalid_argument("--trace needs MU_ENABLE_TRACE");
+#endif
+    utils_muphys::trace_start();
+  }
+#ifndef MU_ACTIVITY_STATS
+  if (!options.activity_file.empty())
+    throw std::invalid_argument("--activity needs MU_ENABLE_ACTIVITY_STATS");
+#endif
+
+  // the roof of the machine, probed before the state takes up memory
+  utils_muphys::roof_t roof;
+  if (options.roofline) {
+#ifndef MU_PHASE_TIMERS
+    throw std::invalid_argument("--roofline needs MU_ENABLE_PHASE_TIMERS");
+#endif
+    if (options.roof_gbs > 0.0) {
+      roof.bytes_per_second = 1e9 * options.roof_gbs;
+      roof.flops_per_second = 1e9 * options.roof_gflops;
+    } else {
+#ifdef MU_ENABLE_STD
+      roof = utils_muphys::measure_roof(std::thread::hardware_concurrency());
+#else
+      roof = utils_muphys::measure_roof(1);
+#endif
+    }
+    std::cout << "roof : " << roof.bytes_per_second / 1e9 << " GB/s, "
+              << roof.flops_per_second / 1e9 << " GFLOP/s"
+              << (roof.probed ? " probed on " + std::to_string(roof.threads) +
+                                    " threads"
+                              : std::string(" given"))
+              << ", ridge " << roof.ridge() << " FLOP/B" << std::endl;
+  }
+
+  // energy of the node from the RAPL counters, measured after the probes
+  std::unique_ptr<utils_muphys::energy_meter> meter;
+  if (options.energy) {
+    meter = std::make_unique<utils_muphys::energy_meter>();
+    if (!meter->status().empty())
+      std::cout << "energy : " << meter->status() << std::endl;
+  }
+  utils_muphys::energy_account energy(meter.get());
 
   // Parameters from the input file
   size_t ncells, nlev;
-  array_1d_t<real_t> z, t, p, rho, qv, qc, qi, qr, qs, qg;
-
-  // Pre-calculated parameters
-  array_1d_t<real_t> dz;
-  // Extra fields required to call graupel
-  array_1d_t<real_t> pflx, prr_gsp, pri_gsp, prs_gsp, prg_gsp, pre_gsp;
+  // Input, output and pre-calculated fields in one contiguous tensor
+  State state;
   // start-end indices
   size_t kend, kbeg, ivend, ivbeg, nvec;
 
   const string input_file = file;
-  io_muphys::read_fields(input_file, itime, ncells, nlev, z, t, p, rho, qv, qc,
-                         qi, qr, qs, qg);
-  utils_muphys::calc_dz(z, dz, ncells, nlev);
-
-  prr_gsp.resize(ncells, ZERO);
-  pri_gsp.resize(ncells, ZERO);
-  prs_gsp.resize(ncells, ZERO);
-  prg_gsp.resize(ncells, ZERO);
-  pre_gsp.resize(ncells, ZERO);
-  pflx.resize(ncells * nlev, ZERO);
+  auto read_start = std::chrono::steady_clock::now();
+  if (input_file.rfind("synth:", 0) == 0) {
+    // synth:ncells=<n>,nlev=<n>,... generates the input in memory
+    MU_TRACE_SCOPE("generate");
+    const synth_muphys::synth_options_t synth =
+        synth_muphys::parse_spec(input_file.substr(6));
+    synth_muphys::generate(synth, state);
+    ncells = synth.ncells;
+    nlev = synth.nlev;
+  } else {
+    io_muphys::read_fields(input_file, itime, ncells, nlev, state);
+  }
+  const double read_seconds = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - read_start)
+                                  .count();
+  energy.end("read");
+#ifndef MU_DZ_ON_THE_FLY
+  // z is replaced by the layer thickness in place; otherwise the kernel
+  // derives it column by column from z
+  {
+    MU_TRACE_SCOPE("calc_dz");
+    utils_muphys::calc_dz(state.field(fld::dz), state.field(fld::dz), ncells,
+                          nlev);
+  }
+  energy.end("calc_dz");
+#endif
 
   kbeg = 0;
   kend = nlev;
@@ -67,21 +134,234 @@ int main(int argc, char *argv[]) {
      }
   std::cout << "multirun =" << multirun << std::endl;
 
+  // write a snapshot every MU_OUTPUT_INTERVAL steps, 0 only writes the end
+  size_t output_interval = 0;
+  if (std::getenv("MU_OUTPUT_INTERVAL")) {
+    output_interval = atoi(std::getenv("MU_OUTPUT_INTERVAL"));
+  }
+
+  // snapshots are written in the background while the next steps compute
+  io_muphys::async_writer writer(ncells, nlev, options);
+
+  // where the kernel had work, one record per step
+  std::unique_ptr<io_muphys::activity_log> activity;
+  if (!options.activity_file.empty())
+    activity = std::make_unique<io_muphys::activity_log>(options.activity_file,
+                                                         ncells, nlev);
+  auto log_activity = [&](size_t step) {
+    if (!activity)
+      return;
+    activity->write(step, utils_muphys::activity_stats());
+    utils_muphys::activity_stats().reset(nlev);
+  };
+
+  energy.begin();
   auto start_time = std::chrono::steady_clock::now();
+  io_muphys::latency_t latency;
+  double active_points = 0.0;
+
+  if (options.bench_iterations > 0) {
+    // replay: every iteration computes the same step from the input state,
+    // restored untimed in between, instead of continuing from the last one
+    const State snapshot = state;
+    std::vector<std::uint32_t> active(ncells);
+    utils_muphys::active_levels(state, ncells, nlev, active.data());
+    for (std::uint32_t levels : active)
+      active_points += levels;
 
-  for (size_t ii = 0; ii < multirun; ++ii){
-    graupel(nvec, kend, ivbeg, ivend, kbeg, dt, dz, t, rho, p, qv, qc, qi, qr, qs,
-            qg, qnc_1, prr_gsp, pri_gsp, prs_gsp, prg_gsp, pre_gsp, pflx);
- } 
+    std::vector<double> samples;
+    const size_t iterations = options.bench_warmup + options.bench_iterations;
+    for (size_t ii = 0; ii < iterations; ++ii) {
+      if (ii == options.bench_warmup) {
+#ifdef MU_PHASE_TIMERS
+        utils_muphys::phase_stats() = {};
+#endif
+        energy.begin();
+        start_time = std::chrono::steady_clock::now();
+      }
+      if (ii > 0) {
+        MU_TRACE_SCOPE("restore");
+        utils_muphys::restore_state(snapshot, state);
+      }
+      auto iteration_start = std::chrono::steady_clock::now();
+      {
+        MU_TRACE_SCOPE("graupel");
+        graupel(nvec, kend, ivbeg, ivend, kbeg, dt, state, qnc_1);
+      }
+      auto iteration_end = std::chrono::steady_clock::now();
+      // every iteration computes the same step
+      if (ii == 0)
+        log_activity(1);
+      if (ii >= options.bench_warmup)
+        samples.push_back(
+            std::chrono::duration<double>(iteration_end - iteration_start)
+                .count());
+    }
+    latency = io_muphys::summarize(samples);
+    multirun = options.bench_iterations;
+  } else {
+    for (size_t ii = 0; ii < multirun; ++ii) {
+      MU_TRACE_SCOPE("step");
+      graupel(nvec, kend, ivbeg, ivend, kbeg, dt, state, qnc_1);
+      log_activity(ii + 1);
+      if (output_interval > 0 && (ii + 1) % output_interval == 0 &&
+          ii + 1 < multirun) {
+        writer.submit(io_muphys::step_file_name(output_file, ii + 1), state);
+      }
+    }
+  }
   auto end_time = std::chrono::steady_clock::now();
+  energy.end("kernel");
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
       end_time - start_time);
+  // kernel time; in bench mode without the restores between iterations
+  const double seconds =
+      options.bench_iterations > 0
+          ? latency.mean * latency.count
+          : std::chrono::duration<double>(end_time - start_time).count();
 
-  io_muphys::write_fields(output_file, ncells, nlev, t, qv, qc, qi, qr, qs,
-                            qg, prr_gsp, pri_gsp, prs_gsp, prg_gsp, pre_gsp, pflx);
+  // the final state is written from its own memory, without a snapshot
+  writer.write(output_file, state);
+  energy.end("write");
 
   std::cout << "time taken : " << duration.count() << " milliseconds"
             << std::endl;
+  if (options.bench_iterations > 0) {
+    std::cout << "bench : " << latency.count << " iterations after "
+              << options.bench_warmup << " warm-up, ms per iteration min "
+              << 1e3 * latency.min << " median " << 1e3 * latency.median
+              << " p90 " << 1e3 * latency.p90 << " p99 " << 1e3 * latency.p99
+              << " max " << 1e3 * latency.max << std::endl;
+    std::cout << "bench : " << 1e-6 * ncells / latency.median
+              << " Mcells/s, " << 1e-6 * active_points / latency.median
+              << " Mactive points/s (median, " << active_points
+              << " active points per step)" << std::endl;
+  }
+  std::cout << "output : " << writer.snapshots() << " snapshots, write "
+            << 1e3 * writer.write_seconds() << " ms, hidden "
+            << 1e3 * writer.hidden_seconds() << " ms, exposed "
+            << 1e3 * writer.exposed_seconds() << " ms" << std::endl;
+  // dz replaces z in its slot of the state, and with MU_DZ_ON_THE_FLY the
+  // dz scratch column lives in pflx, so the state is the whole footprint
+  std::cout << "state : " << state.size() * sizeof(real_t) / (1024 * 1024)
+            << " MB, dz in place of z, dz scratch in pflx" << std::endl;
+  std::cout << "dz traffic : "
+            << utils_muphys::dz_traffic_bytes(ncells, nlev, multirun) /
+                   (1024 * 1024)
+            << " MB (" << utils_muphys::dz_mode << ")" << std::endl;
+  std::cout << "peak memory : " << utils_muphys::peak_memory() / (1024 * 1024)
+            << " MB" << std::endl;
+
+  // energy of the phases; the background writes of the snapshots count
+  // towards the kernel
+  const utils_muphys::energy_summary_t energy_summary =
+      energy.summary({"read", "calc_dz", "kernel", "write"});
+  const double cell_steps = 1.0 * ncells * multirun;
+  if (options.energy)
+    io_muphys::print_energy(energy_summary, cell_steps);
+
+#ifdef MU_PHASE_TIMERS
+  // time and throughput of the kernel phases
+  const utils_muphys::phase_stats_t &phases = utils_muphys::phase_stats();
+  for (size_t p = 0; p < phase::n; ++p) {
+    if (phases.points[p] == 0)
+      continue;
+    std::cout << "phase " << phase::names[p] << " : " << 1e3 * phases.seconds[p]
+              << " ms, " << 1e-6 * phases.points[p] / phases.seconds[p]
+              << " Mpoints/s, " << 1e-9 * phases.bytes[p] / phases.seconds[p]
+              << " GB/s" << std::endl;
+  }
+#ifdef MU_PERF_COUNTERS
+  if (!utils_muphys::process_counters().status().empty())
+    std::cout << "perf counters : " << utils_muphys::process_counters().status()
+              << std::endl;
+  for (size_t p = 0; p < phase::n; ++p) {
+    if (phases.points[p] == 0 || phases.perf_events == 0)
+      continue;
+    std::cout << "counters " << phase::names[p] << " :";
+    for (size_t e = 0; e < perf::n; ++e)
+      if ((phases.perf_events >> e) & 1u)
+        std::cout << " " << perf::names[e] << " " << phases.events[p][e];
+    std::cout << std::endl;
+  }
+#endif
+  if (options.roofline) {
+    // achieved against attainable FLOP/s at the intensity of each phase
+    std::cout << "roofline : phase, GFLOP, FLOP/B, GFLOP/s, GB/s, roof "
+                 "GFLOP/s, % of roof, bound"
+              << std::endl;
+    for (size_t p : {phase::scan, phase::transitions, phase::sedimentation}) {
+      if (phases.points[p] == 0)
+        continue;
+      const utils_muphys::roofline_point_t point =
+          utils_muphys::roofline_point(phases, p, roof);
+      std::cout << "roofline " << phase::names[p] << " : " << point.flops / 1e9
+                << " " << point.intensity << " " << point.flop_rate / 1e9
+                << " " << point.byte_rate / 1e9 << " " << point.roof / 1e9
+                << " " << 100.0 * point.fraction << "% "
+                << (point.memory_bound ? "memory" : "compute") << std::endl;
+    }
+  }
+  std::cout << "active points : " << phases.active_points / multirun
+            << " per step, precipitating columns : "
+            << phases.precip_columns / multirun << " per step" << std::endl;
+#endif
+
+  if (!options.report_file.empty()) {
+    io_muphys::report_t report;
+    report.set("run", "", "ncells", ncells);
+    report.set("run", "", "nlev", nlev);
+    report.set("run", "", "steps", multirun);
+#ifdef MU_ENABLE_STD
+    report.set("run", "", "implementation", "std");
+#else
+    report.set("run", "", "implementation", "seq");
+#endif
+    report.set("run", "", "precision", sizeof(real_t) == 4 ? "single" : "double");
+#ifdef MU_PHASE_TIMERS
+    report.set("run", "", "phase_timers", "on");
+#else
+    report.set("run", "", "phase_timers", "off");
+#endif
+    // read or generate the input, write all outputs
+    const double field_bytes = 1.0 * ncells * nlev * sizeof(real_t);
+    report.set("io", "", "read_seconds", read_seconds);
+    report.set("io", "", "read_GB/s",
+               read_seconds > 0.0 ? 10.0 * field_bytes / read_seconds / 1e9 : 0.0);
+    report.set("io", "", "write_seconds", writer.write_seconds());
+    report.set("io", "", "write_GB/s",
+               writer.write_seconds() > 0.0
+                   ? writer.snapshots() *
+                         (8.0 * field_bytes + 5.0 * ncells * sizeof(real_t)) /
+                         writer.write_seconds() / 1e9
+                   : 0.0);
+    report.set("kernel", "", "seconds", seconds);
+    report.set("kernel", "", "points/s",
+               seconds > 0.0 ? 1.0 * ncells * nlev * multirun / seconds : 0.0);
+    if (options.bench_iterations > 0) {
+      report.set("bench", "", "warmup", options.bench_warmup);
+      report.set("bench", "", "active_points", active_points);
+      report.set("bench", "", "cells/s", ncells / latency.median);
+      report.set("bench", "", "active_points/s", active_points / latency.median);
+      report.set("bench", "seconds", latency);
+    }
+#ifdef MU_PHASE_TIMERS
+    io_muphys::report_phases(report, utils_muphys::phase_stats());
+    if (options.roofline)
+      io_muphys::report_roofline(report, utils_muphys::phase_stats(), roof);
+#endif
+    if (options.energy)
+      io_muphys::report_energy(report, energy_summary, cell_steps);
+    report.write(options.report_file);
+  }
+
+  if (!options.trace_file.empty()) {
+    utils_muphys::trace_stop();
+    utils_muphys::write_trace(options.trace_file);
+    std::cout << "trace : " << options.trace_file << ", "
+              << utils_muphys::trace_dropped() << " events dropped"
+              << std::endl;
+  }
 
 
   return 0;
@@ -9,14 +9,26 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // ---------------------------------------------------------------
 //
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 
+#include "core/common/activity.hpp"
+#include "core/common/energy.hpp"
 #include "core/common/graupel.hpp"
+#include "core/common/trace.hpp"
 #include "core/common/types.hpp"
 #include "core/common/utils.hpp"
+#include "io/cell_order.hpp"
 #include "io/io.hpp"
+#include "io/io_server.hpp"
+#include "io/node_stage.hpp"
+#include "io/partition.hpp"
+#include "io/report.hpp"
+#include "io/topology.hpp"
 #include <chrono>
 #include <mpi.h>
 
@@ -24,17 +36,53 @@ using namespace std;
 
 int main(int argc, char *argv[]) {
    //auto start_time = std::chrono::steady_clock::now();
-   // Mpi parameters initilization
-   MPI_Init(&argc, &argv);
+   // Mpi parameters initilization; only the main thread calls MPI, the
+   // stdpar and I/O threads do not
+   int thread_level;
+   MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_level);
    int rank, size;
    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
    MPI_Comm_size(MPI_COMM_WORLD, &size);
+   if (!rank && thread_level < MPI_THREAD_FUNNELED)
+      std::cout << "warning : MPI provides no MPI_THREAD_FUNNELED support" << std::endl;
 
    // Parameters from the command line
    string file;
    string output_file;
    size_t itime;
    real_t dt, qnc, qnc_1;
+   const io_muphys::options_t options =
+       io_muphys::parse_options(argc, argv, rank == 0);
+   io_muphys::check_options_mpi(options);
+   if (!options.trace_file.empty()) {
+#ifndef MU_TRACE
+      throw std::invalid_argument("--trace needs MU_ENABLE_TRACE");
+#endif
+      utils_muphys::trace_start();
+   }
+#ifndef MU_ACTIVITY_STATS
+   if (!options.activity_file.empty())
+      throw std::invalid_argument("--activity needs MU_ENABLE_ACTIVITY_STATS");
+#endif
+   // MPI-IO hints given as --mpi-hint=<key>=<value>
+   MPI_Info info = io_muphys::make_mpi_info(options);
+   // --bind=numa pins the threads before the first parallel algorithm
+   io_muphys::rank_placement_t placement = io_muphys::bind_ranks(options.bind);
+   io_muphys::report_topology(placement, thread_level);
+   // the first rank of every node reads the RAPL counters of the node
+   std::unique_ptr<utils_muphys::energy_meter> meter;
+   if (options.energy && placement.node_rank == 0) {
+      meter = std::make_unique<utils_muphys::energy_meter>();
+      if (!rank && !meter->status().empty())
+         std::cout << "energy : " << meter->status() << std::endl;
+   }
+   utils_muphys::energy_account energy(meter.get());
+   io_muphys::io_timing_t read_timing, write_timing;
+   // wall time of the phases on this rank, reduced over all ranks at the end
+   double read_seconds = 0.0, dz_seconds = 0.0, kernel_seconds = 0.0;
+   double rebalance_seconds = 0.0, write_seconds = 0.0;
+   double send_wait_seconds = 0.0, receive_seconds = 0.0;
+   size_t noutputs = 0;
    
    if (!rank)
       io_muphys::parse_args_mpi_rank0(file, output_file, itime, dt, qnc, argc, argv);
@@ -43,41 +91,13 @@ int main(int argc, char *argv[]) {
 
    // Parameters from the input file
    size_t ncells, nlev;
-   array_1d_t<real_t> z, t, p, rho, qv, qc, qi, qr, qs, qg;
-
-   // Pre-calculated parameters
-   array_1d_t<real_t> dz;
-   // Extra fields required to call graupel
-   array_1d_t<real_t> pflx, prr_gsp, pri_gsp, prs_gsp, prg_gsp, pre_gsp;
+   // Input, output and pre-calculated fields of the local block in one tensor
+   State state;
    // start-end indices
    size_t kend, kbeg, ivend, ivbeg, nvec;
 
    const string input_file = file;
 
-   io_muphys::read_fields_mpi(input_file, itime, ncells, nlev, z, t, p, rho, qv, qc, qi, qr, qs, qg);
-
-   size_t base = ncells / size;
-   size_t rem  = ncells % size;
-   size_t ncell_loc = base + (rank < rem ? 1 : 0);
-   size_t start_cell = rank * base + std::min(rank, (int)rem);
-
-   utils_muphys::calc_dz(z, dz, ncell_loc, nlev);
-
-   prr_gsp.resize(ncell_loc, ZERO);
-   pri_gsp.resize(ncell_loc, ZERO);
-   prs_gsp.resize(ncell_loc, ZERO);
-   prg_gsp.resize(ncell_loc, ZERO);
-   pre_gsp.resize(ncell_loc, ZERO);
-   pflx.resize(ncell_loc * nlev, ZERO);
-
-   kbeg = 0;
-   kend = nlev;
-   ivbeg = 0;
-   ivend = ncell_loc;
-   nvec = ncell_loc;
-   qnc_1 = qnc;
-   
-
    size_t multirun = 0;
 
    if (std::getenv("MULTI_GRAUPEL")){
@@ -90,21 +110,467 @@ int main(int argc, char *argv[]) {
    if (!rank)
       std::cout << "multirun =" << multirun << std::endl;
 
-   auto start_time = std::chrono::steady_clock::now();
-   for (size_t ii = 0; ii < multirun; ++ii){
-      graupel(nvec, kend, ivbeg, ivend, kbeg, dt, dz, t, rho, p, qv, qc, qi, qr, qs,
-              qg, qnc_1, prr_gsp, pri_gsp, prs_gsp, prg_gsp, pre_gsp, pflx);
-   }                     
-   auto end_time = std::chrono::steady_clock::now();
-   io_muphys::write_fields_mpi(output_file, ncells, nlev, t, qv, qc, qi, qr, qs,
-         qg, prr_gsp, pri_gsp, prs_gsp, prg_gsp, pre_gsp, pflx);
-   
-   //auto end_time = std::chrono::steady_clock::now();
-   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-             end_time - start_time);
+   // write a snapshot every MU_OUTPUT_INTERVAL steps, 0 only writes the end
+   size_t output_interval = 0;
+   if (std::getenv("MU_OUTPUT_INTERVAL")) {
+      output_interval = atoi(std::getenv("MU_OUTPUT_INTERVAL"));
+   }
+   auto is_snapshot_step = [&](size_t step) {
+      return output_interval > 0 && step % output_interval == 0 && step < multirun;
+   };
+   // migrate the cells by the measured kernel time every --rebalance steps
+   auto is_rebalance_step = [&](size_t step) {
+      return options.rebalance_interval > 0 &&
+             step % options.rebalance_interval == 0 && step < multirun;
+   };
+
+   // the trailing --io-tasks ranks only receive and write the output
+   io_muphys::io_layout_t layout = io_muphys::split_io_ranks(options.io_tasks);
+   int local_rank, local_size;
+   MPI_Comm_rank(layout.local, &local_rank);
+   MPI_Comm_size(layout.local, &local_size);
+   uint64_t dims[2];
+
+   const bool activity_partition = options.partition == "activity";
+
+   if (layout.is_io) {
+      // grid size and cell blocks from the first compute rank
+      MPI_Bcast(dims, 2, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+      ncells = dims[0];
+      nlev = dims[1];
+
+      std::vector<io_muphys::cell_block_t> blocks(layout.ncompute);
+      if (activity_partition) {
+         io_muphys::bcast_blocks(blocks, 0, MPI_COMM_WORLD);
+      }
+      else {
+         for (int c = 0; c < layout.ncompute; ++c)
+            blocks[c] = io_muphys::even_block(ncells, c, layout.ncompute);
+      }
+      io_muphys::io_server server(layout, blocks, ncells, nlev);
+
+      // same sequence of snapshots and migrations as the compute ranks
+      for (size_t step = 1; step < multirun; ++step) {
+         if (is_snapshot_step(step)) {
+            energy.begin();
+            server.write(io_muphys::step_file_name(output_file, step), options, info);
+            energy.end("write");
+         }
+         if (is_rebalance_step(step)) {
+            io_muphys::bcast_blocks(blocks, 0, MPI_COMM_WORLD);
+            server.set_blocks(blocks);
+         }
+      }
+      energy.begin();
+      server.write(output_file, options, info);
+      energy.end("write");
+
+      const io_muphys::io_timing_t server_timing = server.timing();
+      write_seconds = server_timing.open + server_timing.data + server_timing.close;
+      receive_seconds = server.receive_seconds();
+      double receive_max, receive = receive_seconds;
+      MPI_Reduce(&receive, &receive_max, 1, MPI_DOUBLE, MPI_MAX, 0, layout.local);
+      if (!local_rank)
+         std::cout << "receive [s] max : " << receive_max << std::endl;
+      io_muphys::report_io_timing("write", server.timing(), layout.local);
+   }
+   else {
+      // with --node-io one rank per node reads into shared memory and the
+      // state of every rank is bound to its slice
+      std::unique_ptr<io_muphys::node_stage> stage;
+      energy.begin();
+      const double read_start = MPI_Wtime();
+      if (options.node_io) {
+         stage = std::make_unique<io_muphys::node_stage>(layout.local);
+         stage->read(input_file, itime, ncells, nlev, state, info, options, &read_timing);
+      }
+      else {
+         io_muphys::read_fields_mpi(input_file, itime, ncells, nlev, state,
+                                    layout.local, info, options, &read_timing);
+      }
+      read_seconds = MPI_Wtime() - read_start;
+      energy.end("read");
+      std::vector<io_muphys::cell_block_t> blocks;
+      for (int c = 0; c < local_size; ++c)
+         blocks.push_back(io_muphys::even_block(ncells, c, local_size));
+      // the output is written from the even blocks in file order
+      const std::vector<io_muphys::cell_block_t> file_blocks = blocks;
+
+      // with --order the blocks and the cells within them follow a
+      // space-filling curve through the cell centres; blocks index the
+      // cells in curve order and the output is permuted back to file order.
+      // Rank 0 sorts the cells, every rank keeps the file index of its
+      // curve block and the curve position of its file block.
+      const bool ordered = options.cell_order != "file";
+      std::vector<uint64_t> file_of_curve, curve_of_file;
+      if (ordered) {
+         std::vector<uint64_t> order, inverse;
+         if (!local_rank) {
+            std::vector<double> clon, clat;
+            io_muphys::read_cell_coordinates_mpi(input_file, clon, clat,
+                                                 MPI_COMM_SELF, info);
+            if (clon.size() != ncells)
+               throw std::runtime_error("clon does not match the cells of the input");
+            order = io_muphys::curve_order(clon, clat, options.cell_order);
+            inverse = io_muphys::inverse_order(order);
+         }
+         file_of_curve = io_muphys::scatter_order(order, blocks, 0, layout.local);
+         curve_of_file = io_muphys::scatter_order(inverse, file_blocks, 0, layout.local);
+         state = io_muphys::permute_cells(state, file_blocks, blocks,
+                                          curve_of_file.data(),
+                                          file_of_curve.data(), layout.local);
+      }
+      io_muphys::cell_block_t block = blocks[local_rank];
+
+      if (activity_partition) {
+         // cost of the even blocks from the active levels of the input, then
+         // the cells move to blocks of equal cost
+         std::vector<std::uint32_t> active(block.count);
+         utils_muphys::active_levels(state, block.count, nlev, active.data());
+         const double even_imbalance =
+             io_muphys::cost_imbalance(active.data(), block.count, layout.local);
+         std::vector<io_muphys::cell_block_t> next = io_muphys::balanced_blocks(
+             active.data(), block.count, ncells, layout.local);
+         io_muphys::migrate_cells(state, blocks, next, layout.local);
+         if (ordered)
+            io_muphys::migrate_order(file_of_curve, blocks, next, layout.local);
+         blocks = std::move(next);
+         block = blocks[local_rank];
+
+         active.resize(block.count);
+         utils_muphys::active_levels(state, block.count, nlev, active.data());
+         const double activity_imbalance =
+             io_muphys::cost_imbalance(active.data(), block.count, layout.local);
+         if (!local_rank)
+            std::cout << "cost imbalance (max/mean) : even " << even_imbalance
+                      << ", activity " << activity_imbalance << std::endl;
+      }
+
+      // the permutation and the migration leave the shared window
+      if (stage && (ordered || activity_partition))
+         stage->bind(state);
+
+      // blocks of the output in file order, also those of the I/O ranks
+      auto output_blocks = [&]() { return ordered ? file_blocks : blocks; };
+      if (layout.nio > 0) {
+         dims[0] = ncells;
+         dims[1] = nlev;
+         MPI_Bcast(dims, 2, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+         if (activity_partition) {
+            std::vector<io_muphys::cell_block_t> bcast = output_blocks();
+            io_muphys::bcast_blocks(bcast, 0, MPI_COMM_WORLD);
+         }
+      }
+
+      size_t ncell_loc = block.count;
+
+#ifndef MU_DZ_ON_THE_FLY
+      // z is replaced by the layer thickness in place; otherwise the kernel
+      // derives it column by column from z
+      energy.begin();
+      const double dz_start = MPI_Wtime();
+      {
+         MU_TRACE_SCOPE("calc_dz");
+         utils_muphys::calc_dz(state.field(fld::dz), state.field(fld::dz), ncell_loc, nlev);
+      }
+      dz_seconds = MPI_Wtime() - dz_start;
+      energy.end("calc_dz");
+#endif
+
+      kbeg = 0;
+      kend = nlev;
+      ivbeg = 0;
+      ivend = ncell_loc;
+      nvec = ncell_loc;
+      qnc_1 = qnc;
+
+      // with I/O ranks the output is shipped with non-blocking sends,
+      // otherwise the compute ranks write it themselves
+      std::unique_ptr<io_muphys::io_client> client;
+      if (layout.nio > 0)
+         client = std::make_unique<io_muphys::io_client>(
+             layout, output_blocks()[local_rank].count, nlev);
+      // where the kernel had work, summed over the compute ranks per step
+      std::unique_ptr<io_muphys::activity_log> activity;
+      if (!options.activity_file.empty() && !local_rank)
+         activity = std::make_unique<io_muphys::activity_log>(
+             options.activity_file, ncells, nlev);
+      auto log_activity = [&](size_t step) {
+         if (options.activity_file.empty())
+            return;
+         const utils_muphys::activity_t sum = io_muphys::reduce_activity(
+             utils_muphys::activity_stats(), layout.local);
+         if (activity)
+            activity->write(step, sum);
+         utils_muphys::activity_stats().reset(nlev);
+      };
+      auto output = [&](const string &file_name) {
+         MU_TRACE_SCOPE("output");
+         energy.begin();
+         State file_state;
+         if (ordered)
+            file_state = io_muphys::permute_cells(state, blocks, file_blocks,
+                                                  file_of_curve.data(),
+                                                  curve_of_file.data(), layout.local);
+         const State &out = ordered ? file_state : state;
+         ++noutputs;
+         if (client) {
+            client->send(out);
+            energy.end("write");
+            return;
+         }
+         io_muphys::io_timing_t t;
+         const io_muphys::cell_block_t out_block = output_blocks()[local_rank];
+         if (stage)
+            stage->write(file_name, ncells, nlev, out, out_block, options, info, &t);
+         else
+            io_muphys::write_fields_mpi(file_name, ncells, nlev, out, options,
+                                        layout.local, info, &t, &out_block);
+         write_timing.open += t.open;
+         write_timing.data += t.data;
+         write_timing.close += t.close;
+         energy.end("write");
+      };
+
+      // the kernel time of the last window is spread over the cells in
+      // proportion to 1 + active levels, then the cells move to the blocks
+      // of equal cost
+      double kernel_time = 0.0;
+      auto rebalance = [&](size_t step) {
+         MU_TRACE_SCOPE("rebalance");
+         energy.begin();
+         const double rebalance_start = MPI_Wtime();
+         std::vector<std::uint32_t> active(ncell_loc);
+         utils_muphys::active_levels(state, ncell_loc, nlev, active.data());
+         double weight = 0.0;
+         for (size_t i = 0; i < ncell_loc; ++i)
+            weight += 1.0 + active[i];
+         std::vector<double> cost(ncell_loc);
+         for (size_t i = 0; i < ncell_loc; ++i)
+            cost[i] = weight > 0.0 ? kernel_time * (1.0 + active[i]) / weight : 0.0;
+
+         std::vector<io_muphys::cell_block_t> next =
+             io_muphys::balanced_blocks(cost.data(), ncell_loc, ncells, layout.local);
+         const std::vector<double> before =
+             io_muphys::block_costs(cost.data(), block, blocks, layout.local);
+         const std::vector<double> after =
+             io_muphys::block_costs(cost.data(), block, next, layout.local);
+         unsigned long long moved =
+             io_muphys::migrate_cells(state, blocks, next, layout.local);
+         if (ordered)
+            io_muphys::migrate_order(file_of_curve, blocks, next, layout.local);
+         if (stage)
+            stage->bind(state);
+         MPI_Allreduce(MPI_IN_PLACE, &moved, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+                       layout.local);
+         blocks = std::move(next);
+         block = blocks[local_rank];
+         ncell_loc = block.count;
+         ivend = ncell_loc;
+         nvec = ncell_loc;
+         if (layout.nio > 0) {
+            std::vector<io_muphys::cell_block_t> bcast = output_blocks();
+            io_muphys::bcast_blocks(bcast, 0, MPI_COMM_WORLD);
+         }
+         // with a curve order the output stays in the even file blocks
+         if (client && !ordered)
+            client->resize(ncell_loc);
+         kernel_time = 0.0;
+         rebalance_seconds += MPI_Wtime() - rebalance_start;
+         energy.end("rebalance");
+
+         auto imbalance = [](const std::vector<double> &c) {
+            double sum = 0.0, max = 0.0;
+            for (double x : c) {
+               sum += x;
+               max = std::max(max, x);
+            }
+            return sum > 0.0 ? max * c.size() / sum : 1.0;
+         };
+         if (!local_rank)
+            std::cout << "rebalance step " << step << " : imbalance (max/mean) "
+                      << imbalance(before) << " -> " << imbalance(after)
+                      << ", moved " << moved << " cells" << std::endl;
+      };
+
+      auto start_time = std::chrono::steady_clock::now();
+      for (size_t ii = 0; ii < multirun; ++ii){
+         MU_TRACE_SCOPE("step");
+         energy.begin();
+         const double t0 = MPI_Wtime();
+         graupel(nvec, kend, ivbeg, ivend, kbeg, dt, state, qnc_1);
+         kernel_time += MPI_Wtime() - t0;
+         kernel_seconds += MPI_Wtime() - t0;
+         energy.end("kernel");
+         log_activity(ii + 1);
+         if (is_snapshot_step(ii + 1))
+            output(io_muphys::step_file_name(output_file, ii + 1));
+         if (is_rebalance_step(ii + 1))
+            rebalance(ii + 1);
+      }
+      auto end_time = std::chrono::steady_clock::now();
+      output(output_file);
+      if (client) {
+         energy.begin();
+         client->finish();
+         energy.end("write");
+      }
+
+      auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                end_time - start_time);
+      if (!rank) {
+         std::cout << "time taken : " << duration.count() << " milliseconds" << std::endl;
+         // dz replaces z in its slot of the state, and with MU_DZ_ON_THE_FLY
+         // the dz scratch column lives in pflx, so the state is the whole
+         // footprint
+         std::cout << "state : " << state.size() * sizeof(real_t) / (1024 * 1024)
+                   << " MB, dz in place of z, dz scratch in pflx (rank 0)" << std::endl;
+         std::cout << "dz traffic : "
+                   << utils_muphys::dz_traffic_bytes(ncell_loc, nlev, multirun) / (1024 * 1024)
+                   << " MB (" << utils_muphys::dz_mode << ", rank 0)" << std::endl;
+         std::cout << "peak memory : " << utils_muphys::peak_memory() / (1024 * 1024) << " MB (rank 0)" << std::endl;
+      }
+      io_muphys::report_io_timing("read", read_timing, layout.local);
+      write_seconds = write_timing.open + write_timing.data + write_timing.close;
+      if (client) {
+         send_wait_seconds = client->wait_seconds();
+         double wait_max, wait = send_wait_seconds;
+         MPI_Reduce(&wait, &wait_max, 1, MPI_DOUBLE, MPI_MAX, 0, layout.local);
+         if (!local_rank)
+            std::cout << "send wait [s] max : " << wait_max << std::endl;
+      }
+      else {
+         io_muphys::report_io_timing("write", write_timing, layout.local);
+      }
+   }
+
+   // min, mean, max and stddev of the phases over the ranks that run them,
+   // the imbalance max/mean and the effective bandwidth of the I/O
+   const bool compute = !layout.is_io;
+   const bool writer = layout.nio > 0 ? layout.is_io : compute;
+   const struct {
+      const char *name;
+      double seconds;
+      bool participates;
+   } phases[] = {{"read", read_seconds, compute},
+                 {"calc_dz", dz_seconds, compute},
+                 {"kernel", kernel_seconds, compute},
+                 {"rebalance", rebalance_seconds, compute && options.rebalance_interval > 0},
+                 {"write", write_seconds, writer},
+                 {"send_wait", send_wait_seconds, compute && layout.nio > 0},
+                 {"receive", receive_seconds, layout.is_io}};
+   io_muphys::report_t report;
+   std::vector<io_muphys::stats_t> stats;
+   for (const auto &phase : phases)
+      stats.push_back(io_muphys::reduce_stats(phase.seconds, phase.participates,
+                                              MPI_COMM_WORLD));
+   if (!rank) {
+      // 9 timed fields and zg are read, 8 fields and 5 surface fields written
+      const double read_bytes = 10.0 * nlev * ncells * sizeof(real_t);
+      const double write_bytes =
+          (8.0 * nlev + 5.0) * ncells * sizeof(real_t) * noutputs;
+      report.set("run", "", "ranks", size);
+      report.set("run", "", "compute_ranks", layout.ncompute);
+      report.set("run", "", "io_ranks", layout.nio);
+      report.set("run", "", "ncells", ncells);
+      report.set("run", "", "nlev", nlev);
+      report.set("run", "", "steps", multirun);
+      report.set("run", "", "outputs", noutputs);
+      report.set("run", "", "precision", sizeof(real_t) == 4 ? "single" : "double");
+      for (size_t p = 0; p < stats.size(); ++p) {
+         if (stats[p].count == 0)
+            continue;
+         std::cout << "phase " << phases[p].name << " [s] min/mean/max/stddev : "
+                   << stats[p].min << " " << stats[p].mean << " " << stats[p].max
+                   << " " << stats[p].stddev << " imbalance "
+                   << stats[p].imbalance() << std::endl;
+         report.set("phases", phases[p].name, stats[p]);
+      }
+      auto bandwidth = [](double bytes, double seconds) {
+         return seconds > 0.0 ? bytes / seconds / 1e9 : 0.0;
+      };
+      const double read_bw = bandwidth(read_bytes, stats[0].max);
+      const double write_bw = bandwidth(write_bytes, stats[4].max);
+      std::cout << "bandwidth [GB/s] read : " << read_bw << ", write : "
+                << write_bw << std::endl;
+      report.set("bandwidth", "read", "bytes", read_bytes);
+      report.set("bandwidth", "read", "GB/s", read_bw);
+      report.set("bandwidth", "write", "bytes", write_bytes);
+      report.set("bandwidth", "write", "GB/s", write_bw);
+   }
+
+#ifdef MU_PHASE_TIMERS
+   // kernel phases: spread over the compute ranks, and the totals with the
+   // slowest rank as the time of every phase
+   const utils_muphys::phase_stats_t &local_phases = utils_muphys::phase_stats();
+   utils_muphys::phase_stats_t kernel_phases;
+   MPI_Reduce(local_phases.seconds, kernel_phases.seconds, phase::n, MPI_DOUBLE,
+              MPI_MAX, 0, MPI_COMM_WORLD);
+   MPI_Reduce(local_phases.points, kernel_phases.points, phase::n, MPI_UINT64_T,
+              MPI_SUM, 0, MPI_COMM_WORLD);
+   MPI_Reduce(local_phases.bytes, kernel_phases.bytes, phase::n, MPI_DOUBLE,
+              MPI_SUM, 0, MPI_COMM_WORLD);
+   MPI_Reduce(&local_phases.active_points, &kernel_phases.active_points, 1,
+              MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+   MPI_Reduce(&local_phases.precip_columns, &kernel_phases.precip_columns, 1,
+              MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+   MPI_Reduce(&local_phases.calls, &kernel_phases.calls, 1, MPI_UINT64_T,
+              MPI_MAX, 0, MPI_COMM_WORLD);
+#ifdef MU_PERF_COUNTERS
+   // hardware events summed over the ranks, of those counted on all ranks
+   MPI_Reduce(&local_phases.events[0][0], &kernel_phases.events[0][0],
+              phase::n * perf::n, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+   unsigned perf_events = compute ? local_phases.perf_events : ~0u;
+   MPI_Reduce(&perf_events, &kernel_phases.perf_events, 1, MPI_UNSIGNED,
+              MPI_BAND, 0, MPI_COMM_WORLD);
+#endif
+   for (size_t p = 0; p < phase::n; ++p) {
+      const io_muphys::stats_t kernel_stats = io_muphys::reduce_stats(
+          local_phases.seconds[p], compute, MPI_COMM_WORLD);
+      if (rank || kernel_phases.points[p] == 0)
+         continue;
+      std::cout << "kernel phase " << phase::names[p]
+                << " [s] min/mean/max/stddev : " << kernel_stats.min << " "
+                << kernel_stats.mean << " " << kernel_stats.max << " "
+                << kernel_stats.stddev << " imbalance "
+                << kernel_stats.imbalance() << std::endl;
+      report.set("phases", std::string("kernel.") + phase::names[p], kernel_stats);
+   }
    if (!rank)
-      std::cout << "time taken : " << duration.count() << " milliseconds" << std::endl;
+      io_muphys::report_phases(report, kernel_phases);
+#endif
+
+   if (options.energy) {
+      // one measuring rank per node, so the sums are those of the nodes
+      const utils_muphys::energy_summary_t energy_summary = io_muphys::reduce_energy(
+          energy.summary({"read", "calc_dz", "kernel", "rebalance", "write"}),
+          meter != nullptr, MPI_COMM_WORLD);
+      const double cell_steps = 1.0 * ncells * multirun;
+      if (!rank) {
+         io_muphys::print_energy(energy_summary, cell_steps);
+         io_muphys::report_energy(report, energy_summary, cell_steps);
+      }
+   }
+
+   if (!rank && !options.report_file.empty())
+      report.write(options.report_file);
+
+   if (!options.trace_file.empty()) {
+      utils_muphys::trace_stop();
+      unsigned long long dropped = utils_muphys::trace_dropped();
+      MPI_Allreduce(MPI_IN_PLACE, &dropped, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+                    MPI_COMM_WORLD);
+      io_muphys::write_trace_mpi(options.trace_file, MPI_COMM_WORLD);
+      if (!rank)
+         std::cout << "trace : " << options.trace_file << ", " << dropped
+                   << " events dropped" << std::endl;
+   }
+
+   if (info != MPI_INFO_NULL)
+      MPI_Info_free(&info);
+   MPI_Comm_free(&layout.local);
+   MPI_Comm_free(&placement.node);
 
    MPI_Finalize();
    return 0;
-}
\ No newline at end of file
+}
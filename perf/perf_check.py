@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+# ICON
+#
+# ---------------------------------------------------------------
+# Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+# Contact information: icon-model.org
+#
+# See AUTHORS.TXT for a list of authors
+# See LICENSES/ for license information
+# SPDX-License-Identifier: BSD-3-Clause
+# ---------------------------------------------------------------
+"""
+Performance check of one benchmark against a stored baseline.
+
+Runs the command (with --report=<file> appended) --repeat times, takes the
+median of every metric over the runs and compares it with the baseline
+entry of the test. Metrics are times, lower is better, and are given as
+section/name/field paths into the report, e.g. bench/seconds/median or
+io/read_seconds.
+
+The noise of a metric is its relative median absolute deviation over the
+runs and, for a latency median, the spread (p90 - median) / median of the
+iterations. A metric regresses if it is slower than the baseline by more
+than max(tolerance, 3 * noise), with the larger noise of baseline and run:
+
+  * above the --fail tolerance the check fails (exit code 1),
+  * above the --warn tolerance it prints a warning and passes.
+
+Baselines are only comparable on the CPU they were recorded on; against
+the baseline of another CPU, failures are reported as warnings.
+MU_PERF_UPDATE=1 (or --update) stores the run as the new baseline entry.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+
+
+def cpu_model():
+    try:
+        with open('/proc/cpuinfo') as cpuinfo:
+            for line in cpuinfo:
+                if line.startswith('model name'):
+                    return line.split(':', 1)[1].strip()
+    except OSError:
+        pass
+    return platform.processor() or platform.machine()
+
+
+def lookup(report, path):
+    """value at section/name/field, or section/field for an empty name"""
+    value = report
+    for key in path.split('/'):
+        if not isinstance(value, dict) or key not in value:
+            return None
+        value = value[key]
+    return value if isinstance(value, (int, float)) else None
+
+
+def spread(values):
+    """relative median absolute deviation"""
+    median = statistics.median(values)
+    if median <= 0.0:
+        return 0.0
+    return statistics.median(abs(v - median) for v in values) / median
+
+
+def run(command, repeat, metrics):
+    samples = {metric: [] for metric in metrics}
+    noise = {metric: 0.0 for metric in metrics}
+    with tempfile.TemporaryDirectory() as tmp:
+        report_file = os.path.join(tmp, 'report.json')
+        for _ in range(repeat):
+            result = subprocess.run(command + ['--report=' + report_file],
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT, text=True)
+            if result.returncode != 0:
+                sys.stdout.write(result.stdout)
+                raise RuntimeError('benchmark failed with exit code %d'
+                                   % result.returncode)
+            with open(report_file) as infile:
+                report = json.load(infile)
+            for metric in metrics:
+                value = lookup(report, metric)
+                if value is None:
+                    raise RuntimeError('no metric %s in the report' % metric)
+                samples[metric].append(float(value))
+                # spread of the iterations of a replay benchmark
+                if metric.endswith('/median'):
+                    p90 = lookup(report, metric[:-len('median')] + 'p90')
+                    if p90 is not None and value > 0.0:
+                        noise[metric] = max(noise[metric],
+                                            (p90 - value) / value)
+    current = {}
+    for metric in metrics:
+        current[metric] = {
+            'value': statistics.median(samples[metric]),
+            'noise': max(noise[metric], spread(samples[metric])),
+        }
+    return current
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--name', required=True, help='test name')
+    parser.add_argument('--baseline', required=True, help='baseline JSON')
+    parser.add_argument('--metric', action='append', required=True,
+                        help='section/name/field of the report, repeatable')
+    parser.add_argument('--repeat', type=int, default=1)
+    parser.add_argument('--warn', type=float, default=0.05)
+    parser.add_argument('--fail', type=float, default=0.15)
+    parser.add_argument('--update', action='store_true')
+    parser.add_argument('command', nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+    command = args.command[1:] if args.command[:1] == ['--'] else args.command
+    if not command:
+        parser.error('no benchmark command')
+    update = args.update or os.environ.get('MU_PERF_UPDATE', '0') == '1'
+
+    current = run(command, max(args.repeat, 1), args.metric)
+
+    baseline = {'tests': {}}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as infile:
+            baseline = json.load(infile)
+    entry = baseline.get('tests', {}).get(args.name)
+
+    if update:
+        baseline.setdefault('tests', {})[args.name] = {
+            'cpu': cpu_model(),
+            'date': datetime.date.today().isoformat(),
+            'metrics': current,
+        }
+        with open(args.baseline, 'w') as outfile:
+            json.dump(baseline, outfile, indent=2, sort_keys=True)
+            outfile.write('\n')
+        for metric, now in current.items():
+            print('%s %s: %.6g (noise %.1f%%) stored'
+                  % (args.name, metric, now['value'], 100 * now['noise']))
+        return 0
+
+    if entry is None:
+        for metric, now in current.items():
+            print('%s %s: %.6g (noise %.1f%%), no baseline'
+                  % (args.name, metric, now['value'], 100 * now['noise']))
+        return 0
+
+    same_cpu = entry.get('cpu') == cpu_model()
+    if not same_cpu:
+        print('WARNING: baseline recorded on %s, running on %s; regressions '
+              'are only warnings' % (entry.get('cpu'), cpu_model()))
+
+    failed = False
+    for metric, now in current.items():
+        base = entry.get('metrics', {}).get(metric)
+        if base is None or base['value'] <= 0.0:
+            print('%s %s: %.6g, no baseline' % (args.name, metric, now['value']))
+            continue
+        change = now['value'] / base['value'] - 1.0
+        noise = max(base.get('noise', 0.0), now['noise'])
+        warn_limit = max(args.warn, 3 * noise)
+        fail_limit = max(args.fail, 3 * noise)
+        status = 'ok'
+        if change > fail_limit and same_cpu:
+            status = 'FAILED'
+            failed = True
+        elif change > warn_limit:
+            status = 'WARNING'
+        elif change < -warn_limit:
+            status = 'faster, consider MU_PERF_UPDATE=1'
+        print('%s %s: %.6g vs baseline %.6g (%+.1f%%, noise %.1f%%, '
+              'limits %.1f%%/%.1f%%) %s'
+              % (args.name, metric, now['value'], base['value'], 100 * change,
+                 100 * noise, 100 * warn_limit, 100 * fail_limit, status))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    try:
+        sys.exit(main())
+    except RuntimeError as error:
+        print('%s' % error)
+        sys.exit(1)
@@ -152,6 +152,11 @@ fi
 
 #----------------------------------------------------------- nvsmi-logger --------------------------------------------
 
-numactl --cpunodebind=${numanode_reorder[$lrank]} --membind=${numanode_reorder[$lrank]} $executable $input_file $output_file
+# thread placement for --bind=numa; the driver can only set these after
+# MPI_Init_thread, which may be too late for the OpenMP runtime
+export OMP_PROC_BIND=${OMP_PROC_BIND:-close}
+export OMP_PLACES=${OMP_PLACES:-cores}
+
+numactl --cpunodebind=${numanode_reorder[$lrank]} --membind=${numanode_reorder[$lrank]} $executable --io-tasks=${io_tasks} $input_file $output_file
 
 kill_nvsmi
@@ -0,0 +1,71 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "synth/synth.hpp"
+
+/* muphys_synth <output.nc> [--ncells=<n>] [--nlev=<n>] [--active=<0..1>]
+ *              [--mix=<tropical>:<midlatitude>:<dry>] [--seed=<n>]
+ *              [--block=<cells>] */
+int main(int argc, char *argv[]) {
+  synth_muphys::synth_options_t options;
+  std::string output_file;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg.rfind("--", 0) != 0) {
+        if (!output_file.empty())
+          throw std::invalid_argument("more than one output file");
+        output_file = arg;
+        continue;
+      }
+      const size_t eq = arg.find('=');
+      if (eq == std::string::npos)
+        throw std::invalid_argument(arg + " expects --<key>=<value>");
+      synth_muphys::set_option(options, arg.substr(2, eq - 2), arg.substr(eq + 1));
+    }
+    if (output_file.empty())
+      throw std::invalid_argument("no output file");
+  } catch (const std::exception &e) {
+    std::cerr << "muphys_synth: " << e.what() << "\n"
+              << "usage: muphys_synth <output.nc> [--ncells=<n>] [--nlev=<n>] "
+                 "[--active=<0..1>] [--mix=<tropical>:<midlatitude>:<dry>] "
+                 "[--seed=<n>] [--block=<cells>]"
+              << std::endl;
+    return 1;
+  }
+
+  size_t columns[synth_muphys::regime::n] = {}, cloudy_columns = 0;
+  for (size_t cell = 0; cell < options.ncells; ++cell) {
+    bool cloudy;
+    ++columns[synth_muphys::column_regime(options, cell, cloudy)];
+    cloudy_columns += cloudy;
+  }
+  std::cout << "cells : " << options.ncells << " x " << options.nlev
+            << " levels, seed " << options.seed << "\n"
+            << "columns tropical/midlatitude/dry : "
+            << columns[synth_muphys::regime::tropical] << " "
+            << columns[synth_muphys::regime::midlatitude] << " "
+            << columns[synth_muphys::regime::dry] << ", cloudy "
+            << cloudy_columns << std::endl;
+
+  auto start_time = std::chrono::steady_clock::now();
+  synth_muphys::write_synthetic(output_file, options);
+  auto end_time = std::chrono::steady_clock::now();
+  std::cout << "written " << output_file << " in "
+            << std::chrono::duration<double>(end_time - start_time).count()
+            << " s" << std::endl;
+  return 0;
+}
@@ -0,0 +1,307 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#include "synth.hpp"
+#include "../core/properties/thermo.hpp"
+#include "../io/io.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+constexpr double grav = 9.80665;   // gravitational acceleration (m/s2)
+constexpr double lapse = 0.0065;   // tropospheric lapse rate (K/m)
+constexpr double z_top = 30000.0;  // height of the model top (m)
+constexpr double p_surf = 101325.; // surface pressure (Pa)
+constexpr double pi = 3.14159265358979323846;
+
+/* splitmix64 stream of one column, seeded from the seed and the cell */
+struct rng_t {
+  std::uint64_t s;
+  rng_t(std::uint64_t seed, size_t cell, std::uint64_t salt)
+      : s(seed * 0x9E3779B97F4A7C15ull ^ (cell + 1) * 0xBF58476D1CE4E5B9ull ^
+          salt) {}
+  double uniform() {
+    std::uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<double>((z ^ (z >> 31)) >> 11) * 0x1.0p-53;
+  }
+  double uniform(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+};
+
+/* sine bump between base and top of a layer, 0 outside */
+double bump(double z, double base, double top) {
+  if (z <= base || z >= top)
+    return 0.0;
+  return std::sin(pi * (z - base) / (top - base));
+}
+
+/* full level height of level k, the levels get thinner towards the ground */
+double full_level_height(size_t k, size_t nlev) {
+  auto half = [nlev](size_t i) {
+    const double s = 1.0 - static_cast<double>(i) / nlev;
+    return z_top * s * s;
+  };
+  return 0.5 * (half(k) + half(k + 1));
+}
+
+/* profile of one column, every amplitude drawn from the column's stream */
+struct column_t {
+  double t_surf, z_trop, rh_surf;
+  bool cloudy;
+  size_t regime;
+  double base, top;               // cloud layer
+  double a_c, a_i, a_r, a_s, a_g; // condensate amplitudes
+};
+
+column_t make_column(const synth_muphys::synth_options_t &o, size_t cell) {
+  using namespace synth_muphys;
+  column_t c;
+  c.regime = column_regime(o, cell, c.cloudy);
+  rng_t rng(o.seed, cell, 0x5851F42D4C957F2Dull);
+  switch (c.regime) {
+  case regime::tropical:
+    c.t_surf = rng.uniform(298.0, 303.0);
+    c.z_trop = 16000.0;
+    c.rh_surf = 0.85;
+    c.base = rng.uniform(500.0, 1500.0);
+    c.top = rng.uniform(4000.0, 9000.0);
+    c.a_c = rng.uniform(2e-4, 1.5e-3);
+    c.a_i = rng.uniform(0.0, 1e-5);
+    c.a_r = rng.uniform(1e-5, 5e-4);
+    c.a_s = 0.0;
+    c.a_g = 0.0;
+    break;
+  case regime::midlatitude:
+    c.t_surf = rng.uniform(275.0, 290.0);
+    c.z_trop = 11000.0;
+    c.rh_surf = 0.75;
+    c.base = rng.uniform(1000.0, 3000.0);
+    c.top = rng.uniform(6000.0, 10000.0);
+    c.a_c = rng.uniform(1e-4, 5e-4);
+    c.a_i = rng.uniform(1e-6, 1e-4);
+    c.a_r = rng.uniform(1e-6, 2e-4);
+    c.a_s = rng.uniform(1e-5, 3e-4);
+    c.a_g = rng.uniform(1e-6, 1e-4);
+    break;
+  default:
+    c.t_surf = rng.uniform(285.0, 305.0);
+    c.z_trop = 12000.0;
+    c.rh_surf = 0.25;
+    c.base = c.top = 0.0;
+    c.a_c = c.a_i = c.a_r = c.a_s = c.a_g = 0.0;
+  }
+  return c;
+}
+
+} // namespace
+
+size_t synth_muphys::column_regime(const synth_options_t &options, size_t cell,
+                                   bool &cloudy) {
+  rng_t rng(options.seed, cell, 0);
+  const double total = options.mix[0] + options.mix[1] + options.mix[2];
+  const double u = rng.uniform() * total;
+  size_t r = u < options.mix[0]                    ? regime::tropical
+             : u < options.mix[0] + options.mix[1] ? regime::midlatitude
+                                                   : regime::dry;
+  if (options.mix[r] == 0.0) // u at a boundary of an empty regime
+    r = options.mix[regime::dry] > 0.0 ? regime::dry : regime::midlatitude;
+  // the cloudy columns are drawn from the wet regimes only
+  const double wet = (options.mix[0] + options.mix[1]) / total;
+  cloudy = r != regime::dry && wet > 0.0 &&
+           rng.uniform() < std::min(1.0, options.active / wet);
+  return r;
+}
+
+void synth_muphys::cell_coordinates(size_t cell, size_t ncells, double &clon,
+                                    double &clat) {
+  const double golden = 0.5 * (1.0 + std::sqrt(5.0));
+  clat = std::asin(1.0 - 2.0 * (cell + 0.5) / ncells);
+  clon = 2.0 * pi * std::fmod(cell / golden, 1.0) - pi;
+}
+
+void synth_muphys::set_option(synth_options_t &options, const std::string &key,
+                              const std::string &value) {
+  auto count = [&](size_t max) {
+    if (value.empty() || value[0] == '-')
+      throw std::invalid_argument(key + " expects a positive count");
+    const size_t n = std::stoul(value);
+    if (n == 0 || n > max)
+      throw std::invalid_argument(key + " must be in 1.." + std::to_string(max));
+    return n;
+  };
+  if (key == "ncells") {
+    options.ncells = count(size_t(1) << 40);
+  } else if (key == "nlev") {
+    options.nlev = count(4096);
+    if (options.nlev < 2)
+      throw std::invalid_argument("nlev must be at least 2");
+  } else if (key == "active") {
+    options.active = std::stod(value);
+    if (options.active < 0.0 || options.active > 1.0)
+      throw std::invalid_argument("active must be in 0..1");
+  } else if (key == "mix") {
+    const size_t c1 = value.find(':');
+    const size_t c2 = c1 == std::string::npos ? c1 : value.find(':', c1 + 1);
+    if (c2 == std::string::npos)
+      throw std::invalid_argument("mix expects <tropical>:<midlatitude>:<dry>");
+    options.mix[regime::tropical] = std::stod(value.substr(0, c1));
+    options.mix[regime::midlatitude] = std::stod(value.substr(c1 + 1, c2 - c1 - 1));
+    options.mix[regime::dry] = std::stod(value.substr(c2 + 1));
+    if (std::min({options.mix[0], options.mix[1], options.mix[2]}) < 0.0 ||
+        options.mix[0] + options.mix[1] + options.mix[2] <= 0.0)
+      throw std::invalid_argument("mix weights must not be negative or all 0");
+  } else if (key == "seed") {
+    options.seed = std::stoull(value);
+  } else if (key == "block") {
+    options.block = count(size_t(1) << 30);
+  } else {
+    throw std::invalid_argument("unknown synthetic option " + key);
+  }
+}
+
+synth_muphys::synth_options_t synth_muphys::parse_spec(const std::string &spec) {
+  synth_options_t options;
+  size_t begin = 0;
+  while (begin < spec.size()) {
+    size_t end = spec.find(',', begin);
+    if (end == std::string::npos)
+      end = spec.size();
+    const std::string item = spec.substr(begin, end - begin);
+    const size_t eq = item.find('=');
+    if (eq == std::string::npos)
+      throw std::invalid_argument("synthetic option " + item + " expects <key>=<value>");
+    set_option(options, item.substr(0, eq), item.substr(eq + 1));
+    begin = end + 1;
+  }
+  return options;
+}
+
+void synth_muphys::generate(const synth_options_t &options, size_t first,
+                            size_t count, State &state) {
+  if (first + count > options.ncells)
+    throw std::invalid_argument("cells beyond the synthetic grid");
+  const size_t nlev = options.nlev;
+  state.allocate(count, nlev);
+
+  for (size_t iv = 0; iv < count; ++iv) {
+    const column_t c = make_column(options, first + iv);
+    const double t_trop = c.t_surf - lapse * c.z_trop;
+    const double p_trop = p_surf * std::pow(t_trop / c.t_surf, grav / (thermodyn::rd * lapse));
+    // the melting level of the column
+    const double z_melt = (c.t_surf - thermodyn::tmelt) / lapse;
+
+    for (size_t k = 0; k < nlev; ++k) {
+      const size_t i = k * count + iv;
+      const double z = full_level_height(k, nlev);
+      double t, p;
+      if (z < c.z_trop) {
+        t = c.t_surf - lapse * z;
+        p = p_surf * std::pow(t / c.t_surf, grav / (thermodyn::rd * lapse));
+      } else {
+        t = t_trop;
+        p = p_trop * std::exp(-grav * (z - c.z_trop) / (thermodyn::rd * t_trop));
+      }
+      const real_t rho_dry = static_cast<real_t>(p / (thermodyn::rd * t));
+      const double qsat_w = thermo::qsat_rho(static_cast<real_t>(t), rho_dry);
+      const double qsat_i = thermo::qsat_ice_rho(static_cast<real_t>(t), rho_dry);
+      const double qsat = t >= thermodyn::tmelt ? qsat_w : qsat_i;
+
+      // humidity falls off with height, saturated over water inside clouds
+      double qv = c.rh_surf * (1.0 - 0.8 * std::min(z / c.z_trop, 1.0)) * qsat;
+      double qc = 0.0, qi = 0.0, qr = 0.0, qs = 0.0, qg = 0.0;
+      if (c.cloudy) {
+        const double b = bump(z, c.base, c.top);
+        if (b > 0.0) // slightly supersaturated over ice where it is cold
+          qv = std::max(qv, std::min(qsat_w, 1.1 * qsat_i));
+        if (t > graupel_ct::tfrz_hom)
+          qc = c.a_c * b;
+        if (t < thermodyn::tmelt - 5.0)
+          qi = c.a_i * b;
+        if (t < thermodyn::tmelt)
+          qs = c.a_s * b;
+        qg = c.a_g * bump(z, z_melt - 1500.0, z_melt + 1500.0) *
+             (z < c.top ? 1.0 : 0.0);
+        // rain falls from the cloud, and from the melting level in the
+        // mixed phase, and partly evaporates towards the ground
+        const double z_rain = c.regime == regime::tropical ? c.top
+                                                           : std::min(c.top, z_melt);
+        if (z < z_rain)
+          qr = c.a_r * (0.3 + 0.7 * z / z_rain);
+      }
+      const double rho =
+          p / (thermodyn::rd * t *
+               (1.0 + thermodyn::vtmpc1 * qv - qc - qi - qr - qs - qg));
+
+      state.field(fld::dz)[i] = static_cast<real_t>(z);
+      state.field(fld::t)[i] = static_cast<real_t>(t);
+      state.field(fld::p)[i] = static_cast<real_t>(p);
+      state.field(fld::rho)[i] = static_cast<real_t>(rho);
+      state.field(idx::lqv)[i] = static_cast<real_t>(qv);
+      state.field(idx::lqc)[i] = static_cast<real_t>(qc);
+      state.field(idx::lqi)[i] = static_cast<real_t>(qi);
+      state.field(idx::lqr)[i] = static_cast<real_t>(qr);
+      state.field(idx::lqs)[i] = static_cast<real_t>(qs);
+      state.field(idx::lqg)[i] = static_cast<real_t>(qg);
+    }
+  }
+}
+
+void synth_muphys::generate(const synth_options_t &options, State &state) {
+  generate(options, 0, options.ncells, state);
+}
+
+void synth_muphys::write_synthetic(const std::string &file,
+                                   const synth_options_t &options) {
+  const size_t ncells = options.ncells, nlev = options.nlev;
+  NcFile datafile(file, NcFile::replace);
+  NcDim time_dim = datafile.addDim("time", 1);
+  NcDim nlev_dim = datafile.addDim("height", nlev);
+  NcDim ncells_dim = datafile.addDim("ncells", ncells);
+  const std::vector<NcDim> dims = {nlev_dim, ncells_dim};
+  const std::vector<NcDim> timed_dims = {time_dim, nlev_dim, ncells_dim};
+
+  io_muphys::NCreal_t ncreal_t;
+  std::vector<NcVar> vars;
+  for (const auto &field : io_muphys::input_fields)
+    vars.push_back(datafile.addVar(field.name, ncreal_t,
+                                   field.timed ? timed_dims : dims));
+  NcDouble ncdouble;
+  NcVar clon_var = datafile.addVar("clon", ncdouble, ncells_dim);
+  NcVar clat_var = datafile.addVar("clat", ncdouble, ncells_dim);
+  clon_var.putAtt("units", "radian");
+  clat_var.putAtt("units", "radian");
+
+  // one block of columns in memory at a time
+  State state;
+  std::vector<double> clon, clat;
+  for (size_t first = 0; first < ncells; first += options.block) {
+    const size_t count = std::min(options.block, ncells - first);
+    generate(options, first, count, state);
+    for (size_t f = 0; f < vars.size(); ++f) {
+      const auto &field = io_muphys::input_fields[f];
+      if (field.timed)
+        vars[f].putVar({0, 0, first}, {1, nlev, count}, state.field(field.slot));
+      else
+        vars[f].putVar({0, first}, {nlev, count}, state.field(field.slot));
+    }
+    clon.resize(count);
+    clat.resize(count);
+    for (size_t iv = 0; iv < count; ++iv)
+      cell_coordinates(first + iv, ncells, clon[iv], clat[iv]);
+    clon_var.putVar({first}, {count}, clon.data());
+    clat_var.putVar({first}, {count}, clat.data());
+  }
+}
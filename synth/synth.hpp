@@ -0,0 +1,76 @@
+// ICON
+//
+// ---------------------------------------------------------------
+// Copyright (C) 2004-2024, DWD, MPI-M, DKRZ, KIT, ETH, MeteoSwiss
+// Contact information: icon-model.org
+//
+// See AUTHORS.TXT for a list of authors
+// See LICENSES/ for license information
+// SPDX-License-Identifier: BSD-3-Clause
+// ---------------------------------------------------------------
+//
+#pragma once
+#include "../core/common/state.hpp"
+#include "../core/common/types.hpp"
+#include <cstdint>
+#include <string>
+
+namespace synth_muphys {
+
+/* column regimes of the synthetic atmosphere */
+namespace regime {
+constexpr size_t tropical = 0;    // warm rain below the freezing level
+constexpr size_t midlatitude = 1; // mixed phase around the freezing level
+constexpr size_t dry = 2;         // clear sky, dry subsiding air
+constexpr size_t n = 3;
+} // namespace regime
+
+/* parameters of a synthetic input, given as <key>=<value> */
+struct synth_options_t {
+  size_t ncells = 20480;  // ncells=<n>, up to 10^8
+  size_t nlev = 90;       // nlev=<n>
+  double active = 0.3;    // active=<0..1>, fraction of columns with clouds
+  /* mix=<tropical>:<midlatitude>:<dry>, relative weights of the regimes */
+  double mix[regime::n] = {1.0, 1.0, 1.0};
+  std::uint64_t seed = 1; // seed=<n>
+  size_t block = 1 << 16; // block=<cells>, cells generated and written at once
+};
+
+/* sets the option key to value, throws std::invalid_argument */
+void set_option(synth_options_t &options, const std::string &key,
+                const std::string &value);
+
+/* ncells=1000,nlev=60,... as used by synth:<spec> inputs */
+synth_options_t parse_spec(const std::string &spec);
+
+/**
+ * @brief Synthetic input fields of the cells [first, first + count)
+ *
+ * The state is allocated for count cells and filled as read_fields leaves
+ * it, with the full level heights in the dz slot. Every column depends on
+ * the seed and its global index only, so blocks reproduce the columns of
+ * a whole grid.
+ */
+void generate(const synth_options_t &options, size_t first, size_t count,
+              State &state);
+
+/* all cells of the grid */
+void generate(const synth_options_t &options, State &state);
+
+/* regime of a column and whether it has clouds */
+size_t column_regime(const synth_options_t &options, size_t cell,
+                     bool &cloudy);
+
+/* cell centres (radians) on a Fibonacci lattice over the sphere */
+void cell_coordinates(size_t cell, size_t ncells, double &clon, double &clat);
+
+/**
+ * @brief Writes a synthetic input file for read_fields
+ *
+ * zg (height, ncells), ta, pfull, rho, hus, clw, cli, qr, qs and qg
+ * (time, height, ncells) and clon, clat (ncells), generated and written
+ * block by block so the memory does not grow with ncells.
+ */
+void write_synthetic(const std::string &file, const synth_options_t &options);
+
+} // namespace synth_muphys
@@ -9,13 +9,26 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // ---------------------------------------------------------------
 //
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <numeric>
+#include <random>
 #include <type_traits>
 
 #include "MuphysTest.cc"
+#include "core/common/activity.hpp"
+#include "core/common/energy.hpp"
 #include "core/common/graupel.hpp"
 #include "core/common/utils.hpp"
+#include "io/cell_order.hpp"
+#include "synth/synth.hpp"
+#ifdef USE_MPI
+#include "io/partition.hpp"
+#endif
 
 TEST(CommonTest, CommonTestSuite_CheckPrecision) {
 #ifdef __SINGLE_PRECISION
@@ -679,3 +692,317 @@ TEST(UtilsTestSuite, CalcDz) {
   for (size_t i = 0; i < dz.size(); i++)
     EXPECT_DOUBLE_EQ(dz[i], expected[i]);
 }
+
+TEST(UtilsTestSuite, CalcDzColumnInPlace) {
+  array_1d_t<real_t> z = {9.0, 7.5, 8.0, 6.0, 4.5, 5.0, 2.0, 1.0, 1.5};
+  array_1d_t<real_t> dz;
+  size_t ncells = 3;
+  size_t nlev = 3;
+
+  utils_muphys::calc_dz(z, dz, ncells, nlev);
+  const array_1d_t<real_t> heights = z;
+
+  // z is overwritten by its own layer thickness, column by column
+  for (size_t j = 0; j < ncells; j++)
+    utils_muphys::calc_dz_column(&z[j], &z[j], nlev, ncells, 0);
+
+  for (size_t i = 0; i < dz.size(); i++)
+    EXPECT_EQ(z[i], dz[i]);
+  // from kmin down only, a dry column is left alone
+  array_1d_t<real_t> partial(nlev * ncells, -1.0);
+  utils_muphys::calc_dz_column(&heights[0], &partial[0], nlev, ncells, 1);
+  EXPECT_EQ(partial[0], -1.0);
+  EXPECT_EQ(partial[1 * ncells], dz[1 * ncells]);
+  EXPECT_EQ(partial[2 * ncells], dz[2 * ncells]);
+  utils_muphys::calc_dz_column(&heights[1], &partial[1], nlev, ncells, nlev + 1);
+  EXPECT_EQ(partial[1 * ncells + 1], -1.0);
+}
+
+TEST(CommonTest, CommonTestSuite_StateLayout) {
+  State state;
+  size_t ncells = 5;
+  size_t nlev = 3;
+  state.allocate(ncells, nlev);
+
+  EXPECT_EQ(state.size(), (fld::n3d * nlev + fld::n2d) * ncells);
+  // species, then the remaining 3D fields, then the surface fields
+  EXPECT_EQ(state.field(idx::lqv) - state.data(), idx::lqv * nlev * ncells);
+  EXPECT_EQ(state.field(fld::pflx) + nlev * ncells, state.surface(0));
+  EXPECT_EQ(state.surface(fld::pre) + ncells, state.data() + state.size());
+}
+
+TEST(CommonTest, CommonTestSuite_StateBind) {
+  size_t ncells = 4;
+  size_t nlev = 2;
+  std::vector<real_t> window((fld::n3d * nlev + fld::n2d) * ncells, 1.0);
+
+  // a bound state works in place on the external memory
+  State bound;
+  bound.bind(window.data(), ncells, nlev);
+  EXPECT_EQ(bound.data(), window.data());
+  bound.surface(fld::pre)[0] = 2.0;
+  EXPECT_EQ(window[window.size() - ncells], 2.0);
+
+  // copies own their tensor, moves keep the binding
+  State copy = bound;
+  EXPECT_NE(copy.data(), window.data());
+  EXPECT_EQ(copy.surface(fld::pre)[0], 2.0);
+  State moved = std::move(bound);
+  EXPECT_EQ(moved.data(), window.data());
+
+  State owned;
+  owned.allocate(ncells, nlev);
+  const real_t *storage = owned.data();
+  State target = std::move(owned);
+  EXPECT_EQ(target.data(), storage);
+}
+
+TEST(CommonTest, CommonTestSuite_PackedIndex) {
+  using kiv32 = packed_kiv<std::uint32_t>;
+  using kiv64 = packed_kiv<std::uint64_t>;
+
+  EXPECT_EQ(kiv32::level(kiv32::pack(89, 16000000)), 89);
+  EXPECT_EQ(kiv32::cell(kiv32::pack(89, 16000000)), 16000000);
+  EXPECT_EQ(kiv64::level(kiv64::pack(65535, 20971520)), 65535);
+  EXPECT_EQ(kiv64::cell(kiv64::pack(65535, 20971520)), 20971520);
+  // packed words order like (k, iv)
+  EXPECT_LT(kiv32::pack(3, 500), kiv32::pack(4, 0));
+
+  EXPECT_TRUE(kiv32::fits(256, 1 << 24));
+  EXPECT_FALSE(kiv32::fits(257, 10));
+  EXPECT_FALSE(kiv32::fits(90, (1 << 24) + 1));
+
+  EXPECT_NO_THROW(check_index_range(90, 5242880));
+  EXPECT_THROW(check_index_range(70000, 10), std::runtime_error);
+  EXPECT_THROW(check_index_range(1000, 5000000), std::runtime_error);
+  // the point index stays 32 bits with a 64-bit packed word
+  EXPECT_THROW(check_index_range(1, size_t{1} << 32), std::runtime_error);
+}
+
+TEST(CommonTest, CommonTestSuite_SyntheticInput) {
+  const synth_muphys::synth_options_t options =
+      synth_muphys::parse_spec("ncells=2000,nlev=40,active=0.5,seed=3");
+  State grid, block;
+  synth_muphys::generate(options, grid);
+  synth_muphys::generate(options, 700, 300, block);
+
+  // a block reproduces the columns of the whole grid
+  for (size_t f : {size_t(fld::dz), size_t(fld::t), size_t(idx::lqc), size_t(idx::lqs)})
+    for (size_t k = 0; k < options.nlev; ++k)
+      for (size_t iv = 0; iv < 300; ++iv)
+        ASSERT_EQ(block.field(f)[k * 300 + iv],
+                  grid.field(f)[k * options.ncells + 700 + iv]);
+
+  size_t cloudy_columns = 0;
+  for (size_t cell = 0; cell < options.ncells; ++cell) {
+    bool cloudy;
+    synth_muphys::column_regime(options, cell, cloudy);
+    cloudy_columns += cloudy;
+  }
+  EXPECT_NEAR(static_cast<double>(cloudy_columns) / options.ncells, 0.5, 0.05);
+
+  EXPECT_THROW(synth_muphys::parse_spec("nlev=0"), std::invalid_argument);
+  EXPECT_THROW(synth_muphys::parse_spec("mix=1:2"), std::invalid_argument);
+  EXPECT_THROW(synth_muphys::parse_spec("cells=10"), std::invalid_argument);
+}
+
+TEST(CommonTest, CommonTestSuite_EnergyMeter) {
+  // powercap stand-in: two packages, a DRAM and a core zone
+  const std::filesystem::path root =
+      std::filesystem::temp_directory_path() / "muphys_rapl_test";
+  std::filesystem::remove_all(root);
+  auto zone = [&](const std::string &dir, const std::string &name,
+                  std::uint64_t uj) {
+    std::filesystem::create_directories(root / dir);
+    std::ofstream(root / dir / "name") << name << "\n";
+    std::ofstream(root / dir / "energy_uj") << uj << "\n";
+    std::ofstream(root / dir / "max_energy_range_uj") << 2000000 << "\n";
+  };
+  zone("intel-rapl:0", "package-0", 1000000);
+  zone("intel-rapl:0:0", "dram", 0);
+  zone("intel-rapl:0:1", "core", 0);
+  zone("intel-rapl:1", "package-1", 0);
+
+  // without the background thread, so that only read() and sample() read
+  // the files
+  utils_muphys::energy_meter meter(root.string(), 0.0);
+  EXPECT_EQ(meter.mask(), (1u << energy::package) | (1u << energy::dram));
+  EXPECT_TRUE(meter.status().empty());
+  double joules[energy::n];
+  meter.read(joules);
+  EXPECT_DOUBLE_EQ(joules[energy::package], 0.0);
+
+  // package-0 wraps around
+  zone("intel-rapl:0", "package-0", 500000);
+  zone("intel-rapl:0:0", "dram", 250000);
+  zone("intel-rapl:0:1", "core", 900000);
+  zone("intel-rapl:1", "package-1", 2000000);
+  meter.read(joules);
+  EXPECT_DOUBLE_EQ(joules[energy::package], 3.5);
+  EXPECT_DOUBLE_EQ(joules[energy::dram], 0.25);
+
+  // the samples in between see the wrap between the two reads of the
+  // caller: 0 -> 1.5 -> 0.5 -> 1.0 J of package-1 adds up to 3 J, not 1 J
+  zone("intel-rapl:1", "package-1", 0);
+  meter.read(joules);
+  const double before = joules[energy::package];
+  for (std::uint64_t uj : {1500000, 500000, 1000000}) {
+    zone("intel-rapl:1", "package-1", uj);
+    meter.sample();
+  }
+  meter.read(joules);
+  EXPECT_DOUBLE_EQ(joules[energy::package] - before, 3.0);
+  std::filesystem::remove_all(root);
+
+  utils_muphys::energy_meter none((root / "missing").string());
+  EXPECT_EQ(none.mask(), 0u);
+  EXPECT_FALSE(none.status().empty());
+}
+
+TEST(CommonTest, CommonTestSuite_SpeciesPoints) {
+  // kmin of three columns in the layouts of the sequential ([iv][species])
+  // and the std (iv * np + species) kernel, ke + 1 without the species
+  const size_t ke = 5, kstart = 1, k_end = ke;
+  const level_index_t first[3][idx::np] = {
+      {2, 6, 6, 0}, {6, 6, 6, 6}, {4, 3, 6, 5}};
+  std::vector<std::array<level_index_t, idx::np>> kmin(3);
+  std::vector<level_index_t> kmin_flat(3 * idx::np);
+  for (size_t iv = 0; iv < 3; ++iv)
+    for (size_t ix = 0; ix < idx::np; ++ix)
+      kmin[iv][idx::qp_ind[ix]] = kmin_flat[iv * idx::np + idx::qp_ind[ix]] =
+          first[iv][idx::qp_ind[ix]];
+
+  // the sequential kernel counts the precipitating columns by species, the
+  // std kernel the species over all columns
+  size_t sequential[idx::np] = {}, std_par[idx::np] = {};
+  for (size_t iv = 0; iv < 3; ++iv)
+    if (*std::min_element(kmin[iv].begin(), kmin[iv].end()) < ke)
+      for (size_t ix = 0; ix < idx::np; ++ix)
+        sequential[idx::qp_ind[ix]] += utils_muphys::sedimentation_levels(
+            kstart, k_end, kmin[iv][idx::qp_ind[ix]]);
+  for (size_t ix = 0; ix < idx::np; ++ix)
+    for (size_t iv = 0; iv < 3; ++iv)
+      std_par[idx::qp_ind[ix]] += utils_muphys::sedimentation_levels(
+          kstart, k_end, kmin_flat[iv * idx::np + idx::qp_ind[ix]]);
+
+  const size_t expected[idx::np] = {4, 2, 0, 4};
+  for (size_t ix = 0; ix < idx::np; ++ix) {
+    EXPECT_EQ(sequential[ix], expected[ix]);
+    EXPECT_EQ(std_par[ix], expected[ix]);
+  }
+}
+
+TEST(CommonTest, CommonTestSuite_ActivityCounts) {
+  State state;
+  size_t ncells = 3;
+  size_t nlev = 2;
+  state.allocate(ncells, nlev);
+  std::fill(state.field(fld::t), state.field(fld::t) + nlev * ncells, 280.0);
+  std::fill(state.field(fld::rho), state.field(fld::rho) + nlev * ncells, 1.0);
+  // cloud water at the bottom of column 0, rain and snow at the bottom of
+  // column 1, ice at the top of column 2
+  state.field(idx::lqc)[1 * ncells + 0] = 1e-4;
+  state.field(idx::lqr)[1 * ncells + 1] = 1e-4;
+  state.field(idx::lqs)[1 * ncells + 1] = 1e-4;
+  state.field(idx::lqi)[0 * ncells + 2] = 1e-4;
+
+  utils_muphys::activity_t activity;
+  utils_muphys::count_activity(state, nlev, 0, ncells, activity);
+  EXPECT_EQ(activity.columns, 3u);
+  EXPECT_EQ(activity.active, (std::vector<std::uint64_t>{1, 2}));
+  // kmin 0 and 1, cloud water does not sediment
+  EXPECT_EQ(activity.kmin, (std::vector<std::uint64_t>{1, 1, 1}));
+  EXPECT_EQ(activity.precip_columns[idx::lqr], 1u);
+  EXPECT_EQ(activity.precip_columns[idx::lqi], 1u);
+  EXPECT_EQ(activity.precip_columns[idx::lqg], 0u);
+  EXPECT_EQ(activity.regimes[activity::warm], 1u);
+  EXPECT_EQ(activity.regimes[activity::cold], 1u);
+  EXPECT_EQ(activity.regimes[activity::mixed], 1u);
+
+  // calls accumulate until the counts are reset
+  utils_muphys::count_activity(state, nlev, 0, ncells, activity);
+  EXPECT_EQ(activity.active[1], 4u);
+  activity.reset(nlev);
+  EXPECT_EQ(activity.columns, 0u);
+  EXPECT_EQ(activity.kmin.size(), nlev + 1);
+}
+
+TEST(CommonTest, CommonTestSuite_CurveOrder) {
+  // a 16 x 16 grid in a shuffled file order; the quantised coordinates are
+  // i * 0x1111, so the Hilbert order is the one of the 16 x 16 curve
+  const size_t n = 16;
+  std::vector<size_t> file(n * n);
+  std::iota(file.begin(), file.end(), 0);
+  std::mt19937 gen(7);
+  std::shuffle(file.begin(), file.end(), gen);
+  std::vector<double> clon(n * n), clat(n * n);
+  for (size_t c = 0; c < n * n; ++c) {
+    clon[c] = double(file[c] % n);
+    clat[c] = double(file[c] / n);
+  }
+
+  for (const char *curve : {"hilbert", "morton"}) {
+    const std::vector<std::uint64_t> order =
+        io_muphys::curve_order(clon, clat, curve);
+    const std::vector<std::uint64_t> inverse = io_muphys::inverse_order(order);
+    ASSERT_EQ(order.size(), n * n);
+    for (size_t p = 0; p < order.size(); ++p) {
+      EXPECT_EQ(inverse[order[p]], p) << curve;
+      EXPECT_EQ(order[inverse[p]], p) << curve;
+    }
+  }
+
+  // neighbouring cells of the Hilbert curve are neighbours on the grid
+  const std::vector<std::uint64_t> order =
+      io_muphys::curve_order(clon, clat, "hilbert");
+  for (size_t p = 1; p < order.size(); ++p) {
+    const double dx = std::abs(clon[order[p]] - clon[order[p - 1]]);
+    const double dy = std::abs(clat[order[p]] - clat[order[p - 1]]);
+    EXPECT_EQ(dx + dy, 1.0) << "curve position " << p;
+  }
+
+  EXPECT_THROW(io_muphys::curve_order(clon, clat, "peano"),
+               std::invalid_argument);
+}
+
+#ifdef USE_MPI
+TEST(CommonTest, CommonTestSuite_BalancedBlocks) {
+  // cost 1 + active levels as in the activity partition
+  const size_t ncells = 1000, nblocks = 7, nlev = 60;
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<size_t> active(0, nlev);
+  std::vector<double> cost(ncells);
+  for (double &c : cost)
+    c = 1.0 + active(gen);
+  std::vector<double> prefix(ncells + 1, 0.0);
+  for (size_t i = 0; i < ncells; ++i)
+    prefix[i + 1] = prefix[i] + cost[i];
+  const double total = prefix[ncells];
+
+  std::vector<std::uint64_t> starts =
+      io_muphys::block_starts(cost.data(), ncells, 0.0, total, nblocks);
+  ASSERT_EQ(starts.size(), nblocks);
+  starts.push_back(ncells);
+  // contiguous blocks that cover all cells, each boundary within one cell
+  // of its share of the cost
+  EXPECT_EQ(starts[0], 0u);
+  for (size_t b = 0; b < nblocks; ++b) {
+    EXPECT_LE(starts[b], starts[b + 1]);
+    const double target = b * total / nblocks;
+    EXPECT_LE(std::abs(prefix[starts[b]] - target), 1.0 + nlev) << b;
+  }
+
+  // runs of the cells as on several ranks add up to the same blocks
+  const size_t cuts[] = {0, 123, 124, 600, ncells};
+  std::vector<std::uint64_t> sum(nblocks, 0);
+  for (size_t r = 0; r + 1 < std::size(cuts); ++r) {
+    const std::vector<std::uint64_t> run = io_muphys::block_starts(
+        cost.data() + cuts[r], cuts[r + 1] - cuts[r], prefix[cuts[r]], total,
+        nblocks);
+    for (size_t b = 0; b < nblocks; ++b)
+      sum[b] += run[b];
+  }
+  sum.push_back(ncells);
+  EXPECT_EQ(sum, starts);
+}
+#endif
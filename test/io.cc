@@ -11,20 +11,30 @@
 //
 
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <random>
 #include <regex>
 
 #include <core/common/constants.hpp>
 #include <core/properties/thermo.hpp>
 #include <io/io.hpp>
+#ifdef MU_CHUNK_READER
+#include <io/chunk_reader.hpp>
+#endif
+
+double touched_cells(size_t &ke, size_t &ivend, State &state) {
+  const real_t *t = state.field(fld::t);
+  const real_t *rho = state.field(fld::rho);
+  const real_t *qv = state.field(idx::lqv);
+  const real_t *qc = state.field(idx::lqc);
+  const real_t *qi = state.field(idx::lqi);
+  const real_t *qr = state.field(idx::lqr);
+  const real_t *qs = state.field(idx::lqs);
+  const real_t *qg = state.field(idx::lqg);
 
-double touched_cells(size_t &ke, size_t &ivend, array_1d_t<real_t> &t,
-                     array_1d_t<real_t> &rho, array_1d_t<real_t> &qv,
-                     array_1d_t<real_t> &qc, array_1d_t<real_t> &qi,
-                     array_1d_t<real_t> &qr, array_1d_t<real_t> &qs,
-                     array_1d_t<real_t> &qg) {
   size_t oned_vec_index;
   size_t jmx = 0;
   for (size_t i = ke - 1; i < ke; --i) {
@@ -47,7 +57,7 @@ double touched_cells(size_t &ke, size_t &ivend, array_1d_t<real_t> &t,
 TEST(IOTestSuite, CheckFile) {
 
   size_t ncells, nlev, itime = 0;
-  array_1d_t<real_t> z, t, p, rho, qv, qc, qi, qr, qs, qg;
+  State state;
   std::vector<std::string> input_files;
 
   if (const char *env_file = std::getenv("TEST_FILE")) {
@@ -75,13 +85,104 @@ TEST(IOTestSuite, CheckFile) {
   }
 
   for (auto const &ifile : input_files) {
-    io_muphys::read_fields(ifile, itime, ncells, nlev, z, t, p, rho, qv, qc, qi,
-                           qr, qs, qg);
+    io_muphys::read_fields(ifile, itime, ncells, nlev, state);
 
-    double result = touched_cells(nlev, ncells, t, rho, qv, qc, qi, qr, qs, qg);
+    double result = touched_cells(nlev, ncells, state);
     std::cout << "CHECKING file " << ifile << ":";
     std::cout << " active cells fraction " << result << std::endl;
     // make sure at least 1 cell changed by the second loop of the algorithm
     EXPECT_GT(result, 0.);
   }
 }
+
+/* a state with random values in every field */
+static State random_state(size_t ncells, size_t nlev) {
+  State state;
+  state.allocate(ncells, nlev);
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<real_t> dist(-1.0, 1.0);
+  for (size_t i = 0; i < state.size(); ++i)
+    state.data()[i] = dist(gen);
+  return state;
+}
+
+/* reads the output fields of a file back, through the chunk reader where it
+ * is built and netCDF for the rest; returns which the chunk reader read */
+static std::vector<bool> read_output(const std::string &file, size_t ncells,
+                                     size_t nlev,
+                                     std::vector<std::vector<real_t>> &values) {
+  values.assign(io_muphys::n_output, {});
+  for (size_t f = 0; f < io_muphys::n_output; ++f)
+    values[f].resize(ncells * (io_muphys::output_fields[f].surface ? 1 : nlev));
+  std::vector<bool> done(io_muphys::n_output, false);
+#ifdef MU_CHUNK_READER
+  {
+    io_muphys::chunk_reader reader(file);
+    for (size_t f = 0; f < io_muphys::n_output; ++f) {
+      const auto &field = io_muphys::output_fields[f];
+      reader.add(field.name, values[f].data(), ncells,
+                 field.surface ? 1 : nlev);
+    }
+    done = reader.read(2);
+  }
+#endif
+  NcFile datafile(file, NcFile::read);
+  for (size_t f = 0; f < io_muphys::n_output; ++f) {
+    if (done[f])
+      continue;
+    size_t levels = io_muphys::output_fields[f].surface ? 1 : nlev;
+    size_t cells = ncells;
+    io_muphys::input_vector(datafile, values[f].data(),
+                            io_muphys::output_fields[f].name, cells, levels);
+  }
+  datafile.close();
+  return done;
+}
+
+/* the fields read back are bit-identical to the output fields of state */
+static void expect_output(const State &state,
+                          const std::vector<std::vector<real_t>> &values) {
+  const io_muphys::output_view_t view = io_muphys::output_view(state);
+  for (size_t f = 0; f < io_muphys::n_output; ++f)
+    EXPECT_EQ(std::memcmp(values[f].data(), view[f],
+                          values[f].size() * sizeof(real_t)),
+              0)
+        << io_muphys::output_fields[f].name;
+}
+
+TEST(IOTestSuite, DeflatedChunksRoundTrip) {
+  // chunks of 3 x 300 leave partial chunks at the end of both dimensions
+  size_t ncells = 1000, nlev = 7;
+  const State state = random_state(ncells, nlev);
+  io_muphys::options_t options;
+  options.deflate_level = 4;
+  options.chunk_nlev = 3;
+  options.chunk_ncells = 300;
+  const std::string file = "test_deflated_chunks.nc";
+  io_muphys::write_fields(file, ncells, nlev, state, options);
+
+  std::vector<std::vector<real_t>> values;
+  const std::vector<bool> done = read_output(file, ncells, nlev, values);
+#ifdef MU_CHUNK_READER
+  for (size_t f = 0; f < io_muphys::n_output; ++f)
+    EXPECT_TRUE(done[f]) << io_muphys::output_fields[f].name;
+#endif
+  expect_output(state, values);
+  std::filesystem::remove(file);
+}
+
+TEST(IOTestSuite, ContiguousFallback) {
+  // uncompressed variables are contiguous, the chunk reader leaves them to
+  // netCDF
+  size_t ncells = 1000, nlev = 7;
+  const State state = random_state(ncells, nlev);
+  const std::string file = "test_contiguous.nc";
+  io_muphys::write_fields(file, ncells, nlev, state);
+
+  std::vector<std::vector<real_t>> values;
+  const std::vector<bool> done = read_output(file, ncells, nlev, values);
+  for (size_t f = 0; f < io_muphys::n_output; ++f)
+    EXPECT_FALSE(done[f]) << io_muphys::output_fields[f].name;
+  expect_output(state, values);
+  std::filesystem::remove(file);
+}